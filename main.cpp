@@ -1,10 +1,17 @@
 #define CPPHTTPLIB_OPENSSL_SUPPORT
+// Bursts of parallel connects (prefetch, load tests) overflow httplib's default backlog of 5
+#define CPPHTTPLIB_LISTEN_BACKLOG 128
+// Small keep-alive requests otherwise stall ~40 ms on Nagle plus delayed ACK, which
+// would also inflate the latency percentile that decides when to hedge
+#define CPPHTTPLIB_TCP_NODELAY true
 #include "httplib.h"
 #include "json.hpp"
 #include <iostream>
 #include <string>
 #include <vector>
 #include <queue>
+#include <deque>
+#include <list>
 #include <unordered_map>
 #include <unordered_set>
 #include <cmath>
@@ -17,6 +24,40 @@
 #include <sstream>
 #include <iomanip>
 #include <ctime>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <future>
+#include <cstdio>
+#include <array>
+#include <cstdint>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+
+// SIMD paths for the batch distance kernels; anything else uses the scalar fallback
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define MAPS_HAVE_SSE2 1
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MAPS_HAVE_AVX2 1
+#define MAPS_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(__AVX2__)
+#define MAPS_HAVE_AVX2 1
+#define MAPS_AVX2_TARGET
+#endif
+#endif
+// Shared lane bodies must inline into each target-specific caller to pick up its ISA
+#if defined(__GNUC__)
+#define MAPS_LANES_INLINE inline __attribute__((always_inline))
+#else
+#define MAPS_LANES_INLINE inline
+#endif
 using namespace std;
 
 // Define route types
@@ -27,6 +68,28 @@ enum RouteType {
     SCENIC
 };
 
+// Distance estimate used as the search heuristic
+enum HeuristicMode {
+    ACCURATE_HEURISTIC,     // RouteUtils::getAccurateDistance (city table, then haversine)
+    CHEAP_RULER_HEURISTIC   // flat-earth CheapRuler, admissible lower bound on haversine
+};
+
+// Where segment road names come from, tried in order until every leg is named
+enum RoutingBackendMode {
+    BACKEND_DEFAULT,        // whatever RouteFinder::setRoutingBackendMode selected
+    BACKEND_AUTO,           // road table, OSRM for pairs the table lacks, then local synthesis
+    BACKEND_LOCAL,          // road table, then local synthesis; never leaves the process
+    BACKEND_REMOTE          // OSRM first, then road table and local synthesis
+};
+
+// Implementation behind RouteUtils::calculateDistanceBatch
+enum DistanceKernel {
+    DISTANCE_KERNEL_AUTO,   // the fastest one this build and CPU can run
+    DISTANCE_KERNEL_SCALAR,
+    DISTANCE_KERNEL_SSE2,
+    DISTANCE_KERNEL_AVX2
+};
+
 class TollInfo {
 public:
     string name;
@@ -38,16 +101,83 @@ public:
         : name(n), operator_name(op), cost(c), currency(curr) {}
 };
 
+// Known road distances between city pairs. City names are mapped to small integer ids once
+// (Location stores its id), so a lookup is a single load from a dense symmetric matrix.
+class CityDistanceTable {
+public:
+    static const int UNKNOWN_CITY = -1;
+
+    static int idOf(const string& cityName) {
+        const auto& ids = instance().cityIds;
+        auto it = ids.find(cityName);
+        return it != ids.end() ? it->second : UNKNOWN_CITY;
+    }
+
+    // Negative when the pair has no table entry
+    static double distance(int startId, int endId) {
+        if (startId < 0 || endId < 0) return -1;
+        const CityDistanceTable& table = instance();
+        return table.matrix[startId * table.cityCount + endId];
+    }
+
+private:
+    unordered_map<string, int> cityIds;
+    vector<double> matrix;
+    int cityCount = 0;
+
+    CityDistanceTable() {
+        const vector<string> cities = {"Surabaya", "Gresik", "Sidoarjo", "Malang", "Mojokerto", "Lamongan", "Probolinggo", "Jakarta", "Bogor", "Bekasi", "Tangerang", "Bandung", "Yogyakarta", "Solo", "Semarang", "Cimahi"};
+        cityCount = static_cast<int>(cities.size());
+        for (int i = 0; i < cityCount; i++) {
+            cityIds[cities[i]] = i;
+        }
+        matrix.assign(cityCount * cityCount, -1.0);
+
+        set("Surabaya", "Gresik", 32.5);
+        set("Surabaya", "Sidoarjo", 25.0);
+        set("Surabaya", "Malang", 95.0);
+        set("Surabaya", "Mojokerto", 50.0);
+        set("Surabaya", "Lamongan", 47.0);
+        set("Surabaya", "Probolinggo", 76.0);
+        set("Jakarta", "Bogor", 59.0);
+        set("Jakarta", "Bekasi", 28.0);
+        set("Jakarta", "Tangerang", 25.0);
+        set("Jakarta", "Bandung", 151.0);
+        set("Yogyakarta", "Solo", 65.0);
+        set("Yogyakarta", "Semarang", 110.0);
+        set("Bandung", "Cimahi", 15.0);
+    }
+
+    void set(const string& a, const string& b, double km) {
+        int i = cityIds.at(a), j = cityIds.at(b);
+        matrix[i * cityCount + j] = km;
+        matrix[j * cityCount + i] = km;
+    }
+
+    static const CityDistanceTable& instance() {
+        static const CityDistanceTable table;
+        return table;
+    }
+};
+
 class Location {
 public:
     string name;
     double lat;
     double lon;
+    // Radian form and cos(lat), filled once here so distance code skips the per-call conversion
+    double latRad;
+    double lonRad;
+    double cosLat;
+    // CityDistanceTable id of extractCityName(name), or UNKNOWN_CITY
+    int cityId;
     
     Location(const string& n, double latitude, double longitude) 
-        : name(n), lat(latitude), lon(longitude) {}
+        : name(n), lat(latitude), lon(longitude),
+          latRad(latitude * M_PI / 180.0), lonRad(longitude * M_PI / 180.0), cosLat(cos(latRad)),
+          cityId(CityDistanceTable::idOf(extractCityName(n))) {}
     
-    Location() : lat(0), lon(0) {}
+    Location() : lat(0), lon(0), latRad(0), lonRad(0), cosLat(1), cityId(CityDistanceTable::UNKNOWN_CITY) {}
     
     static string extractCityName(const string& fullDisplayName) {
         size_t firstComma = fullDisplayName.find(',');
@@ -149,7 +279,7 @@ public:
     }
     
     vector<pair<string, pair<double, double>>> getIntermediates(
-            const string& startCity, const string& endCity) {
+            const string& startCity, const string& endCity) const {
         
         auto it1 = locations.find(startCity);
         if (it1 != locations.end()) {
@@ -171,6 +301,15 @@ public:
         
         return {};
     }
+
+    // Each stored corridor once, in the direction it was entered
+    void forEachCorridor(const function<void(const vector<pair<string, pair<double, double>>>&)>& visit) const {
+        for (const auto& start : locations) {
+            for (const auto& end : start.second) {
+                visit(end.second);
+            }
+        }
+    }
 };
 
 class RoadDatabase {
@@ -286,7 +425,7 @@ public:
         const string& startCity, 
         const string& endCity, 
         const vector<string>& intermediates,
-        RouteType routeType) {
+        RouteType routeType) const {
         
         vector<string> roads;
         string prevCity = startCity;
@@ -306,17 +445,24 @@ public:
         return roads;
     }
     
-    vector<string> getRoadNames(const string& startCity, const string& endCity, RouteType routeType) {
+    bool hasRoute(const string& startCity, const string& routeKey) const {
+        auto it = detailedRoads.find(startCity);
+        return it != detailedRoads.end() && it->second.find(routeKey) != it->second.end();
+    }
+    
+    // Read-only, so concurrent segment lookups can share one RoadDatabase. Empty when the
+    // table has no entry for the pair in either direction.
+    vector<string> getRoadNames(const string& startCity, const string& endCity, RouteType routeType) const {
         string routeKey = endCity;
         
         if (routeType == AVOID_TOLLS) {
             routeKey = endCity + "-NoToll";
-            if (detailedRoads[startCity].find(routeKey) == detailedRoads[startCity].end()) {
+            if (!hasRoute(startCity, routeKey)) {
                 routeKey = endCity;
             }
         } else if (routeType == SCENIC) {
             routeKey = endCity + "-Scenic";
-            if (detailedRoads[startCity].find(routeKey) == detailedRoads[startCity].end()) {
+            if (!hasRoute(startCity, routeKey)) {
                 routeKey = endCity;
             }
         }
@@ -375,14 +521,23 @@ public:
             }
         }
         
-        vector<string> fallbackRoads;
-        fallbackRoads.push_back("Jalan Raya " + startCity);
-        fallbackRoads.push_back("Jalan Penghubung " + startCity + "-" + endCity);
-        fallbackRoads.push_back("Jalan Utama " + endCity);
-        return fallbackRoads;
+        // Unknown pair: let the caller try a routing backend that can answer it
+        return {};
     }
 };
 
+// C(2n,n) / (4^n (2n+1)), the Maclaurin coefficients of asin(x) in powers of x^2
+template <size_t N>
+constexpr array<double, N> asinSeriesCoefficients() {
+    array<double, N> c{};
+    double term = 1.0;
+    for (size_t n = 0; n < N; n++) {
+        c[n] = term / (2.0 * n + 1.0);
+        term *= (2.0 * n + 1.0) / (2.0 * n + 2.0);
+    }
+    return c;
+}
+
 class RouteUtils {
 public:
 // Add after RouteUtils class
@@ -434,6 +589,22 @@ public:
         return true;
     }
     
+    // Adds every location not saved yet and writes the file once; returns how many were added
+    size_t addLocations(const vector<Location>& locations) {
+        size_t added = 0;
+        for (const auto& location : locations) {
+            if (location.name.empty() || userLocations.find(location.name) != userLocations.end()) {
+                continue;
+            }
+            userLocations[location.name] = location;
+            added++;
+        }
+        if (added > 0) {
+            saveLocations();
+        }
+        return added;
+    }
+    
     bool updateLocation(const string& name, double latitude, double longitude) {
         if (userLocations.find(name) == userLocations.end()) {
             return false; // Location doesn't exist
@@ -791,8 +962,15 @@ public:
         FileIO::saveToFile(filename, visualization);
     }
 };
+    static constexpr double EARTH_RADIUS_KM = 6371.0;
+
+    // calculateDistanceBatch uses polynomial sin/cos/asin instead of libm. It agrees with
+    // calculateDistance to ~1e-8 km below 19000 km; close to antipodal both formulas are
+    // ill-conditioned and the gap grows to ~1e-5 km, so this is the documented bound.
+    static constexpr double BATCH_DISTANCE_MAX_ERROR_KM = 1e-4;
+
     static double calculateDistance(double lat1, double lon1, double lat2, double lon2) {
-        const double R = 6371.0;
+        const double R = EARTH_RADIUS_KM;
         double dLat = (lat2 - lat1) * M_PI / 180.0;
         double dLon = (lon2 - lon1) * M_PI / 180.0;
         
@@ -803,21 +981,87 @@ public:
         return R * c;
     }
 
+    // Haversine on the precomputed radians/cosines of both locations
+    static double calculateDistance(const Location& start, const Location& end) {
+        double sinHalfLat = sin((end.latRad - start.latRad) * 0.5);
+        double sinHalfLon = sin((end.lonRad - start.lonRad) * 0.5);
+        double a = sinHalfLat * sinHalfLat +
+                   start.cosLat * end.cosLat * sinHalfLon * sinHalfLon;
+        return 2 * EARTH_RADIUS_KM * atan2(sqrt(a), sqrt(1 - a));
+    }
+
+    // Haversine for count pairs (lat1[i], lon1[i]) -> (lat2[i], lon2[i]), in degrees
+    static void calculateDistanceBatch(
+        const double* lat1, const double* lon1,
+        const double* lat2, const double* lon2,
+        double* out, size_t count,
+        DistanceKernel kernel = DISTANCE_KERNEL_AUTO) {
+        haversineBatch(lat1, lon1, nullptr, 1, lat2, lon2, nullptr, out, count, kernel);
+    }
+
+    // Haversine from one origin to count targets
+    static void calculateDistanceBatch(
+        double originLat, double originLon,
+        const double* lat2, const double* lon2,
+        double* out, size_t count,
+        DistanceKernel kernel = DISTANCE_KERNEL_AUTO) {
+        haversineBatch(&originLat, &originLon, nullptr, 0, lat2, lon2, nullptr, out, count, kernel);
+    }
+
+    // One origin to many targets whose cos(lat) is already known (Location::cosLat)
+    static void calculateDistanceBatch(
+        const Location& origin,
+        const double* lat2, const double* lon2, const double* cosLat2,
+        double* out, size_t count,
+        DistanceKernel kernel = DISTANCE_KERNEL_AUTO) {
+        haversineBatch(&origin.lat, &origin.lon, &origin.cosLat, 0, lat2, lon2, cosLat2, out, count, kernel);
+    }
+
+    // What DISTANCE_KERNEL_AUTO runs
+    static DistanceKernel fastestDistanceKernel() {
+        if (cpuHasAvx2()) return DISTANCE_KERNEL_AVX2;
+#ifdef MAPS_HAVE_SSE2
+        return DISTANCE_KERNEL_SSE2;
+#else
+        return DISTANCE_KERNEL_SCALAR;
+#endif
+    }
+
+    // Kernels this build and CPU can run, fastest first
+    static vector<DistanceKernel> distanceKernels() {
+        vector<DistanceKernel> kernels;
+        if (cpuHasAvx2()) kernels.push_back(DISTANCE_KERNEL_AVX2);
+#ifdef MAPS_HAVE_SSE2
+        kernels.push_back(DISTANCE_KERNEL_SSE2);
+#endif
+        kernels.push_back(DISTANCE_KERNEL_SCALAR);
+        return kernels;
+    }
+
+    static const char* distanceKernelName(DistanceKernel kernel) {
+        switch (kernel == DISTANCE_KERNEL_AUTO ? fastestDistanceKernel() : kernel) {
+            case DISTANCE_KERNEL_AVX2: return "avx2";
+            case DISTANCE_KERNEL_SSE2: return "sse2";
+            default: return "scalar";
+        }
+    }
+
+    static bool getCityTableDistance(const Location& start, const Location& end, double& distance) {
+        double tableDistance = CityDistanceTable::distance(start.cityId, end.cityId);
+        if (tableDistance < 0) {
+            return false;
+        }
+        distance = tableDistance;
+        return true;
+    }
+
     static double getAccurateDistance(const Location& start, const Location& end) {
-        static auto cityDistances = getAccurateCityDistances();
-        
-        string startCity = Location::extractCityName(start.name);
-        string endCity = Location::extractCityName(end.name);
-        
-        auto it1 = cityDistances.find(startCity);
-        if (it1 != cityDistances.end()) {
-            auto it2 = it1->second.find(endCity);
-            if (it2 != it1->second.end()) {
-                return it2->second;
-            }
+        double tableDistance;
+        if (getCityTableDistance(start, end, tableDistance)) {
+            return tableDistance;
         }
         
-        return calculateDistance(start.lat, start.lon, end.lat, end.lon);
+        return calculateDistance(start, end);
     }
 
     static string cleanRouteSymbols(const string& routeText) {
@@ -852,903 +1096,4663 @@ public:
     }
 
 private:
-    static unordered_map<string, unordered_map<string, double>> getAccurateCityDistances() {
-        unordered_map<string, unordered_map<string, double>> distances;
-        distances["Surabaya"]["Gresik"] = 32.5;
-        distances["Gresik"]["Surabaya"] = 32.5;
-        distances["Surabaya"]["Sidoarjo"] = 25.0;
-        distances["Sidoarjo"]["Surabaya"] = 25.0;
-        distances["Surabaya"]["Malang"] = 95.0;
-        distances["Malang"]["Surabaya"] = 95.0;
-        distances["Surabaya"]["Mojokerto"] = 50.0;
-        distances["Mojokerto"]["Surabaya"] = 50.0;
-        distances["Surabaya"]["Lamongan"] = 47.0;
-        distances["Lamongan"]["Surabaya"] = 47.0;
-        distances["Surabaya"]["Probolinggo"] = 76.0;
-        distances["Probolinggo"]["Surabaya"] = 76.0;
-        distances["Jakarta"]["Bogor"] = 59.0;
-        distances["Bogor"]["Jakarta"] = 59.0;
-        distances["Jakarta"]["Bekasi"] = 28.0;
-        distances["Bekasi"]["Jakarta"] = 28.0;
-        distances["Jakarta"]["Tangerang"] = 25.0;
-        distances["Tangerang"]["Jakarta"] = 25.0;
-        distances["Jakarta"]["Bandung"] = 151.0;
-        distances["Bandung"]["Jakarta"] = 151.0;
-        distances["Yogyakarta"]["Solo"] = 65.0;
-        distances["Solo"]["Yogyakarta"] = 65.0;
-        distances["Yogyakarta"]["Semarang"] = 110.0;
-        distances["Semarang"]["Yogyakarta"] = 110.0;
-        distances["Bandung"]["Cimahi"] = 15.0;
-        distances["Cimahi"]["Bandung"] = 15.0;
-        return distances;
+    // Taylor coefficients of sin(x) in x^2, accurate to ~5e-14 on [-pi/2, pi/2]
+    static constexpr array<double, 9> SIN_COEFFS = {
+        1.0, -1.0 / 6, 1.0 / 120, -1.0 / 5040, 1.0 / 362880, -1.0 / 39916800,
+        1.0 / 6227020800.0, -1.0 / 1307674368000.0, 1.0 / 355687428096000.0
+    };
+
+    // Taylor coefficients of asin(x) in x^2, accurate to ~2e-13 on [0, 0.5]
+    static constexpr array<double, 17> ASIN_COEFFS = asinSeriesCoefficients<17>();
+
+    static bool cpuHasAvx2() {
+#if defined(MAPS_HAVE_AVX2) && defined(__GNUC__)
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+#elif defined(MAPS_HAVE_AVX2)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Lane operations the haversine body is written against. ScalarLanes is one lane wide
+    // and serves tails and non-x86 builds.
+    struct ScalarLanes {
+        typedef double Vec;
+        typedef bool Mask;
+        static constexpr size_t WIDTH = 1;
+        static Vec set1(double x) { return x; }
+        static Vec load(const double* p) { return *p; }
+        static void store(double* p, Vec v) { *p = v; }
+        static Vec add(Vec a, Vec b) { return a + b; }
+        static Vec sub(Vec a, Vec b) { return a - b; }
+        static Vec mul(Vec a, Vec b) { return a * b; }
+        static Vec min(Vec a, Vec b) { return a < b ? a : b; }
+        static Vec max(Vec a, Vec b) { return a > b ? a : b; }
+        static Vec abs(Vec a) { return fabs(a); }
+        static Vec sqrt(Vec a) { return std::sqrt(a); }
+        static Mask lessEqual(Vec a, Vec b) { return a <= b; }
+        static Vec select(Mask mask, Vec ifTrue, Vec ifFalse) { return mask ? ifTrue : ifFalse; }
+    };
+
+#ifdef MAPS_HAVE_SSE2
+    struct Sse2Lanes {
+        typedef __m128d Vec;
+        typedef __m128d Mask;
+        static constexpr size_t WIDTH = 2;
+        static Vec set1(double x) { return _mm_set1_pd(x); }
+        static Vec load(const double* p) { return _mm_loadu_pd(p); }
+        static void store(double* p, Vec v) { _mm_storeu_pd(p, v); }
+        static Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+        static Vec min(Vec a, Vec b) { return _mm_min_pd(a, b); }
+        static Vec max(Vec a, Vec b) { return _mm_max_pd(a, b); }
+        static Vec abs(Vec a) { return _mm_and_pd(a, _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL))); }
+        static Vec sqrt(Vec a) { return _mm_sqrt_pd(a); }
+        static Mask lessEqual(Vec a, Vec b) { return _mm_cmple_pd(a, b); }
+        // SSE2 has no blendv, so select with and/andnot
+        static Vec select(Mask mask, Vec ifTrue, Vec ifFalse) {
+            return _mm_or_pd(_mm_and_pd(mask, ifTrue), _mm_andnot_pd(mask, ifFalse));
+        }
+    };
+#endif
+
+#ifdef MAPS_HAVE_AVX2
+    struct Avx2Lanes {
+        typedef __m256d Vec;
+        typedef __m256d Mask;
+        static constexpr size_t WIDTH = 4;
+        MAPS_AVX2_TARGET static Vec set1(double x) { return _mm256_set1_pd(x); }
+        MAPS_AVX2_TARGET static Vec load(const double* p) { return _mm256_loadu_pd(p); }
+        MAPS_AVX2_TARGET static void store(double* p, Vec v) { _mm256_storeu_pd(p, v); }
+        MAPS_AVX2_TARGET static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+        MAPS_AVX2_TARGET static Vec sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+        MAPS_AVX2_TARGET static Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+        MAPS_AVX2_TARGET static Vec min(Vec a, Vec b) { return _mm256_min_pd(a, b); }
+        MAPS_AVX2_TARGET static Vec max(Vec a, Vec b) { return _mm256_max_pd(a, b); }
+        MAPS_AVX2_TARGET static Vec abs(Vec a) {
+            return _mm256_and_pd(a, _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL)));
+        }
+        MAPS_AVX2_TARGET static Vec sqrt(Vec a) { return _mm256_sqrt_pd(a); }
+        MAPS_AVX2_TARGET static Mask lessEqual(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        MAPS_AVX2_TARGET static Vec select(Mask mask, Vec ifTrue, Vec ifFalse) {
+            return _mm256_blendv_pd(ifFalse, ifTrue, mask);
+        }
+    };
+#endif
+
+    // The lane bodies below are only ever inlined into a caller built for their ISA, so
+    // GCC's note that passing __m256d from generic code changes the ABI does not apply
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+    // The one haversine body every kernel runs, Lanes::WIDTH pairs at a time; returns how
+    // many pairs it covered. Angles are folded so every sin argument lies in [-pi/2, pi/2]
+    // and every asin argument in [0, 0.5]:
+    //   sin^2(x) = sin^2(min(|x|, pi - |x|)),  cos(lat) = sin(pi/2 - |lat|),
+    //   asin(s) = pi/2 - 2 asin(sqrt((1 - s) / 2)) for s > 0.5
+    template <typename Lanes>
+    MAPS_LANES_INLINE static size_t haversineLanes(
+        const double* lat1, const double* lon1, const double* cos1, size_t stride1,
+        const double* lat2, const double* lon2, const double* cos2,
+        double* out, size_t count) {
+
+        typedef typename Lanes::Vec Vec;
+        const Vec toRad = Lanes::set1(M_PI / 180.0);
+        const Vec half = Lanes::set1(0.5);
+        const Vec zero = Lanes::set1(0.0);
+        const Vec one = Lanes::set1(1.0);
+        const Vec pi = Lanes::set1(M_PI);
+        const Vec halfPi = Lanes::set1(M_PI / 2);
+        const Vec twoR = Lanes::set1(2 * EARTH_RADIUS_KM);
+
+        size_t i = 0;
+        for (; i + Lanes::WIDTH <= count; i += Lanes::WIDTH) {
+            Vec la1 = Lanes::mul(stride1 ? Lanes::load(lat1 + i) : Lanes::set1(lat1[0]), toRad);
+            Vec lo1 = Lanes::mul(stride1 ? Lanes::load(lon1 + i) : Lanes::set1(lon1[0]), toRad);
+            Vec la2 = Lanes::mul(Lanes::load(lat2 + i), toRad);
+            Vec lo2 = Lanes::mul(Lanes::load(lon2 + i), toRad);
+
+            Vec halfLon = Lanes::abs(Lanes::mul(Lanes::sub(lo2, lo1), half));
+            // args: sin(halfLat), sin(halfLon), then cos(lat1)/cos(lat2) unless supplied
+            Vec args[4];
+            int argCount = 0;
+            args[argCount++] = Lanes::mul(Lanes::sub(la2, la1), half);
+            args[argCount++] = Lanes::min(halfLon, Lanes::sub(pi, halfLon));
+            if (!cos1) args[argCount++] = Lanes::sub(halfPi, Lanes::abs(la1));
+            if (!cos2) args[argCount++] = Lanes::sub(halfPi, Lanes::abs(la2));
+            for (int j = 0; j < argCount; j++) {
+                Vec x2 = Lanes::mul(args[j], args[j]);
+                Vec p = Lanes::set1(SIN_COEFFS.back());
+                for (size_t k = SIN_COEFFS.size() - 1; k-- > 0;) p = Lanes::add(Lanes::mul(p, x2), Lanes::set1(SIN_COEFFS[k]));
+                args[j] = Lanes::mul(p, args[j]);
+            }
+
+            int next = 2;
+            Vec c1 = !cos1 ? args[next++] : (stride1 ? Lanes::load(cos1 + i) : Lanes::set1(cos1[0]));
+            Vec c2 = !cos2 ? args[next++] : Lanes::load(cos2 + i);
+            Vec a = Lanes::add(
+                Lanes::mul(args[0], args[0]),
+                Lanes::mul(Lanes::mul(c1, c2), Lanes::mul(args[1], args[1])));
+            a = Lanes::max(zero, Lanes::min(one, a));
+            Vec s = Lanes::sqrt(a);
+
+            typename Lanes::Mask small = Lanes::lessEqual(s, half);
+            Vec z = Lanes::select(small, s, Lanes::sqrt(Lanes::mul(Lanes::sub(one, s), half)));
+            Vec z2 = Lanes::mul(z, z);
+            Vec p = Lanes::set1(ASIN_COEFFS.back());
+            for (size_t k = ASIN_COEFFS.size() - 1; k-- > 0;) p = Lanes::add(Lanes::mul(p, z2), Lanes::set1(ASIN_COEFFS[k]));
+            p = Lanes::mul(p, z);
+            Vec c = Lanes::select(small, p, Lanes::sub(halfPi, Lanes::add(p, p)));
+
+            Lanes::store(out + i, Lanes::mul(twoR, c));
+        }
+        return i;
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    // stride1 is 1 for pairwise input or 0 to broadcast a single origin. cos1/cos2 may be
+    // null, in which case cos(lat) is evaluated by polynomial. A kernel the CPU cannot run
+    // leaves every pair to the scalar lanes.
+    static void haversineBatch(
+        const double* lat1, const double* lon1, const double* cos1, size_t stride1,
+        const double* lat2, const double* lon2, const double* cos2,
+        double* out, size_t count, DistanceKernel kernel) {
+
+        if (kernel == DISTANCE_KERNEL_AUTO) kernel = fastestDistanceKernel();
+        size_t done = 0;
+#ifdef MAPS_HAVE_AVX2
+        if (kernel == DISTANCE_KERNEL_AVX2 && cpuHasAvx2()) {
+            done = haversineBatchAvx2(lat1, lon1, cos1, stride1, lat2, lon2, cos2, out, count);
+            // Fewer than four pairs still fill an SSE2 register
+            if (done == 0) kernel = DISTANCE_KERNEL_SSE2;
+        }
+#endif
+#ifdef MAPS_HAVE_SSE2
+        if (kernel == DISTANCE_KERNEL_SSE2 && done == 0) {
+            done = haversineLanes<Sse2Lanes>(lat1, lon1, cos1, stride1, lat2, lon2, cos2, out, count);
+        }
+#endif
+        size_t skip = done * stride1;
+        haversineLanes<ScalarLanes>(lat1 + skip, lon1 + skip, cos1 ? cos1 + skip : nullptr, stride1,
+                                    lat2 + done, lon2 + done, cos2 ? cos2 + done : nullptr,
+                                    out + done, count - done);
+    }
+
+#ifdef MAPS_HAVE_AVX2
+    // Built for avx2 so Avx2Lanes inlines into it
+    MAPS_AVX2_TARGET
+    static size_t haversineBatchAvx2(
+        const double* lat1, const double* lon1, const double* cos1, size_t stride1,
+        const double* lat2, const double* lon2, const double* cos2,
+        double* out, size_t count) {
+        return haversineLanes<Avx2Lanes>(lat1, lon1, cos1, stride1, lat2, lon2, cos2, out, count);
     }
+#endif
 };
 
-class Geocoder {
+// Flat-earth ("cheap ruler") distance for one query. East-west distances are scaled by a
+// single cos factor chosen so the result never exceeds the haversine distance:
+//   A path between two points has length  R * integral sqrt(dphi^2 + cos^2(phi) dlambda^2).
+//   Every point of the great-circle path is within d/2 of an endpoint, and
+//   d <= R (|dphi| + |dlambda|), so its latitude stays below
+//   PHI = max|phi| + (latSpan + lonSpan) / 2 over the query's bounding box.
+//   With k = cos(PHI), cos(phi) >= k along the path, hence
+//   d >= R * sqrt(dphi^2 + k^2 dlambda^2)   (Minkowski inequality on the integral).
+// The final (1 - 1e-9) factor only absorbs floating-point rounding.
+class CheapRuler {
 public:
-    Location geocodeLocation(const string& locationName) {
-        try {
-            httplib::Client cli("https://nominatim.openstreetmap.org");
-            httplib::Headers headers = {{"User-Agent", "MapsPathfinder/1.0"}};
-            
-            auto res = cli.Get("/search?q=" + httplib::detail::encode_url(locationName) + 
-                            "&format=json&limit=1", headers);
-            
-            if (!res) {
-                cout << "Error: Network connection failed when geocoding." << endl;
-                return Location();
-            }
-            
-            if (res->status != 200) {
-                cout << "Error: Geocoding API returned status code " << res->status << endl;
-                return Location();
-            }
-            
-            auto json = nlohmann::json::parse(res->body);
-            if (!json.empty()) {
-                double lat = stod(json[0]["lat"].get<string>());
-                double lon = stod(json[0]["lon"].get<string>());
-                string fullName = json[0]["display_name"].get<string>();
-                string cityName = Location::extractCityName(fullName);
-                return Location(cityName, lat, lon);
-            } else {
-                throw runtime_error("Location not found");
+    double kmPerRadLat;
+    double kmPerRadLon;
+    
+    // Radians box around every location a ruler measures between
+    struct Bounds {
+        double minLat = M_PI / 2, maxLat = -M_PI / 2;
+        double minLon = M_PI, maxLon = -M_PI;
+        
+        bool empty() const { return minLat > maxLat; }
+        
+        // True when loc widened the box, so rulers built from it need rebuilding
+        bool extend(const Location& loc) {
+            if (!empty() && loc.latRad >= minLat && loc.latRad <= maxLat &&
+                loc.lonRad >= minLon && loc.lonRad <= maxLon) {
+                return false;
             }
-        } catch (const exception& e) {
-            cerr << "Geocoding error: " << e.what() << endl;
-            return Location();
+            minLat = min(minLat, loc.latRad);
+            maxLat = max(maxLat, loc.latRad);
+            minLon = min(minLon, loc.lonRad);
+            maxLon = max(maxLon, loc.lonRad);
+            return true;
         }
+    };
+    
+    CheapRuler() : kmPerRadLat(RouteUtils::EARTH_RADIUS_KM), kmPerRadLon(0) {}
+    
+    static CheapRuler forBounds(const Bounds& bounds) {
+        CheapRuler ruler;
+        if (bounds.empty()) return ruler;
+        double lonSpan = min(bounds.maxLon - bounds.minLon, M_PI);
+        double bound = max(fabs(bounds.minLat), fabs(bounds.maxLat)) + ((bounds.maxLat - bounds.minLat) + lonSpan) / 2;
+        ruler.kmPerRadLon = RouteUtils::EARTH_RADIUS_KM * cos(min(bound, M_PI / 2));
+        return ruler;
+    }
+    
+    static CheapRuler forGraph(const unordered_map<string, Node>& graph) {
+        Bounds bounds;
+        for (const auto& node : graph) bounds.extend(node.second.location);
+        return forBounds(bounds);
+    }
+    
+    double distance(const Location& start, const Location& end) const {
+        double dLat = (end.latRad - start.latRad) * kmPerRadLat;
+        double dLonRad = fabs(end.lonRad - start.lonRad);
+        if (dLonRad > M_PI) dLonRad = 2 * M_PI - dLonRad;
+        double dLon = dLonRad * kmPerRadLon;
+        return sqrt(dLat * dLat + dLon * dLon) * (1.0 - 1e-9);
     }
 };
 
-class RouteFinder {
-private:
-    WaypointDatabase waypointDB;
-    IntermediateLocationDB intermediateDB;
-    RoadDatabase roadDB;
-
+// Uniform grid over graph edge segments, used to snap coordinates onto the road network
+class RoadSegmentIndex {
 public:
-    vector<string> findBestFirstPath(
-        const unordered_map<string, Node>& graph,
-        const string& startId,
-        const string& endId) {
-        
-        priority_queue<pair<double, string>, 
-                      vector<pair<double, string>>,
-                      greater<pair<double, string>>> openSet;
-        
-        unordered_map<string, string> cameFrom;
-        unordered_set<string> closedSet;
-        
-        try {
-            openSet.push(make_pair(
-                RouteUtils::getAccurateDistance(
-                    graph.at(startId).location,
-                    graph.at(endId).location
-                ), 
-                startId
-            ));
-            
-            while (!openSet.empty()) {
-                string current = openSet.top().second;
-                openSet.pop();
-                
-                if (current == endId) {
-                    vector<string> path;
-                    while (current != startId) {
-                        path.push_back(current);
-                        current = cameFrom[current];
-                    }
-                    path.push_back(startId);
-                    reverse(path.begin(), path.end());
-                    return path;
-                }
-                
-                closedSet.insert(current);
-                
-                for (const auto& neighbor : graph.at(current).edges) {
-                    string neighborId = neighbor.first;
-                    
-                    if (closedSet.count(neighborId) > 0) {
-                        continue;
-                    }
-                    
-                    double heuristic = RouteUtils::getAccurateDistance(
-                        graph.at(neighborId).location,
-                        graph.at(endId).location
-                    );
-                    
-                    if (cameFrom.find(neighborId) == cameFrom.end()) {
-                        cameFrom[neighborId] = current;
-                        openSet.push(make_pair(heuristic, neighborId));
-                    }
+    struct Segment {
+        string fromId;
+        string toId;
+        double lat1, lon1;
+        double lat2, lon2;
+    };
+
+    struct SnapResult {
+        string fromId;
+        string toId;
+        double lat = 0;
+        double lon = 0;
+        double ratio = 0;                                   // position along the segment, 0 = from, 1 = to
+        double distance = numeric_limits<double>::infinity(); // km from the query point
+
+        bool found() const { return !fromId.empty(); }
+    };
+
+    explicit RoadSegmentIndex(double cellSizeDegrees = 0.01)
+        : cellSize(cellSizeDegrees) {}
+
+    void clear() {
+        segments.clear();
+        cells.clear();
+    }
+
+    // Two-way streets are indexed once, from the smaller id, so k-nearest never returns the
+    // same stretch of road twice
+    void build(const unordered_map<string, Node>& graph) {
+        clear();
+        for (const auto& node : graph) {
+            for (const auto& edge : node.second.edges) {
+                auto target = graph.find(edge.first);
+                if (target == graph.end()) continue;
+                if (edge.first < node.first) {
+                    const auto& back = target->second.edges;
+                    bool twoWay = any_of(back.begin(), back.end(),
+                        [&node](const pair<string, double>& e) { return e.first == node.first; });
+                    if (twoWay) continue;
                 }
+                addSegment(node.first, edge.first, node.second.location, target->second.location);
             }
-        } catch (const exception& e) {
-            cerr << "Error in findBestFirstPath: " << e.what() << endl;
         }
-        
-        return {};
     }
 
-    vector<string> findShortestPath(
-        const unordered_map<string, Node>& graph,
-        const string& startId,
-        const string& endId) {
-        
-        try {
-            priority_queue<pair<double, string>, 
-                                vector<pair<double, string>>,
-                                greater<pair<double, string>>> openSet;
-            
-            unordered_map<string, double> gScore;
-            unordered_map<string, string> cameFrom;
-            
-            for (const auto& node : graph) {
-                gScore[node.first] = numeric_limits<double>::infinity();
+    void addSegment(const string& fromId, const string& toId, const Location& from, const Location& to) {
+        uint32_t segmentId = static_cast<uint32_t>(segments.size());
+        segments.push_back({fromId, toId, from.lat, from.lon, to.lat, to.lon});
+
+        // Walk the segment in half-cell steps so long edges only touch the cells they cross
+        double spanLat = to.lat - from.lat;
+        double spanLon = to.lon - from.lon;
+        int steps = max(1, static_cast<int>(ceil(max(fabs(spanLat), fabs(spanLon)) / (cellSize * 0.5))));
+        int64_t lastKey = 0;
+        for (int i = 0; i <= steps; i++) {
+            double t = static_cast<double>(i) / steps;
+            int64_t key = cellKey(cellCoord(from.lat + spanLat * t), cellCoord(from.lon + spanLon * t));
+            if (i > 0 && key == lastKey) continue;
+            vector<uint32_t>& bucket = cells[key];
+            if (bucket.empty() || bucket.back() != segmentId) {
+                bucket.push_back(segmentId);
             }
-            
-            gScore[startId] = 0;
-            openSet.push(make_pair(
-                RouteUtils::getAccurateDistance(
-                    graph.at(startId).location,
-                    graph.at(endId).location
-                ), 
-                startId
-            ));
-            
-            while (!openSet.empty()) {
-                string current = openSet.top().second;
-                openSet.pop();
-                
-                if (current == endId) {
-                    vector<string> path;
-                    while (current != startId) {
-                        path.push_back(current);
-                        current = cameFrom[current];
-                    }
-                    path.push_back(startId);
-                    reverse(path.begin(), path.end());
-                    return path;
-                }
-                
-                for (const auto& neighbor : graph.at(current).edges) {
-                    string neighborId = neighbor.first;
-                    double distance = neighbor.second;
-                    
-                    double tentativeGScore = gScore[current] + distance;
-                    
-                    if (tentativeGScore < gScore[neighborId]) {
-                        cameFrom[neighborId] = current;
-                        gScore[neighborId] = tentativeGScore;
-                        
-                        double heuristic = RouteUtils::getAccurateDistance(
-                            graph.at(neighborId).location,
-                            graph.at(endId).location
-                        );
-                        
-                        double fScore = tentativeGScore + heuristic;
-                        openSet.push(make_pair(fScore, neighborId));
+            lastKey = key;
+        }
+    }
+
+    size_t size() const { return segments.size(); }
+
+    SnapResult snap(double lat, double lon, double maxDistanceKm = 5.0) const {
+        vector<SnapResult> best = nearest(lat, lon, 1, maxDistanceKm);
+        return best.empty() ? SnapResult() : best[0];
+    }
+
+    vector<SnapResult> nearest(double lat, double lon, size_t k, double maxDistanceKm = 5.0) const {
+        vector<SnapResult> results;
+        if (segments.empty() || k == 0) return results;
+
+        thread_local vector<uint32_t> visitStamp;
+        thread_local uint32_t visitEpoch = 0;
+        if (visitStamp.size() < segments.size()) {
+            visitStamp.assign(segments.size(), 0);
+            visitEpoch = 0;
+        }
+        visitEpoch++;
+
+        double kmPerDegLat = 111.32;
+        double kmPerDegLon = 111.32 * max(0.01, cos(lat * M_PI / 180.0));
+        double cellKm = cellSize * min(kmPerDegLat, kmPerDegLon);
+        int maxRing = static_cast<int>(ceil(maxDistanceKm / cellKm)) + 1;
+        int64_t centerLat = cellCoord(lat);
+        int64_t centerLon = cellCoord(lon);
+
+        // Candidates stay as segment ids until the end, so ranking copies no strings
+        thread_local vector<Candidate> best;
+        best.clear();
+        auto worstAccepted = [&]() {
+            return best.size() < k ? maxDistanceKm : best.back().distance;
+        };
+
+        for (int ring = 0; ring <= maxRing; ring++) {
+            // Every unvisited segment has its sampled cells outside this ring, so it lies at
+            // least (ring - 1) cells away; stop once that cannot beat the current k-th result
+            if (ring > 1 && (ring - 1) * cellKm > worstAccepted()) break;
+
+            for (int64_t dy = -ring; dy <= ring; dy++) {
+                for (int64_t dx = -ring; dx <= ring; dx++) {
+                    if (max(llabs(dx), llabs(dy)) != ring) continue;
+                    auto cell = cells.find(cellKey(centerLat + dy, centerLon + dx));
+                    if (cell == cells.end()) continue;
+
+                    for (uint32_t segmentId : cell->second) {
+                        if (visitStamp[segmentId] == visitEpoch) continue;
+                        visitStamp[segmentId] = visitEpoch;
+
+                        Candidate candidate = project(segmentId, lat, lon, kmPerDegLat, kmPerDegLon);
+                        if (candidate.distance > worstAccepted()) continue;
+
+                        auto pos = upper_bound(best.begin(), best.end(), candidate,
+                            [](const Candidate& a, const Candidate& b) { return a.distance < b.distance; });
+                        best.insert(pos, candidate);
+                        if (best.size() > k) best.pop_back();
                     }
                 }
             }
-        } catch (const exception& e) {
-            cerr << "Error in findShortestPath: " << e.what() << endl;
         }
-        
-        return {};
+
+        for (const Candidate& candidate : best) {
+            const Segment& seg = segments[candidate.segment];
+            SnapResult result;
+            result.fromId = seg.fromId;
+            result.toId = seg.toId;
+            result.ratio = candidate.ratio;
+            result.lat = seg.lat1 + (seg.lat2 - seg.lat1) * candidate.ratio;
+            result.lon = seg.lon1 + (seg.lon2 - seg.lon1) * candidate.ratio;
+            result.distance = RouteUtils::calculateDistance(lat, lon, result.lat, result.lon);
+            results.push_back(move(result));
+        }
+        return results;
     }
 
-    void addIntermediateLocationsToGraph(
-        unordered_map<string, Node>& graph,
-        const string& startId,
-        const string& endId,
-        const Location& startLocation,
-        const Location& endLocation,
-        const string& startCity,
-        const string& endCity) {
+private:
+    struct Candidate {
+        uint32_t segment;
+        double ratio;
+        double distance;                                    // km in the query's flat frame
+    };
+
+    double cellSize;
+    vector<Segment> segments;
+    unordered_map<int64_t, vector<uint32_t>> cells;
+
+    int64_t cellCoord(double degrees) const {
+        return static_cast<int64_t>(floor(degrees / cellSize));
+    }
+
+    static int64_t cellKey(int64_t latCell, int64_t lonCell) {
+        return (latCell << 32) ^ (lonCell & 0xffffffffLL);
+    }
+
+    // Orthogonal projection in a local flat frame centred on the query point
+    Candidate project(uint32_t segmentId, double lat, double lon, double kmPerDegLat, double kmPerDegLon) const {
+        const Segment& seg = segments[segmentId];
+        double ax = (seg.lon1 - lon) * kmPerDegLon, ay = (seg.lat1 - lat) * kmPerDegLat;
+        double bx = (seg.lon2 - lon) * kmPerDegLon, by = (seg.lat2 - lat) * kmPerDegLat;
+        double dx = bx - ax, dy = by - ay;
+        double lengthSq = dx * dx + dy * dy;
+        double t = lengthSq > 0 ? -(ax * dx + ay * dy) / lengthSq : 0;
+        t = max(0.0, min(1.0, t));
+
+        double px = ax + dx * t, py = ay + dy * t;
+        return {segmentId, t, sqrt(px * px + py * py)};
+    }
+};
+
+// Coalesces concurrent calls for the same key: the first caller runs the work and
+// everyone who arrives while it is in flight waits for and shares that result.
+template <typename Key, typename Value>
+class SingleFlight {
+public:
+    Value run(const Key& key, const function<Value()>& work) {
+        unique_lock<mutex> lock(flightMutex);
+        auto it = inFlight.find(key);
+        if (it != inFlight.end()) {
+            shared_future<Value> pending = it->second;
+            lock.unlock();
+            return pending.get();
+        }
         
-        auto intermediates = intermediateDB.getIntermediates(startCity, endCity);
-        if (intermediates.empty()) return;
+        promise<Value> leader;
+        shared_future<Value> result = leader.get_future().share();
+        inFlight[key] = result;
+        lock.unlock();
         
-        for (size_t i = 0; i < intermediates.size(); i++) {
-            const auto& [name, coords] = intermediates[i];
-            const auto& [lat, lon] = coords;
-            
-            string nodeId = "intermediate_" + to_string(i);
-            Location loc(name, lat, lon);
-            graph[nodeId] = Node(nodeId, loc);
-            
-            if (i == 0) {
-                double dist = RouteUtils::getAccurateDistance(startLocation, loc);
-                graph[startId].edges.push_back(make_pair(nodeId, dist));
-            } else {
-                string prevId = "intermediate_" + to_string(i-1);
-                double dist = RouteUtils::getAccurateDistance(graph[prevId].location, loc);
-                graph[prevId].edges.push_back(make_pair(nodeId, dist));
-            }
-            
-            if (i == intermediates.size() - 1) {
-                double dist = RouteUtils::getAccurateDistance(loc, endLocation);
-                graph[nodeId].edges.push_back(make_pair(endId, dist));
-            }
+        try {
+            leader.set_value(work());
+        } catch (...) {
+            leader.set_exception(current_exception());
         }
+        
+        lock.lock();
+        inFlight.erase(key);
+        lock.unlock();
+        return result.get();
     }
 
-    vector<vector<string>> generateMultipleRoutes(
-        unordered_map<string, Node>& graph,
-        const string& startId,
-        const string& endId,
-        const Location& startLocation,
-        const Location& endLocation,
-        RouteType routeType = FASTEST) {
-        
-        vector<vector<string>> routes;
-        
-        try {
-            vector<string> directPath = findBestFirstPath(graph, startId, endId);
-            if (!directPath.empty()) {
-                routes.push_back(directPath);
-            }
-            
-            vector<Location> intermediateLocations;
-            string startCity = Location::extractCityName(startLocation.name);
-            string endCity = Location::extractCityName(endLocation.name);
-            bool foundKnownRoute = false;
-            
-            static unordered_map<string, unordered_map<string, vector<string>>> knownIntermediates = {
-                {"Surabaya", {
-                    {"Gresik", {"Tandes", "Benowo"}}, 
-                    {"Sidoarjo", {"Wonokromo", "Waru"}},
-                    {"Malang", {"Sidoarjo", "Pandaan", "Lawang"}},
-                    {"Probolinggo", {"Sidoarjo", "Pasuruan", "Kraksaan"}}
-                }},
-                {"Jakarta", {
-                    {"Bandung", {"Bekasi", "Purwakarta", "Cimahi"}},
-                    {"Bogor", {"Depok", "Cibinong"}}
-                }}
-            };
-            
-            auto it1 = knownIntermediates.find(startCity);
-            if (it1 != knownIntermediates.end()) {
-                auto it2 = it1->second.find(endCity);
-                if (it2 != it1->second.end()) {
-                    foundKnownRoute = true;
-                    const auto& waypoints = it2->second;
-                    
-                    for (size_t i = 0; i < waypoints.size(); i++) {
-                        string nodeId = "known_waypoint" + to_string(i+1);
-                        double ratio = (i+1.0) / (waypoints.size()+1.0);
-                        double lat = startLocation.lat + (endLocation.lat - startLocation.lat) * ratio;
-                        double lon = startLocation.lon + (endLocation.lon - startLocation.lon) * ratio;
-                        Location wp(waypoints[i], lat, lon);
-                        graph[nodeId] = Node(nodeId, wp);
-                        
-                        if (i == 0) {
-                            double dist = RouteUtils::getAccurateDistance(startLocation, wp);
-                            graph[startId].edges.push_back(make_pair(nodeId, dist));
-                            dist = RouteUtils::getAccurateDistance(wp, endLocation);
-                            graph[nodeId].edges.push_back(make_pair(endId, dist));
-                        } else {
-                            string prevId = "known_waypoint" + to_string(i);
-                            double dist = RouteUtils::getAccurateDistance(graph[prevId].location, wp);
-                            graph[prevId].edges.push_back(make_pair(nodeId, dist));
-                            dist = RouteUtils::getAccurateDistance(wp, endLocation);
-                            graph[nodeId].edges.push_back(make_pair(endId, dist));
-                        }
-                    }
-                }
-            }
-            
-            if (!foundKnownRoute) {
-                addIntermediateLocationsToGraph(graph, startId, endId, 
-                    startLocation, endLocation, startCity, endCity);
-                
-                bool hasIntermediates = false;
-                for (const auto& edge : graph[startId].edges) {
-                    if (edge.first != endId && edge.first.find("intermediate_") != string::npos) {
-                        hasIntermediates = true;
-                        break;
-                    }
-                }
-                if (hasIntermediates) foundKnownRoute = true;
-            }
+private:
+    mutex flightMutex;
+    unordered_map<Key, shared_future<Value>> inFlight;
+};
 
-            if (!foundKnownRoute && (routeType == AVOID_TOLLS || routeType == SCENIC)) {
-                for (int i = 1; i <= 3; i++) {
-                    double ratio = i / 4.0;
-                    double latOffset = (i % 2 == 0) ? 0.01 : -0.01;
-                    double lonOffset = (i % 2 == 0) ? -0.01 : 0.01;
-                    
-                    if (routeType == SCENIC) {
-                        latOffset *= 2;
-                        lonOffset *= 2;
-                    }
-                    
-                    string waypointName = waypointDB.getWaypointName(
-                        Location::extractCityName(startLocation.name),
-                        Location::extractCityName(endLocation.name),
-                        i-1
-                    );
-                    
-                    Location intermediate(
-                        waypointName,
-                        startLocation.lat + (endLocation.lat - startLocation.lat) * ratio + latOffset,
-                        startLocation.lon + (endLocation.lon - startLocation.lon) * ratio + lonOffset
-                    );
-                    intermediateLocations.push_back(intermediate);
-                    
-                    string nodeId = "waypoint" + to_string(i);
-                    graph[nodeId] = Node(nodeId, intermediate);
-                }
-                
-                for (size_t i = 0; i < intermediateLocations.size(); i++) {
-                    string nodeId = "waypoint" + to_string(i+1);
-                    graph[startId].edges.push_back(make_pair(nodeId, 
-                        RouteUtils::getAccurateDistance(
-                            graph[startId].location, 
-                            graph[nodeId].location
-                        )
-                    ));
-                    graph[nodeId].edges.push_back(make_pair(endId, 
-                        RouteUtils::getAccurateDistance(
-                            graph[nodeId].location, 
-                            graph[endId].location
-                        )
-                    ));
-                    
-                    if (i > 0) {
-                        string prevNodeId = "waypoint" + to_string(i);
-                        graph[prevNodeId].edges.push_back(make_pair(nodeId, 
-                            RouteUtils::getAccurateDistance(
-                                graph[prevNodeId].location, 
-                                graph[nodeId].location
-                            )
-                        ));
-                    }
-                }
-            } else if (!foundKnownRoute) {
-                for (int i = 1; i <= 2; i++) {
-                    double ratio = i / 3.0;
-                    double latOffset = (i % 2 == 0) ? 0.005 : -0.005;
-                    double lonOffset = (i % 2 == 0) ? -0.005 : 0.005;
-                    
-                    string waypointName = waypointDB.getWaypointName(
-                        Location::extractCityName(startLocation.name),
-                        Location::extractCityName(endLocation.name),
-                        i-1
-                    );
-                    
-                    Location intermediate(
-                        waypointName,
-                        startLocation.lat + (endLocation.lat - startLocation.lat) * ratio + latOffset,
-                        startLocation.lon + (endLocation.lon - startLocation.lon) * ratio + lonOffset
-                    );
-                    
-                    string nodeId = "waypoint" + to_string(i);
-                    graph[nodeId] = Node(nodeId, intermediate);
-                    
-                    if (i == 1) {
-                        double dist = RouteUtils::getAccurateDistance(startLocation, intermediate);
-                        graph[startId].edges.push_back(make_pair(nodeId, dist));
-                        dist = RouteUtils::getAccurateDistance(intermediate, endLocation);
-                        graph[nodeId].edges.push_back(make_pair(endId, dist));
-                    } else {
-                        string prevId = "waypoint" + to_string(i-1);
-                        double dist = RouteUtils::getAccurateDistance(startLocation, intermediate);
-                        graph[startId].edges.push_back(make_pair(nodeId, dist));
-                        dist = RouteUtils::getAccurateDistance(graph[prevId].location, intermediate);
-                        graph[prevId].edges.push_back(make_pair(nodeId, dist));
-                        dist = RouteUtils::getAccurateDistance(intermediate, endLocation);
-                        graph[nodeId].edges.push_back(make_pair(endId, dist));
-                    }
-                }
-            }
-            
-            vector<string> altPath1 = findBestFirstPath(graph, startId, endId);
-            if (!altPath1.empty() && (routes.empty() || altPath1 != routes[0])) {
-                routes.push_back(altPath1);
-            }
-            
-            vector<string> altPath2 = findShortestPath(graph, startId, endId);
-            if (!altPath2.empty() && (routes.empty() || altPath2 != routes[0]) && 
-                (routes.size() < 2 || altPath2 != routes[1])) {
-                routes.push_back(altPath2);
-            }
-        } catch (const exception& e) {
-            cerr << "Error in generateMultipleRoutes: " << e.what() << endl;
+// Bounded, thread-safe least-recently-used map
+template <typename Key, typename Value>
+class LruCache {
+public:
+    explicit LruCache(size_t maxEntries)
+        : capacity(max<size_t>(1, maxEntries)) {}
+
+    bool get(const Key& key, Value& value) {
+        lock_guard<mutex> lock(cacheMutex);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            misses++;
+            return false;
         }
-        
-        return routes;
+        entries.splice(entries.begin(), entries, it->second);
+        value = it->second->second;
+        hits++;
+        return true;
     }
 
-    vector<string> getRouteDetails(const Location& start, const Location& end, RouteType routeType = FASTEST) {
-        vector<string> steps;
-        string startCity = Location::extractCityName(start.name);
-        string endCity = Location::extractCityName(end.name);
-        
-        vector<string> dbRoads = roadDB.getRoadNames(startCity, endCity, routeType);
-        if (!dbRoads.empty()) {
-            return dbRoads;
-        }
-        
-        try {
-            string routeParams;
-            switch (routeType) {
-                case FASTEST: routeParams = "steps=true&overview=full"; break;
-                case SHORTEST: routeParams = "steps=true&overview=full&alternatives=false&geometries=geojson"; break;
-                case AVOID_TOLLS: routeParams = "steps=true&overview=full&exclude=toll"; break;
-                case SCENIC: routeParams = "steps=true&overview=full"; break;
-                default: routeParams = "steps=true&overview=full";
-            }
-            
-            string url = "router.project-osrm.org";
-            string path = "/route/v1/driving/" + 
-                        to_string(start.lon) + "," + to_string(start.lat) + ";" +
-                        to_string(end.lon) + "," + to_string(end.lat) + 
-                        "?" + routeParams;
-            
-            httplib::Client cli("https://" + url);
-            httplib::Headers headers = {{"User-Agent", "MapsPathfinder/1.0"}};
-            
-            auto res = cli.Get(path.c_str(), headers);
-            
-            if (res && res->status == 200) {
-                auto json = nlohmann::json::parse(res->body);
-                auto& routes = json["routes"];
-                
-                if (!routes.empty()) {
-                    auto& legs = routes[0]["legs"];
-                    if (!legs.empty()) {
-                        auto& steps_json = legs[0]["steps"];
-                        for (auto& step : steps_json) {
-                            string road_name = "unnamed road";
-                            if (step.contains("name") && !step["name"].is_null() && !step["name"].get<string>().empty()) {
-                                road_name = step["name"];
-                            }
-                            if (steps.empty() || road_name != steps.back()) {
-                                steps.push_back(road_name);
-                            }
-                        }
-                    }
-                }
-            } else {
-                throw runtime_error("Failed to get route from OSRM API");
-            }
-        } catch (const exception& e) {
-            cerr << "Error in getRouteDetails: " << e.what() << endl;
+    void put(const Key& key, const Value& value) {
+        lock_guard<mutex> lock(cacheMutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            it->second->second = value;
+            entries.splice(entries.begin(), entries, it->second);
+            return;
         }
-        
-        if (steps.empty()) {
-            auto intermediates = intermediateDB.getIntermediates(startCity, endCity);
-            vector<string> cityNames;
-            for (const auto& item : intermediates) {
-                cityNames.push_back(item.first);
-            }
-            
-            if (!cityNames.empty()) {
-                steps = roadDB.generateDetailedRoadNames(startCity, endCity, cityNames, routeType);
-            } else {
-                steps.push_back("Jalan Raya " + startCity);
-                double distance = RouteUtils::getAccurateDistance(start, end);
-                int segments = max(1, min(10, static_cast<int>(distance / 30)));
-                
-                for (int i = 1; i <= segments; i++) {
-                    if (i % 3 == 0) {
-                        steps.push_back("Jalan Lintas " + startCity + "-" + endCity + " (Segmen " + to_string(i) + ")");
-                    } else if (i % 2 == 0) {
-                        steps.push_back("Jalan Kabupaten " + to_string(i));
-                    } else {
-                        steps.push_back("Jalan Provinsi " + startCity + "-" + endCity);
-                    }
-                }
-                steps.push_back("Jalan Masuk " + endCity);
-            }
-            
-            if (routeType == AVOID_TOLLS) {
-                vector<string> filteredSteps;
-                for (const auto& step : steps) {
-                    if (step.find("Tol") == string::npos) {
-                        filteredSteps.push_back(step);
-                    } else {
-                        filteredSteps.push_back("Jalan Alternatif " + step.substr(4));
-                    }
-                }
-                return filteredSteps;
-            }
+        entries.emplace_front(key, value);
+        index[key] = entries.begin();
+        if (entries.size() > capacity) {
+            index.erase(entries.back().first);
+            entries.pop_back();
         }
-        
-        return steps;
     }
 
-    vector<TollInfo> getTollInfo(const Location& start, const Location& end, RouteType routeType, 
-                              double& totalCost, string& currency) {
-        vector<TollInfo> tolls;
-        totalCost = 0;
-        currency = "IDR";
-        
-        if (routeType == AVOID_TOLLS) {
-            return tolls;
+    void clear() {
+        lock_guard<mutex> lock(cacheMutex);
+        entries.clear();
+        index.clear();
+    }
+
+    size_t size() {
+        lock_guard<mutex> lock(cacheMutex);
+        return entries.size();
+    }
+
+    size_t hitCount() {
+        lock_guard<mutex> lock(cacheMutex);
+        return hits;
+    }
+
+    size_t missCount() {
+        lock_guard<mutex> lock(cacheMutex);
+        return misses;
+    }
+
+private:
+    size_t capacity;
+    list<pair<Key, Value>> entries;     // most recently used first
+    unordered_map<Key, typename list<pair<Key, Value>>::iterator> index;
+    size_t hits = 0;
+    size_t misses = 0;
+    mutex cacheMutex;
+};
+
+// LruCache split into independently locked shards by key hash, so threads reading
+// different keys rarely wait on each other
+template <typename Key, typename Value, size_t ShardCount = 16>
+class ShardedLruCache {
+public:
+    explicit ShardedLruCache(size_t maxEntries) {
+        for (auto& shard : shards) {
+            shard = make_unique<LruCache<Key, Value>>((maxEntries + ShardCount - 1) / ShardCount);
         }
-        
-        string startCity = Location::extractCityName(start.name);
-        string endCity = Location::extractCityName(end.name);
-        
-        static unordered_map<string, unordered_map<string, vector<TollInfo>>> knownTolls = {
-            {"Jakarta", {
-                {"Bogor", {
-                    TollInfo("Jagorawi Toll Road", "Jasa Marga", 15000),
-                    TollInfo("Jakarta Inner Ring Road", "Jasa Marga", 10000)
-                }},
-                {"Bandung", {
-                    TollInfo("Cipularang Toll Road", "Jasa Marga", 35000),
-                    TollInfo("Jakarta-Cikampek Toll Road", "Jasa Marga", 25000)
-                }},
-                {"Bekasi", {
-                    TollInfo("Jakarta-Cikampek Toll Road", "Jasa Marga", 12000)
-                }},
-                {"Tangerang", {
-                    TollInfo("Jakarta-Tangerang Toll Road", "Jasa Marga", 11000)
-                }}
-            }},
-            {"Surabaya", {
-                {"Sidoarjo", {
-                    TollInfo("Surabaya-Gempol Toll Road", "Jasa Marga", 7500)
-                }},
-                {"Malang", {
-                    TollInfo("Surabaya-Malang Toll Road", "Jasa Marga", 28000)
-                }},
-                {"Gresik", {
-                    TollInfo("MERR Toll Road", "Jasa Marga", 7000)
-                }},
-                {"Mojokerto", {
-                    TollInfo("Surabaya-Mojokerto Toll Road", "Jasa Marga", 17500)
-                }},
-                {"Probolinggo", {
-                    TollInfo("Surabaya-Probolinggo Toll Road", "Jasa Marga", 25000)
-                }}
-            }},
-            {"Bandung", {
-                {"Jakarta", {
-                    TollInfo("Cipularang Toll Road", "Jasa Marga", 35000),
-                    TollInfo("Jakarta-Cikampek Toll Road", "Jasa Marga", 25000)
-                }},
-                {"Cimahi", {
-                    TollInfo("Padalarang-Cileunyi Toll Road", "Jasa Marga", 8000)
-                }}
-            }}
-        };
-        
-        auto it1 = knownTolls.find(startCity);
-        if (it1 != knownTolls.end()) {
-            auto it2 = it1->second.find(endCity);
-            if (it2 != it1->second.end()) {
-                tolls = it2->second;
-                for (const auto& toll : tolls) {
-                    totalCost += toll.cost;
-                }
-            }
+    }
+
+    bool get(const Key& key, Value& value) { return shardFor(key).get(key, value); }
+    void put(const Key& key, const Value& value) { shardFor(key).put(key, value); }
+
+    void clear() {
+        for (auto& shard : shards) shard->clear();
+    }
+
+    size_t size() {
+        size_t total = 0;
+        for (auto& shard : shards) total += shard->size();
+        return total;
+    }
+
+    size_t hitCount() {
+        size_t total = 0;
+        for (auto& shard : shards) total += shard->hitCount();
+        return total;
+    }
+
+    size_t missCount() {
+        size_t total = 0;
+        for (auto& shard : shards) total += shard->missCount();
+        return total;
+    }
+
+private:
+    array<unique_ptr<LruCache<Key, Value>>, ShardCount> shards;
+
+    LruCache<Key, Value>& shardFor(const Key& key) {
+        return *shards[hash<Key>()(key) % ShardCount];
+    }
+};
+
+// Fixed-size pool of worker threads draining a FIFO task queue
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threadCount) {
+        threadCount = max<size_t>(1, threadCount);
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this]() { workerLoop(); });
         }
-        
-        if (tolls.empty()) {
-            it1 = knownTolls.find(endCity);
-            if (it1 != knownTolls.end()) {
-                auto it2 = it1->second.find(startCity);
-                if (it2 != it1->second.end()) {
-                    tolls = it2->second;
-                    for (const auto& toll : tolls) {
-                        totalCost += toll.cost;
-                    }
-                }
-            }
+    }
+
+    ~WorkerPool() {
+        shutdown();
+    }
+
+    void submit(function<void()> task) {
+        {
+            lock_guard<mutex> lock(poolMutex);
+            tasks.push(move(task));
         }
-        
-        if (tolls.empty() && RouteUtils::getAccurateDistance(start, end) > 50) {
-            double distance = RouteUtils::getAccurateDistance(start, end);
-            double estimatedCost = distance * 1000;
-            tolls.push_back(TollInfo("Estimated Toll", "Various Operators", estimatedCost));
-            totalCost = estimatedCost;
+        taskReady.notify_one();
+    }
+
+    // submit, unless maxQueued tasks are already waiting for a worker
+    bool trySubmit(function<void()> task, size_t maxQueued) {
+        {
+            lock_guard<mutex> lock(poolMutex);
+            if (tasks.size() >= maxQueued) return false;
+            tasks.push(move(task));
         }
-        
-        return tolls;
+        taskReady.notify_one();
+        return true;
     }
 
-    string formatRoute(
-        const vector<string>& path,
-        const unordered_map<string, Node>& graph,
-        RouteType routeType = FASTEST) {
-        
-        if (path.empty()) return "No route available";
-        
-        string result;
-        double totalDistance = 0;
-        double totalTime = 0;
-        
-        try {
-            for (size_t i = 0; i < path.size() - 1; i++) {
-                const auto& currentNode = graph.at(path[i]);
-                const auto& nextNode = graph.at(path[i+1]);
-                
-                double segmentDistance = 0;
-                for (const auto& edge : currentNode.edges) {
-                    if (edge.first == path[i+1]) {
-                        segmentDistance = edge.second;
-                        break;
-                    }
-                }
-                
-                result += currentNode.location.name;
-                vector<string> roadNames = getRouteDetails(
-                    currentNode.location, nextNode.location, routeType);
-                
-                for (const auto& road : roadNames) {
-                    result += " → " + road;
-                }
-                
-                if (i == path.size() - 2) {
-                    result += " → " + nextNode.location.name;
-                }
-                
-                totalDistance += segmentDistance;
+    // Blocks until the queue is empty and no task is running
+    void waitIdle() {
+        unique_lock<mutex> lock(poolMutex);
+        idle.wait(lock, [this]() { return tasks.empty() && activeTasks == 0; });
+    }
+
+    void shutdown() {
+        {
+            lock_guard<mutex> lock(poolMutex);
+            if (stopping) return;
+            stopping = true;
+        }
+        taskReady.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex poolMutex;
+    condition_variable taskReady;
+    condition_variable idle;
+    size_t activeTasks = 0;
+    bool stopping = false;
+
+    void workerLoop() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(poolMutex);
+                taskReady.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = move(tasks.front());
+                tasks.pop();
+                activeTasks++;
             }
             
-            double speed = 60.0;
-            switch (routeType) {
-                case FASTEST: speed = 60.0; break;
-                case SHORTEST: speed = 50.0; break;
-                case AVOID_TOLLS: speed = 45.0; break;
-                case SCENIC: speed = 40.0; break;
+            try {
+                task();
+            } catch (const exception& e) {
+                cerr << "Error in worker task: " << e.what() << endl;
             }
-            totalTime = (totalDistance / speed) * 60;
-            
-            int hours = static_cast<int>(totalTime) / 60;
-            int minutes = static_cast<int>(totalTime) % 60;
             
-            result += " (" + to_string(static_cast<int>(totalDistance)) + " km, ";
-            if (hours > 0) {
-                result += to_string(hours) + " hr ";
+            {
+                lock_guard<mutex> lock(poolMutex);
+                activeTasks--;
+                if (tasks.empty() && activeTasks == 0) idle.notify_all();
             }
-            result += to_string(minutes) + " min)";
-            
-            if (routeType != AVOID_TOLLS && path.size() >= 2) {
-                double tollCost = 0;
-                string currency = "IDR";
-                const auto& startNode = graph.at(path.front());
-                const auto& endNode = graph.at(path.back());
-                vector<TollInfo> tolls = getTollInfo(startNode.location, endNode.location, routeType, tollCost, currency);
-                
-                if (!tolls.empty()) {
-                    result += "\nTotal Toll Cost: " + RouteUtils::formatCurrency(tollCost, currency);
+        }
+    }
+};
+
+// Token bucket: at most `rate` acquisitions per second on average, bursts up to `burst`
+class TokenBucket {
+public:
+    TokenBucket(double ratePerSecond, double burstSize)
+        : rate(max(ratePerSecond, 1e-6)), burst(max(burstSize, 1.0)), tokens(burst),
+          lastRefill(chrono::steady_clock::now()) {}
+
+    void acquire() {
+        while (true) {
+            chrono::duration<double> wait;
+            {
+                lock_guard<mutex> lock(bucketMutex);
+                refill();
+                if (tokens >= 1.0) {
+                    tokens -= 1.0;
+                    return;
                 }
-            } else if (routeType == AVOID_TOLLS) {
-                result += "\nThis route avoids all toll roads.";
+                wait = chrono::duration<double>((1.0 - tokens) / rate);
             }
-        } catch (const exception& e) {
-            cerr << "Error in formatRoute: " << e.what() << endl;
-            return "Error generating route details";
+            this_thread::sleep_for(wait);
         }
-        
-        return RouteUtils::cleanRouteSymbols(result);
     }
 
-    string formatRouteWithRealDirections(
-        const vector<string>& path,
-        const unordered_map<string, Node>& graph,
-        RouteType routeType = FASTEST) {
+    // Reserves the next token if it comes due by `limit` and sleeps until it does; false,
+    // reserving nothing, when it would come too late
+    bool acquireBy(chrono::steady_clock::time_point limit) {
+        chrono::duration<double> wait;
+        {
+            lock_guard<mutex> lock(bucketMutex);
+            refill();
+            wait = chrono::duration<double>(max(0.0, (1.0 - tokens) / rate));
+            if (chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(wait) > limit) {
+                return false;
+            }
+            tokens -= 1.0;
+        }
+        if (wait.count() > 0) this_thread::sleep_for(wait);
+        return true;
+    }
+
+private:
+    double rate;
+    double burst;
+    double tokens;
+    chrono::steady_clock::time_point lastRefill;
+    mutex bucketMutex;
+
+    void refill() {
+        auto now = chrono::steady_clock::now();
+        tokens = min(burst, tokens + chrono::duration<double>(now - lastRefill).count() * rate);
+        lastRefill = now;
+    }
+};
+
+// Base URLs of the remote services. Defaults can be overridden with the MAPS_NOMINATIM_URL
+// and MAPS_OSRM_URL environment variables or the matching command line flags, e.g. to
+// point a run at --mock-upstream. Set once at startup, before any request is made.
+class UpstreamConfig {
+public:
+    static string& nominatimUrl() {
+        static string url = fromEnvironment("MAPS_NOMINATIM_URL", "https://nominatim.openstreetmap.org");
+        return url;
+    }
+
+    static string& osrmUrl() {
+        static string url = fromEnvironment("MAPS_OSRM_URL", "https://router.project-osrm.org");
+        return url;
+    }
+
+    // Requests per second a host's usage policy allows, 0 when it sets none. The public
+    // Nominatim instance allows one.
+    static double requestRateLimit(const string& url) {
+        return url.find("nominatim.openstreetmap.org") != string::npos ? 1.0 : 0.0;
+    }
+
+private:
+    static string fromEnvironment(const char* name, const string& fallback) {
+        const char* value = getenv(name);
+        return value && *value ? string(value) : fallback;
+    }
+};
+
+// Point in time a caller needs an answer by. A default-constructed deadline is unset and
+// leaves the budget to the callee.
+class Deadline {
+public:
+    Deadline() = default;
+
+    static Deadline after(chrono::milliseconds budget) {
+        Deadline deadline;
+        deadline.expiry = chrono::steady_clock::now() + budget;
+        deadline.set = true;
+        return deadline;
+    }
+
+    bool isSet() const { return set; }
+    bool expired() const { return set && chrono::steady_clock::now() >= expiry; }
+    chrono::steady_clock::time_point at() const { return expiry; }
+
+    // The earlier of this deadline and now + cap
+    Deadline capped(chrono::milliseconds cap) const {
+        Deadline limit = after(cap);
+        return set && expiry < limit.expiry ? *this : limit;
+    }
+
+    chrono::milliseconds remaining() const {
+        auto left = chrono::duration_cast<chrono::milliseconds>(expiry - chrono::steady_clock::now());
+        return max(left, chrono::milliseconds(0));
+    }
+
+private:
+    chrono::steady_clock::time_point expiry;
+    bool set = false;
+};
+
+// Keep-alive HTTP(S) clients shared per upstream host. acquire() hands out an idle client,
+// creates one while under the size limit, or waits for a lease to come back. A returned
+// client keeps its TCP/TLS connection open, so steady traffic pays one handshake per pooled
+// connection instead of one per request. Clients idle past the timeout are dropped.
+class HttpClientPool {
+public:
+    // Exclusive use of one pooled client; goes back to the pool when destroyed
+    class Lease {
+    public:
+        Lease(HttpClientPool* owner, unique_ptr<httplib::Client> cli)
+            : pool(owner), client(move(cli)) {}
+        Lease(Lease&& other) noexcept = default;
+        Lease& operator=(Lease&&) = delete;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        ~Lease() {
+            if (pool && client) pool->release(move(client));
+        }
+
+        httplib::Client* operator->() { return client.get(); }
+        httplib::Client& operator*() { return *client; }
+        explicit operator bool() const { return client != nullptr; }
+
+        // Drop the connection instead of reusing it, e.g. after a transport error
+        void discard() {
+            if (pool && client) pool->forget();
+            client.reset();
+        }
+
+    private:
+        HttpClientPool* pool;
+        unique_ptr<httplib::Client> client;
+    };
+
+    HttpClientPool(const string& url, size_t maxClients = 8, chrono::seconds idleLimit = chrono::seconds(60))
+        : baseUrl(url), maxSize(max<size_t>(1, maxClients)), idleTimeout(idleLimit) {}
+
+    // Shared pool for a base URL such as "https://nominatim.openstreetmap.org"
+    static HttpClientPool& forHost(const string& url) {
+        lock_guard<mutex> lock(registryMutex());
+        auto& pools = registry();
+        auto it = pools.find(url);
+        if (it == pools.end()) {
+            it = pools.emplace(url, make_unique<HttpClientPool>(url, defaultMaxSize(), defaultIdleTimeout())).first;
+        }
+        return *it->second;
+    }
+
+    // Limits for pools created after this call
+    static void setDefaultLimits(size_t maxClients, chrono::seconds idleLimit) {
+        lock_guard<mutex> lock(registryMutex());
+        defaultMaxSize() = max<size_t>(1, maxClients);
+        defaultIdleTimeout() = idleLimit;
+    }
+
+    // An empty lease when no client frees up before deadline; an unset deadline waits as
+    // long as it takes
+    Lease acquire(Deadline deadline = Deadline()) {
+        unique_lock<mutex> lock(poolMutex);
+        evictIdle();
+        auto ready = [this]() { return !idle.empty() || created < maxSize; };
+        if (!deadline.isSet()) {
+            available.wait(lock, ready);
+        } else if (!available.wait_until(lock, deadline.at(), ready)) {
+            return Lease(this, nullptr);
+        }
         
-        if (path.empty()) return "No route available";
+        if (!idle.empty()) {
+            unique_ptr<httplib::Client> client = move(idle.back().client);
+            idle.pop_back();
+            return Lease(this, move(client));
+        }
+        created++;
+        lock.unlock();
         
-        string result;
-        double totalDistance = 0;
-        double totalTime = 0;
-        double tollCost = 0;
-        string currency = "IDR";
-        vector<TollInfo> tolls;
+        auto client = make_unique<httplib::Client>(baseUrl);
+        client->set_keep_alive(true);
+        return Lease(this, move(client));
+    }
+
+    size_t idleCount() {
+        lock_guard<mutex> lock(poolMutex);
+        return idle.size();
+    }
+
+    size_t capacity() const {
+        return maxSize;
+    }
+
+    size_t openCount() {
+        lock_guard<mutex> lock(poolMutex);
+        return created;
+    }
+
+private:
+    struct IdleClient {
+        unique_ptr<httplib::Client> client;
+        chrono::steady_clock::time_point since;
+    };
+
+    string baseUrl;
+    size_t maxSize;
+    chrono::seconds idleTimeout;
+    vector<IdleClient> idle;      // most recently returned last, so reuse favours warm connections
+    size_t created = 0;           // leased plus idle
+    mutex poolMutex;
+    condition_variable available;
+
+    static mutex& registryMutex() {
+        static mutex instance;
+        return instance;
+    }
+
+    static unordered_map<string, unique_ptr<HttpClientPool>>& registry() {
+        static unordered_map<string, unique_ptr<HttpClientPool>> instance;
+        return instance;
+    }
+
+    static size_t& defaultMaxSize() {
+        static size_t instance = 8;
+        return instance;
+    }
+
+    static chrono::seconds& defaultIdleTimeout() {
+        static chrono::seconds instance(60);
+        return instance;
+    }
+
+    void release(unique_ptr<httplib::Client> client) {
+        {
+            lock_guard<mutex> lock(poolMutex);
+            idle.push_back({move(client), chrono::steady_clock::now()});
+            evictIdle();
+        }
+        available.notify_one();
+    }
+
+    void forget() {
+        {
+            lock_guard<mutex> lock(poolMutex);
+            created--;
+        }
+        available.notify_one();
+    }
+
+    // Caller holds poolMutex; idle is ordered by return time
+    void evictIdle() {
+        auto cutoff = chrono::steady_clock::now() - idleTimeout;
+        size_t expired = 0;
+        while (expired < idle.size() && idle[expired].since < cutoff) expired++;
+        if (expired == 0) return;
+        idle.erase(idle.begin(), idle.begin() + expired);
+        created -= expired;
+        available.notify_all();
+    }
+};
+
+// Closed until failureThreshold consecutive failures, then open (every call refused) for
+// openDuration, then half-open: one probe is let through and its outcome decides.
+class CircuitBreaker {
+public:
+    CircuitBreaker(size_t threshold = 5, chrono::milliseconds cooldown = chrono::milliseconds(30000))
+        : failureThreshold(threshold), openDuration(cooldown) {}
+
+    bool allow() {
+        lock_guard<mutex> lock(breakerMutex);
+        if (state == CLOSED) return true;
+        if (state == OPEN && chrono::steady_clock::now() >= openedAt + openDuration) {
+            state = HALF_OPEN;
+            probeInFlight = false;
+        }
+        if (state == HALF_OPEN && !probeInFlight) {
+            probeInFlight = true;
+            return true;
+        }
+        return false;
+    }
+
+    void recordSuccess() {
+        lock_guard<mutex> lock(breakerMutex);
+        state = CLOSED;
+        consecutiveFailures = 0;
+        probeInFlight = false;
+    }
+
+    void recordFailure() {
+        lock_guard<mutex> lock(breakerMutex);
+        consecutiveFailures++;
+        if (state == HALF_OPEN || consecutiveFailures >= failureThreshold) {
+            state = OPEN;
+            openedAt = chrono::steady_clock::now();
+            probeInFlight = false;
+        }
+    }
+
+    // The call let through by allow() ended without saying anything about the upstream
+    // (e.g. the caller's deadline ran out), so a half-open breaker may probe again
+    void recordInconclusive() {
+        lock_guard<mutex> lock(breakerMutex);
+        probeInFlight = false;
+    }
+
+    bool isOpen() {
+        lock_guard<mutex> lock(breakerMutex);
+        return state == OPEN;
+    }
+
+private:
+    enum State { CLOSED, OPEN, HALF_OPEN };
+
+    size_t failureThreshold;
+    chrono::milliseconds openDuration;
+    State state = CLOSED;
+    size_t consecutiveFailures = 0;
+    bool probeInFlight = false;
+    chrono::steady_clock::time_point openedAt;
+    mutex breakerMutex;
+};
+
+// Deadline-bounded GETs against one upstream host. If the first attempt has not answered
+// within the host's recent p95 latency, one hedged duplicate goes out on another pooled
+// connection and whichever answers first wins. Hosts with a request rate policy are never
+// hedged, and every caller in the process shares one token bucket for them. Attempts run
+// on a per-host worker pool sized to the connection pool, with a bounded backlog. Transport
+// errors and 5xx feed a circuit breaker, so during an outage calls fail immediately instead
+// of each one waiting out its deadline.
+class UpstreamClient {
+public:
+    class Response {
+    public:
+        int status = 0;         // 0 when no HTTP response arrived
+        string body;
+        string error;
+
+        bool ok() const { return status == 200; }
+    };
+
+    // Budget for callers that pass no deadline, so nothing waits on httplib's defaults
+    static constexpr chrono::milliseconds DEFAULT_BUDGET{8000};
+    // Hedge delay until enough samples exist for a percentile
+    static constexpr chrono::milliseconds INITIAL_HEDGE_DELAY{500};
+    // Attempts allowed to wait for an attempt thread, per pooled connection
+    static const size_t QUEUED_ATTEMPTS_PER_CONNECTION = 4;
+
+    // requestsPerSecond of 0 means no rate policy
+    UpstreamClient(const string& url, double requestsPerSecond)
+        : baseUrl(url), pool(HttpClientPool::forHost(url)), hedging(requestsPerSecond <= 0),
+          attempts(pool.capacity()) {
+        if (requestsPerSecond > 0) rateLimit = make_unique<TokenBucket>(requestsPerSecond, 1.0);
+    }
+
+    static UpstreamClient& forHost(const string& url) {
+        // Attempt threads use the connection pools until they are joined, so the pool
+        // registry is set up first and therefore torn down last
+        HttpClientPool::forHost(url);
+        static mutex registryMutex;
+        static unordered_map<string, unique_ptr<UpstreamClient>> clients;
+        lock_guard<mutex> lock(registryMutex);
+        auto it = clients.find(url);
+        if (it == clients.end()) {
+            it = clients.emplace(url, make_unique<UpstreamClient>(url, UpstreamConfig::requestRateLimit(url))).first;
+        }
+        return *it->second;
+    }
+
+    Response get(const string& path, const httplib::Headers& headers, Deadline deadline = Deadline()) {
+        Deadline effective = deadline.capped(DEFAULT_BUDGET);
+        // The caller running out of time says nothing about the upstream's health
+        if (effective.expired()) {
+            return failure("deadline exceeded before calling " + baseUrl);
+        }
+        // An open circuit answers before a rate limited token is spent on a call that never
+        // goes out
+        if (!breaker.allow()) {
+            return failure("circuit open for " + baseUrl);
+        }
+        if (rateLimit && !rateLimit->acquireBy(effective.at())) {
+            breaker.recordInconclusive();
+            return failure("rate limit for " + baseUrl + " leaves no slot before the deadline");
+        }
         
-        try {
-            if (path.size() == 2 && path[0] == "start" && path[1] == "end") {
-                const auto& startNode = graph.at(path[0]);
-                const auto& endNode = graph.at(path[1]);
-                vector<string> routeSteps = getRouteDetails(startNode.location, endNode.location, routeType);
-                result = Location::extractCityName(startNode.location.name);
-                
-                for (const auto& step : routeSteps) {
-                    result += " → " + step;
-                }
-                
-                result += " → " + Location::extractCityName(endNode.location.name);
-                totalDistance = RouteUtils::getAccurateDistance(startNode.location, endNode.location);
-                
-                if (routeType != AVOID_TOLLS) {
-                    tolls = getTollInfo(startNode.location, endNode.location, routeType, tollCost, currency);
-                }
+        auto call = make_shared<Call>();
+        if (!launchAttempt(call, path, headers, effective)) {
+            breaker.recordInconclusive();
+            return failure("too many requests queued for " + baseUrl);
+        }
+        
+        unique_lock<mutex> lock(call->callMutex);
+        if (hedging) {
+            auto hedgeAt = chrono::steady_clock::now() + hedgeDelay();
+            if (hedgeAt < effective.at() &&
+                !call->answered.wait_until(lock, hedgeAt, [&call]() { return call->done; })) {
+                lock.unlock();
+                launchAttempt(call, path, headers, effective);
+                lock.lock();
+            }
+        }
+        
+        // The attempts record their own outcome with the breaker
+        if (!call->answered.wait_until(lock, effective.at(), [&call]() { return call->done; })) {
+            return failure("deadline exceeded for " + baseUrl);
+        }
+        return call->result;
+    }
+
+    bool circuitOpen() {
+        return breaker.isOpen();
+    }
+
+private:
+    // Shared by the attempts of one call; outlives the caller if an attempt is still running
+    struct Call {
+        mutex callMutex;
+        condition_variable answered;
+        bool done = false;
+        size_t pending = 0;
+        Response result;
+    };
+
+    static const size_t LATENCY_WINDOW = 128;
+
+    string baseUrl;
+    HttpClientPool& pool;
+    bool hedging;
+    unique_ptr<TokenBucket> rateLimit;
+    CircuitBreaker breaker;
+    mutex latencyMutex;
+    array<double, LATENCY_WINDOW> latenciesMs{};
+    size_t latencySamples = 0;
+    // Last, so it is joined before anything its tasks use goes away
+    WorkerPool attempts;
+
+    static Response failure(const string& message) {
+        Response response;
+        response.error = message;
+        return response;
+    }
+
+    chrono::milliseconds hedgeDelay() {
+        lock_guard<mutex> lock(latencyMutex);
+        size_t count = min(latencySamples, LATENCY_WINDOW);
+        if (count < 16) return INITIAL_HEDGE_DELAY;
+        
+        vector<double> window(latenciesMs.begin(), latenciesMs.begin() + count);
+        size_t rank = count * 95 / 100;
+        nth_element(window.begin(), window.begin() + rank, window.end());
+        return chrono::milliseconds(static_cast<long long>(ceil(window[rank])));
+    }
+
+    void recordLatency(double milliseconds) {
+        lock_guard<mutex> lock(latencyMutex);
+        latenciesMs[latencySamples % LATENCY_WINDOW] = milliseconds;
+        latencySamples++;
+    }
+
+    // Queues one attempt; false when the backlog is full. Socket timeouts come from the
+    // deadline, so an attempt ends soon after its caller stops waiting.
+    bool launchAttempt(const shared_ptr<Call>& call, const string& path, const httplib::Headers& headers,
+                       Deadline deadline) {
+        {
+            lock_guard<mutex> lock(call->callMutex);
+            call->pending++;
+        }
+        bool queued = attempts.trySubmit([this, call, path, headers, deadline]() {
+            finish(call, attempt(path, headers, deadline));
+        }, pool.capacity() * QUEUED_ATTEMPTS_PER_CONNECTION);
+        if (!queued) {
+            lock_guard<mutex> lock(call->callMutex);
+            call->pending--;
+        }
+        return queued;
+    }
+
+    Response attempt(const string& path, const httplib::Headers& headers, Deadline deadline) {
+        Response response;
+        HttpClientPool::Lease client = pool.acquire(deadline);
+        if (!client || deadline.expired()) {
+            response.error = "deadline exceeded waiting for a connection to " + baseUrl;
+            breaker.recordInconclusive();
+            return response;
+        }
+        
+        auto started = chrono::steady_clock::now();
+        chrono::milliseconds budget = max(deadline.remaining(), chrono::milliseconds(1));
+        client->set_connection_timeout(budget);
+        client->set_read_timeout(budget);
+        client->set_write_timeout(budget);
+        
+        auto res = client->Get(path, headers);
+        if (res) {
+            response.status = res->status;
+            response.body = move(res->body);
+            recordLatency(chrono::duration<double, milli>(chrono::steady_clock::now() - started).count());
+            if (response.status >= 500) {
+                breaker.recordFailure();
             } else {
-                for (size_t i = 0; i < path.size() - 1; i++) {
-                    const auto& currentNode = graph.at(path[i]);
-                    const auto& nextNode = graph.at(path[i+1]);
-                    
-                    double segmentDistance = 0;
-                    for (const auto& edge : currentNode.edges) {
-                        if (edge.first == path[i+1]) {
-                            segmentDistance = edge.second;
-                            break;
-                        }
-                    }
-                    
-                    if (i == 0) {
-                        result += currentNode.location.name;
-                    }
-                    
-                    vector<string> roadNames = getRouteDetails(
-                        currentNode.location, nextNode.location, routeType);
-                    
-                    for (const auto& road : roadNames) {
-                        result += " → " + road;
-                    }
-                    
-                    if (i == path.size() - 2) {
-                        result += " → " + nextNode.location.name;
-                    }
-                    
-                    totalDistance += segmentDistance;
-                }
-                
-                if (routeType != AVOID_TOLLS && path.size() >= 2) {
-                    const auto& startNode = graph.at(path.front());
-                    const auto& endNode = graph.at(path.back());
-                    tolls = getTollInfo(startNode.location, endNode.location, routeType, tollCost, currency);
-                }
+                breaker.recordSuccess();
             }
-            
-            double speed = 60.0;
-            switch (routeType) {
-                case FASTEST: speed = 60.0; break;
-                case SHORTEST: speed = 50.0; break;
-                case AVOID_TOLLS: speed = 45.0; break;
-                case SCENIC: speed = 40.0; break;
+        } else {
+            response.error = httplib::to_string(res.error());
+            client.discard();
+            // Running out the socket budget, which the caller's deadline set, says nothing
+            // about the upstream; a refused or broken connection does
+            bool ranOutOfTime = chrono::steady_clock::now() - started + chrono::milliseconds(1) >= budget;
+            if (ranOutOfTime || deadline.expired()) {
+                breaker.recordInconclusive();
+            } else {
+                breaker.recordFailure();
             }
-            totalTime = (totalDistance / speed) * 60;
+        }
+        return response;
+    }
+
+    static void finish(const shared_ptr<Call>& call, Response response) {
+        lock_guard<mutex> lock(call->callMutex);
+        call->pending--;
+        // A transport error only answers the call when no other attempt can do better
+        if (!call->done && (response.status != 0 || call->pending == 0)) {
+            call->result = move(response);
+            call->done = true;
+            call->answered.notify_all();
+        }
+    }
+};
+
+// Offline place index built from an OSM place/address extract. Names are normalized and
+// stored in a radix (path-compressed) trie; each trie node caches the most important
+// places below it, so exact and prefix lookups are a short walk plus a copy.
+class Gazetteer {
+public:
+    struct Entry {
+        string name;
+        string displayName;
+        double lat;
+        double lon;
+        double importance;
+    };
+
+    static const size_t TOP_PER_NODE = 8;
+
+    Gazetteer() {
+        nodes.emplace_back();
+    }
+
+    // Lowercase ASCII, punctuation to spaces, collapsed whitespace. UTF-8 bytes pass through.
+    static string normalize(const string& text) {
+        string result;
+        result.reserve(text.size());
+        bool pendingSpace = false;
+        for (unsigned char c : text) {
+            if (c >= 0x80 || isalnum(c)) {
+                if (pendingSpace && !result.empty()) result += ' ';
+                pendingSpace = false;
+                result += static_cast<char>(c < 0x80 ? tolower(c) : c);
+            } else {
+                pendingSpace = true;
+            }
+        }
+        return result;
+    }
+
+    void addPlace(const string& name, const string& displayName, double lat, double lon, double importance) {
+        string key = normalize(name);
+        if (key.empty()) return;
+        
+        uint32_t entryId = static_cast<uint32_t>(entries.size());
+        entries.push_back({name, displayName.empty() ? name : displayName, lat, lon, importance});
+        for (const string& alias : keysFor(key)) insertKey(alias, entryId);
+        finalized = false;
+    }
+
+    // Single edits to a finalized trie: only the top lists along the place's keys are
+    // recomputed, so live indexes skip a full finalize()
+    void insertPlace(const string& name, const string& displayName, double lat, double lon, double importance) {
+        bool wasFinalized = finalized;
+        addPlace(name, displayName, lat, lon, importance);
+        if (!wasFinalized) return;
+        refreshTops(keysFor(normalize(name)));
+        finalized = true;
+    }
+
+    // Unlinks every place with this name from lookups; the records stay in allEntries() so ids
+    // remain stable
+    void removePlace(const string& name) {
+        vector<string> keys = keysFor(normalize(name));
+        for (const string& key : keys) {
+            int node = findNode(key, true);
+            if (node < 0) continue;
+            vector<uint32_t>& terminals = nodes[node].terminals;
+            terminals.erase(remove_if(terminals.begin(), terminals.end(),
+                                      [&](uint32_t id) { return entries[id].name == name; }),
+                            terminals.end());
+        }
+        if (finalized) refreshTops(keys);
+    }
+
+    // Tab separated: name, lat, lon, importance, display_name. Lines starting with '#' are skipped.
+    bool loadFromFile(const string& filename) {
+        ifstream file(filename);
+        if (!file.is_open()) {
+            return false;
+        }
+        
+        string line;
+        size_t loaded = 0;
+        while (getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            stringstream lineStream(line);
+            string name, latStr, lonStr, importanceStr, displayName;
+            getline(lineStream, name, '\t');
+            getline(lineStream, latStr, '\t');
+            getline(lineStream, lonStr, '\t');
+            getline(lineStream, importanceStr, '\t');
+            getline(lineStream, displayName);
             
-            int hours = static_cast<int>(totalTime) / 60;
-            int minutes = static_cast<int>(totalTime) % 60;
+            try {
+                double importance = importanceStr.empty() ? 0.0 : stod(importanceStr);
+                addPlace(name, displayName, stod(latStr), stod(lonStr), importance);
+                loaded++;
+            } catch (const exception& e) {
+                cerr << "Error parsing gazetteer line: " << e.what() << endl;
+            }
+        }
+        finalize();
+        return loaded > 0;
+    }
+
+    // Precomputes the per-node top lists; call after bulk loading
+    void finalize() {
+        computeTop(0);
+        finalized = true;
+    }
+
+    const Entry* findExact(const string& query) const {
+        int node = findNode(normalize(query), true);
+        if (node < 0 || nodes[node].terminals.empty()) return nullptr;
+        
+        const Entry* best = nullptr;
+        for (uint32_t id : nodes[node].terminals) {
+            if (!best || entries[id].importance > best->importance) best = &entries[id];
+        }
+        return best;
+    }
+
+    vector<const Entry*> findPrefix(const string& prefix, size_t limit) const {
+        vector<const Entry*> results;
+        int node = findNode(normalize(prefix), false);
+        if (node < 0 || limit == 0) return results;
+        
+        vector<uint32_t> ids;
+        if (finalized && limit <= TOP_PER_NODE) {
+            ids = nodes[node].top;
+        } else {
+            collectSubtree(node, ids);
+            sortByImportance(ids);
+        }
+        
+        for (uint32_t id : ids) {
+            if (results.size() >= limit) break;
+            results.push_back(&entries[id]);
+        }
+        return results;
+    }
+
+    const vector<Entry>& allEntries() const { return entries; }
+    size_t size() const { return entries.size(); }
+
+private:
+    struct TrieNode {
+        string label;                        // edge label from the parent
+        vector<pair<char, int>> children;    // keyed by first byte of the child's label
+        vector<uint32_t> terminals;          // entries whose key ends here
+        vector<uint32_t> top;                // best TOP_PER_NODE entries in this subtree
+    };
+
+    vector<TrieNode> nodes;
+    vector<Entry> entries;
+    bool finalized = true;
+
+    int childFor(int node, char c) const {
+        for (const auto& child : nodes[node].children) {
+            if (child.first == c) return child.second;
+        }
+        return -1;
+    }
+
+    void insertKey(const string& key, uint32_t entryId) {
+        int node = 0;
+        size_t pos = 0;
+        while (pos < key.size()) {
+            int child = childFor(node, key[pos]);
+            if (child < 0) {
+                int leaf = static_cast<int>(nodes.size());
+                nodes.emplace_back();
+                nodes[leaf].label = key.substr(pos);
+                nodes[node].children.push_back(make_pair(key[pos], leaf));
+                node = leaf;
+                pos = key.size();
+                break;
+            }
             
-            result += " (" + to_string(static_cast<int>(totalDistance)) + " km, ";
-            if (hours > 0) {
-                result += to_string(hours) + " hr ";
+            const string label = nodes[child].label;
+            size_t common = 0;
+            while (common < label.size() && pos + common < key.size() && label[common] == key[pos + common]) {
+                common++;
             }
-            result += to_string(minutes) + " min)";
             
-            if (!tolls.empty()) {
-                result += "\nTotal Toll Cost: " + RouteUtils::formatCurrency(tollCost, currency);
-                result += "\nToll Details:";
-                for (const auto& toll : tolls) {
-                    result += "\n  - " + toll.name + " (" + toll.operator_name + "): " + 
-                           RouteUtils::formatCurrency(toll.cost, toll.currency);
+            if (common < label.size()) {
+                // Split the edge: parent -> mid (common part) -> child (rest of label)
+                int mid = static_cast<int>(nodes.size());
+                nodes.emplace_back();
+                nodes[mid].label = label.substr(0, common);
+                nodes[child].label = label.substr(common);
+                nodes[mid].children.push_back(make_pair(nodes[child].label[0], child));
+                for (auto& edge : nodes[node].children) {
+                    if (edge.second == child) edge.second = mid;
                 }
-            } else if (routeType != AVOID_TOLLS) {
-                result += "\nNo toll information available for this route.";
-            } else {
-                result += "\nThis route avoids all toll roads.";
+                child = mid;
             }
-        } catch (const exception& e) {
-            cerr << "Error in formatRouteWithRealDirections: " << e.what() << endl;
-            return "Error generating route details";
+            node = child;
+            pos += common;
         }
         
-        return RouteUtils::cleanRouteSymbols(result);
+        vector<uint32_t>& terminals = nodes[node].terminals;
+        if (find(terminals.begin(), terminals.end(), entryId) == terminals.end()) {
+            terminals.push_back(entryId);
+        }
     }
-};
 
-class RoutePlanner {
-private:
-    // Geocoder geocoder;
-    // RouteFinder routeFinder;
-    Geocoder geocoder;
-    RouteFinder routeFinder;
-    RouteUtils::LocationManager locationManager;
-    RouteUtils::RouteManager routeManager;
-    unordered_map<string, Node> currentGraph;
+    // Node whose path spells key; for prefixes a walk ending inside an edge label also matches
+    int findNode(const string& key, bool exact) const {
+        int node = 0;
+        size_t pos = 0;
+        while (pos < key.size()) {
+            int child = childFor(node, key[pos]);
+            if (child < 0) return -1;
+            const string& label = nodes[child].label;
+            size_t remaining = key.size() - pos;
+            if (remaining < label.size()) {
+                if (exact || label.compare(0, remaining, key, pos, remaining) != 0) return -1;
+                return child;
+            }
+            if (label.compare(0, label.size(), key, pos, label.size()) != 0) return -1;
+            pos += label.size();
+            node = child;
+        }
+        return node;
+    }
 
-public:
-    // void planRoute() {
-    //     cout << "===== Maps Pathfinder Application =====" << endl;
-        
-    //     while (true) {
-    //         try {
-    //             string startLocationName, endLocationName;
-                
-    //             cout << "Enter your current location: ";
-    //             getline(cin, startLocationName);
-                
-    //             cout << "Enter your destination: ";
-    //             getline(cin, endLocationName);
-                
-    //             if (startLocationName.empty() || endLocationName.empty()) {
-    //                 cout << "Error: Location names cannot be empty. Please try again." << endl;
-    //                 continue;
-    //             }
-                
-    //             cout << "\nSearching for locations..." << endl;
-                
-    //             Location startLocation = geocoder.geocodeLocation(startLocationName);
-    //             Location endLocation = geocoder.geocodeLocation(endLocationName);
-                
-    //             if (startLocation.name.empty() || endLocation.name.empty()) {
-    //                 cout << "Error: Could not find one or both locations. Please try again with more specific names." << endl;
-    //                 continue;
-    //             }
-                
-    //             cout << "Start: " << startLocation.name << endl;
-    //             cout << "End: " << endLocation.name << endl;
-                
-    //             double directDistance = RouteUtils::getAccurateDistance(startLocation, endLocation);
-    //             cout << "\nDirect distance: " << directDistance << " km" << endl;
+    void sortByImportance(vector<uint32_t>& ids) const {
+        sort(ids.begin(), ids.end(), [this](uint32_t a, uint32_t b) {
+            if (entries[a].importance != entries[b].importance) return entries[a].importance > entries[b].importance;
+            return entries[a].name < entries[b].name;
+        });
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    }
+
+    void collectSubtree(int node, vector<uint32_t>& ids) const {
+        vector<int> stack = {node};
+        while (!stack.empty()) {
+            int current = stack.back();
+            stack.pop_back();
+            ids.insert(ids.end(), nodes[current].terminals.begin(), nodes[current].terminals.end());
+            for (const auto& child : nodes[current].children) stack.push_back(child.second);
+        }
+    }
+
+    void computeTop(int root) {
+        // Iterative post-order so deep tries cannot overflow the stack
+        vector<pair<int, bool>> stack = {make_pair(root, false)};
+        while (!stack.empty()) {
+            auto [node, childrenDone] = stack.back();
+            stack.pop_back();
+            if (!childrenDone) {
+                stack.push_back(make_pair(node, true));
+                for (const auto& child : nodes[node].children) stack.push_back(make_pair(child.second, false));
+                continue;
+            }
+            updateTop(node);
+        }
+    }
+
+    void updateTop(int node) {
+        vector<uint32_t> candidates = nodes[node].terminals;
+        for (const auto& child : nodes[node].children) {
+            const auto& childTop = nodes[child.second].top;
+            candidates.insert(candidates.end(), childTop.begin(), childTop.end());
+        }
+        sortByImportance(candidates);
+        // An alias can list the same entry twice in a subtree
+        vector<uint32_t> top;
+        for (uint32_t id : candidates) {
+            if (top.size() >= TOP_PER_NODE) break;
+            if (find(top.begin(), top.end(), id) == top.end()) top.push_back(id);
+        }
+        nodes[node].top = top;
+    }
+
+    // "Kota Malang" should also answer "malang"
+    static vector<string> keysFor(const string& key) {
+        vector<string> keys;
+        if (key.empty()) return keys;
+        keys.push_back(key);
+        static const vector<string> adminPrefixes = {"kota ", "kabupaten ", "kab ", "kecamatan ", "desa ", "city of "};
+        for (const string& prefix : adminPrefixes) {
+            if (key.size() > prefix.size() && key.compare(0, prefix.size(), prefix) == 0) {
+                keys.push_back(key.substr(prefix.size()));
+            }
+        }
+        return keys;
+    }
+
+    // Recomputes the top lists on the paths spelling keys, deepest nodes first so every
+    // node sees its children's updated lists
+    void refreshTops(const vector<string>& keys) {
+        unordered_map<int, size_t> depths;
+        for (const string& key : keys) {
+            int node = 0;
+            size_t depth = 0;
+            size_t pos = 0;
+            depths[node] = depth;
+            while (pos < key.size()) {
+                int child = childFor(node, key[pos]);
+                if (child < 0) break;
+                pos += nodes[child].label.size();
+                node = child;
+                depths[node] = ++depth;
+            }
+        }
+        vector<pair<size_t, int>> order;
+        for (const auto& entry : depths) order.push_back(make_pair(entry.second, entry.first));
+        sort(order.rbegin(), order.rend());
+        for (const auto& entry : order) updateTop(entry.second);
+    }
+};
+
+// Typo-tolerant autocomplete over place names. Each name is split into padded character
+// trigrams with one sorted id list per trigram. A query scans only the rarest lists that can
+// still reach the match threshold and verifies the survivors against the remaining lists by
+// galloping through them in id order, or through a bitmap for the most common trigrams, so
+// lists like "  k" never get walked. The best trigram candidates are then reranked by edit
+// distance against each word start of the name, which is what puts "Surabaya" above "Surabo"
+// for "surabya". Plain prefix matches come from a Gazetteer trie and rank above fuzzy ones.
+class LocationSearchIndex {
+public:
+    struct Match {
+        string name;
+        double score;
+    };
+
+    // Share of the query's trigrams a name must contain to count as a fuzzy match
+    static constexpr double MIN_COVERAGE = 0.5;
+    // Trigram candidates per requested result that get the edit distance rerank
+    static const size_t RERANK_FACTOR = 4;
+    // Posting entries one query may scan; long queries over common trigrams raise their
+    // threshold until the rarest lists fit, which keeps fuzzy lookups well under a
+    // millisecond at the 99th percentile even over a million names
+    static const size_t MAX_SCANNED_POSTINGS = 8000;
+    // Query trigrams one dropped letter takes away from the intended name
+    static const size_t TYPO_GRAMS = 2;
+    // Trigrams in at least 1/DENSE_GRAM_RATIO of all names also get a bitmap over ids, which
+    // at that density is no larger than the list and answers membership in one load
+    static const size_t DENSE_GRAM_RATIO = 32;
+
+    void clear() {
+        names.clear();
+        normalizedNames.clear();
+        nameIds.clear();
+        importances.clear();
+        maxImportance = 0.0;
+        gramCounts.clear();
+        postings.clear();
+        denseGrams.clear();
+        prefixIndex = Gazetteer();
+    }
+
+    void add(const string& name, double importance = 0.0) {
+        if (addName(name, importance)) prefixIndex.addPlace(name, name, 0.0, 0.0, importance);
+    }
+
+    // Call after bulk adds so prefix lookups use the precomputed top lists and common
+    // trigrams their bitmaps
+    void finalize() {
+        prefixIndex.finalize();
+        denseGrams.clear();
+        for (const auto& posting : postings) {
+            if (posting.second.size() * DENSE_GRAM_RATIO < names.size()) continue;
+            vector<uint64_t>& bits = denseGrams[posting.first];
+            bits.assign(names.size() / 64 + 1, 0);
+            for (uint32_t id : posting.second) bits[id / 64] |= 1ULL << (id % 64);
+        }
+    }
+
+    // Edits to a finalized index that keep it finalized, for indexes that live as long as
+    // the data they cover
+    void insert(const string& name, double importance = 0.0) {
+        if (addName(name, importance)) prefixIndex.insertPlace(name, name, 0.0, 0.0, importance);
+    }
+
+    void remove(const string& name) {
+        auto existing = nameIds.find(name);
+        if (existing == nameIds.end()) return;
+        uint32_t id = existing->second;
+        nameIds.erase(existing);
+        
+        // The id is retired rather than reused, so removal only has to drop it from its lists
+        for (uint32_t gram : trigrams(normalizedNames[id], true)) {
+            vector<uint32_t>& list = postings[gram];
+            auto position = lower_bound(list.begin(), list.end(), id);
+            if (position != list.end() && *position == id) list.erase(position);
+            auto dense = denseGrams.find(gram);
+            if (dense != denseGrams.end()) dense->second[id / 64] &= ~(1ULL << (id % 64));
+        }
+        prefixIndex.removePlace(name);
+    }
+
+    size_t size() const { return nameIds.size(); }
+
+    vector<Match> search(const string& query, size_t limit) const {
+        vector<Match> results;
+        string key = Gazetteer::normalize(query);
+        if (key.empty() || limit == 0) return results;
+        
+        unordered_set<string> seen;
+        for (const Gazetteer::Entry* entry : prefixIndex.findPrefix(key, limit)) {
+            if (seen.insert(entry->name).second) {
+                results.push_back({entry->name, 2.0 + entry->importance});
+            }
+        }
+        if (results.size() >= limit) return results;
+        
+        vector<Match> fuzzy = fuzzySearch(key, limit + seen.size());
+        for (const Match& match : fuzzy) {
+            if (results.size() >= limit) break;
+            if (seen.insert(match.name).second) results.push_back(match);
+        }
+        return results;
+    }
+
+private:
+    vector<string> names;
+    vector<string> normalizedNames;
+    unordered_map<string, uint32_t> nameIds;
+    vector<double> importances;
+    // Only ever raised, which keeps it an upper bound for pruning after removals
+    double maxImportance = 0.0;
+    vector<uint16_t> gramCounts;
+    unordered_map<uint32_t, vector<uint32_t>> postings;
+    unordered_map<uint32_t, vector<uint64_t>> denseGrams;
+    Gazetteer prefixIndex;
+
+    bool addName(const string& name, double importance) {
+        string key = Gazetteer::normalize(name);
+        if (key.empty()) return false;
+        maxImportance = max(maxImportance, importance);
+        
+        // Same-named places collapse into one suggestion carrying the best importance
+        auto existing = nameIds.find(name);
+        if (existing != nameIds.end()) {
+            importances[existing->second] = max(importances[existing->second], importance);
+            return false;
+        }
+        
+        uint32_t id = static_cast<uint32_t>(names.size());
+        nameIds[name] = id;
+        names.push_back(name);
+        normalizedNames.push_back(key);
+        importances.push_back(importance);
+        
+        vector<uint32_t> grams = trigrams(key, true);
+        gramCounts.push_back(static_cast<uint16_t>(min<size_t>(grams.size(), UINT16_MAX)));
+        // Ids only grow, so every posting list stays sorted
+        for (uint32_t gram : grams) {
+            postings[gram].push_back(id);
+            auto dense = denseGrams.find(gram);
+            if (dense == denseGrams.end()) continue;
+            if (dense->second.size() <= id / 64) dense->second.resize(id / 64 + 1, 0);
+            dense->second[id / 64] |= 1ULL << (id % 64);
+        }
+        return true;
+    }
+
+    // Names get a trailing pad so whole-word endings match; queries do not, since the user
+    // may still be typing
+    static vector<uint32_t> trigrams(const string& key, bool padEnd) {
+        string padded = "  " + key + (padEnd ? " " : "");
+        vector<uint32_t> grams;
+        grams.reserve(padded.size());
+        for (size_t i = 0; i + 3 <= padded.size(); i++) {
+            grams.push_back((static_cast<uint32_t>(static_cast<unsigned char>(padded[i])) << 16) |
+                            (static_cast<uint32_t>(static_cast<unsigned char>(padded[i + 1])) << 8) |
+                            static_cast<uint32_t>(static_cast<unsigned char>(padded[i + 2])));
+        }
+        sort(grams.begin(), grams.end());
+        grams.erase(unique(grams.begin(), grams.end()), grams.end());
+        return grams;
+    }
+
+    vector<Match> fuzzySearch(const string& key, size_t limit) const {
+        vector<uint32_t> grams = trigrams(key, false);
+        size_t queryGrams = grams.size();
+        size_t threshold = max<size_t>(1, static_cast<size_t>(ceil(queryGrams * MIN_COVERAGE)));
+        
+        // Each list of ids comes with its bitmap when the trigram is dense
+        vector<pair<const vector<uint32_t>*, const vector<uint64_t>*>> lists;
+        for (uint32_t gram : grams) {
+            auto it = postings.find(gram);
+            if (it == postings.end()) continue;
+            auto dense = denseGrams.find(gram);
+            lists.push_back(make_pair(&it->second, dense != denseGrams.end() ? &dense->second : nullptr));
+        }
+        if (lists.size() < threshold) return {};
+        sort(lists.begin(), lists.end(), [](const pair<const vector<uint32_t>*, const vector<uint64_t>*>& a,
+                                            const pair<const vector<uint32_t>*, const vector<uint64_t>*>& b) {
+            return a.first->size() < b.first->size();
+        });
+        
+        // A name missing from all of the first (lists - threshold + 1) lists cannot reach the
+        // threshold, so only those lists generate candidates. When they cost too much the
+        // threshold rises with each list dropped, but never past missing TYPO_GRAMS, so a
+        // name with one letter dropped still qualifies if it shows up in the scanned lists.
+        size_t scanned = lists.size() - threshold + 1;
+        size_t scanCost = 0;
+        for (size_t i = 0; i < scanned; i++) scanCost += lists[i].first->size();
+        while (scanned > 1 && scanCost > MAX_SCANNED_POSTINGS) {
+            scanned--;
+            scanCost -= lists[scanned].first->size();
+        }
+        if (lists.size() > TYPO_GRAMS) {
+            threshold = max(threshold, min(lists.size() - scanned + 1, lists.size() - TYPO_GRAMS));
+        }
+        // Merging the scanned lists yields each candidate once, in id order, with its hit count
+        thread_local vector<pair<uint32_t, uint32_t>> touched, merged;
+        touched.clear();
+        for (size_t i = 0; i < scanned; i++) {
+            const vector<uint32_t>& list = *lists[i].first;
+            merged.clear();
+            auto candidate = touched.begin();
+            auto entry = list.begin();
+            while (candidate != touched.end() || entry != list.end()) {
+                if (entry == list.end() || (candidate != touched.end() && candidate->first < *entry)) {
+                    merged.push_back(*candidate++);
+                } else if (candidate == touched.end() || *entry < candidate->first) {
+                    merged.push_back(make_pair(*entry++, 1u));
+                } else {
+                    merged.push_back(make_pair(*entry++, candidate->second + 1));
+                    candidate++;
+                }
+            }
+            touched.swap(merged);
+        }
+        
+        // Candidates with the most hits in the scanned lists are verified first, so the pool
+        // fills with strong scores early. Once even a perfect name with hits in all of its
+        // unchecked lists could not beat the worst score in a full pool, the rest are dropped.
+        // Within a bucket ids ascend, so each unchecked list without a bitmap is searched forward
+        // from where the previous candidate left it instead of from the top.
+        thread_local vector<uint32_t> ordered;
+        vector<size_t> bucketStart(scanned + 2, 0);
+        for (const auto& candidate : touched) bucketStart[scanned - candidate.second + 2]++;
+        for (size_t bucket = 2; bucket <= scanned + 1; bucket++) bucketStart[bucket] += bucketStart[bucket - 1];
+        ordered.resize(touched.size());
+        for (const auto& candidate : touched) ordered[bucketStart[scanned - candidate.second + 1]++] = candidate.first;
+        
+        size_t poolSize = limit * RERANK_FACTOR;
+        auto worse = [](const pair<double, uint32_t>& a, const pair<double, uint32_t>& b) { return a.first > b.first; };
+        vector<pair<double, uint32_t>> heap;
+        vector<size_t> cursors(lists.size());
+        for (size_t bucket = 0; bucket < scanned; bucket++) {
+            size_t hits = scanned - bucket;
+            if (hits + (lists.size() - scanned) < threshold) break;
+            double bestPossible = 0.7 * (hits + lists.size() - scanned) / queryGrams + 0.3 + 0.05 * maxImportance;
+            if (heap.size() >= poolSize && bestPossible <= heap.front().first) break;
+            
+            fill(cursors.begin(), cursors.end(), 0);
+            for (size_t position = bucketStart[bucket]; position < bucketStart[bucket + 1]; position++) {
+                uint32_t id = ordered[position];
+                size_t shared = hits;
+                for (size_t i = scanned; i < lists.size() && shared + (lists.size() - i) >= threshold; i++) {
+                    const vector<uint64_t>* bits = lists[i].second;
+                    bool found = bits ? id / 64 < bits->size() && ((*bits)[id / 64] >> (id % 64) & 1)
+                                      : gallopTo(*lists[i].first, cursors[i], id);
+                    if (found) shared++;
+                }
+                if (shared < threshold) continue;
                 
-    //             bool exit = false;
-    //             while (!exit) {
-    //                 cout << "\n===== Route Options =====" << endl;
-    //                 cout << "1. Fastest Route (Default)" << endl;
-    //                 cout << "2. Shortest Route" << endl;
-    //                 cout << "3. Avoid Tolls" << endl;
-    //                 cout << "4. Scenic Route" << endl;
-    //                 cout << "0. Enter New Locations" << endl;
-    //                 cout << "9. Exit Program" << endl;
-    //                 cout << "\nSelect an option: ";
-                    
-    //                 int choice;
-    //                 try {
-    //                     string input;
-    //                     getline(cin, input);
-    //                     choice = stoi(input);
-    //                 } catch (const exception&) {
-    //                     cout << "Invalid input. Please enter a number." << endl;
-    //                     continue;
-    //                 }
-                    
-    //                 RouteType routeType;
-    //                 switch (choice) {
-    //                     case 1: routeType = FASTEST; cout << "\nCalculating fastest route..." << endl; break;
-    //                     case 2: routeType = SHORTEST; cout << "\nCalculating shortest route..." << endl; break;
-    //                     case 3: routeType = AVOID_TOLLS; cout << "\nCalculating route avoiding tolls..." << endl; break;
-    //                     case 4: routeType = SCENIC; cout << "\nCalculating scenic route..." << endl; break;
-    //                     case 0: exit = true; continue;
-    //                     case 9: cout << "Exiting program. Thank you for using Maps Pathfinder!" << endl; return;
-    //                     default: cout << "Invalid option. Using Fastest Route." << endl; routeType = FASTEST; break;
-    //                 }
+                double coverage = static_cast<double>(shared) / queryGrams;
+                double precision = static_cast<double>(shared) / max<uint16_t>(gramCounts[id], 1);
+                double score = 0.7 * coverage + 0.3 * precision + 0.05 * importances[id];
+                if (heap.size() < poolSize) {
+                    heap.push_back(make_pair(score, id));
+                    push_heap(heap.begin(), heap.end(), worse);
+                } else if (score > heap.front().first) {
+                    pop_heap(heap.begin(), heap.end(), worse);
+                    heap.back() = make_pair(score, id);
+                    push_heap(heap.begin(), heap.end(), worse);
+                }
+            }
+        }
+        
+        vector<Match> matches;
+        for (const auto& candidate : heap) {
+            uint32_t id = candidate.second;
+            const string& text = normalizedNames[id];
+            size_t distance = key.size();
+            for (size_t start = 0; start < text.size(); start++) {
+                if (start == 0 || text[start - 1] == ' ') {
+                    distance = min(distance, prefixEditDistance(key, text, start));
+                }
+            }
+            double similarity = 1.0 - static_cast<double>(distance) / key.size();
+            double precision = static_cast<double>(key.size()) / max(text.size(), key.size());
+            matches.push_back({names[id], 0.8 * similarity + 0.15 * precision + 0.05 * importances[id]});
+        }
+        sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+            if (a.score != b.score) return a.score > b.score;
+            return a.name < b.name;
+        });
+        if (matches.size() > limit) matches.resize(limit);
+        return matches;
+    }
+
+    // Moves cursor to the first entry of the sorted list not below id, doubling the step from
+    // the old position so nearby targets cost a few probes
+    static bool gallopTo(const vector<uint32_t>& list, size_t& cursor, uint32_t id) {
+        if (cursor < list.size() && list[cursor] < id) {
+            size_t step = 1;
+            while (cursor + step < list.size() && list[cursor + step] < id) step *= 2;
+            auto first = list.begin() + cursor + step / 2 + 1;
+            auto last = list.begin() + min(cursor + step, list.size());
+            cursor = static_cast<size_t>(lower_bound(first, last, id) - list.begin());
+        }
+        return cursor < list.size() && list[cursor] == id;
+    }
+
+    // Smallest edit distance between query and any prefix of text[start..]
+    static size_t prefixEditDistance(const string& query, const string& text, size_t start) {
+        size_t columns = min(text.size() - start, query.size() + 2);
+        vector<size_t> previous(columns + 1), current(columns + 1);
+        for (size_t j = 0; j <= columns; j++) previous[j] = j;
+        for (size_t i = 1; i <= query.size(); i++) {
+            current[0] = i;
+            for (size_t j = 1; j <= columns; j++) {
+                size_t substitution = previous[j - 1] + (query[i - 1] == text[start + j - 1] ? 0 : 1);
+                current[j] = min({substitution, previous[j] + 1, current[j - 1] + 1});
+            }
+            swap(previous, current);
+        }
+        return *min_element(previous.begin(), previous.end());
+    }
+};
+
+// Persistent geocode results keyed by normalized query. Stored as an append-only log
+// (one tab separated record per line) and indexed in memory; the log is rewritten
+// once superseded or expired records outnumber live ones.
+class GeocodeCache {
+public:
+    struct CachedLocation {
+        string name;
+        double lat;
+        double lon;
+        time_t expiresAt;
+    };
+
+    explicit GeocodeCache(const string& file = "geocode_cache.log", long ttlSeconds = 30L * 24 * 3600)
+        : logFile(file), ttl(ttlSeconds) {
+        load();
+    }
+
+    bool lookup(const string& query, Location& result) {
+        lock_guard<mutex> lock(cacheMutex);
+        auto it = index.find(keyFor(query));
+        if (it == index.end()) {
+            return false;
+        }
+        if (it->second.expiresAt <= time(nullptr)) {
+            index.erase(it);
+            return false;
+        }
+        result = Location(it->second.name, it->second.lat, it->second.lon);
+        return true;
+    }
+
+    void store(const string& query, const Location& location) {
+        if (Gazetteer::normalize(query).empty() || location.name.empty()) return;
+        string key = keyFor(query);
+        
+        lock_guard<mutex> lock(cacheMutex);
+        CachedLocation entry = {location.name, location.lat, location.lon, time(nullptr) + ttl};
+        index[key] = entry;
+        
+        ofstream file(logFile, ios::app);
+        if (file.is_open()) {
+            writeRecord(file, key, entry);
+            logRecords++;
+        }
+        if (logRecords > 2 * index.size() + 64) {
+            compact();
+        }
+    }
+
+    bool contains(const string& query) {
+        Location ignored;
+        return lookup(query, ignored);
+    }
+
+    size_t size() {
+        lock_guard<mutex> lock(cacheMutex);
+        return index.size();
+    }
+
+private:
+    string logFile;
+    long ttl;
+    unordered_map<string, CachedLocation> index;
+    size_t logRecords = 0;
+    mutex cacheMutex;
+
+    // Answers are per server, so a mock or private Nominatim never answers for another
+    static string keyFor(const string& query) {
+        return UpstreamConfig::nominatimUrl() + "|" + Gazetteer::normalize(query);
+    }
+
+    static void writeRecord(ostream& out, const string& key, const CachedLocation& entry) {
+        out << key << '\t' << entry.name << '\t' << setprecision(9) << entry.lat << '\t'
+            << entry.lon << '\t' << static_cast<long long>(entry.expiresAt) << '\n';
+    }
+
+    void load() {
+        ifstream file(logFile);
+        if (!file.is_open()) {
+            return;
+        }
+        
+        time_t now = time(nullptr);
+        string line;
+        while (getline(file, line)) {
+            stringstream lineStream(line);
+            string key, name, latStr, lonStr, expiresStr;
+            getline(lineStream, key, '\t');
+            getline(lineStream, name, '\t');
+            getline(lineStream, latStr, '\t');
+            getline(lineStream, lonStr, '\t');
+            getline(lineStream, expiresStr);
+            logRecords++;
+            
+            try {
+                CachedLocation entry = {name, stod(latStr), stod(lonStr), static_cast<time_t>(stoll(expiresStr))};
+                if (entry.expiresAt > now) {
+                    index[key] = entry;
+                } else {
+                    index.erase(key);
+                }
+            } catch (const exception&) {
+                // A torn last line from an interrupted write; the next compaction drops it
+            }
+        }
+    }
+
+    // Caller holds cacheMutex
+    void compact() {
+        time_t now = time(nullptr);
+        string tempFile = logFile + ".tmp";
+        ofstream out(tempFile, ios::trunc);
+        if (!out.is_open()) return;
+        
+        size_t written = 0;
+        for (auto it = index.begin(); it != index.end();) {
+            if (it->second.expiresAt <= now) {
+                it = index.erase(it);
+                continue;
+            }
+            writeRecord(out, it->first, it->second);
+            written++;
+            ++it;
+        }
+        out.close();
+        // A short write must not replace the log; rename swaps the files atomically, so
+        // the old log stays intact until the new one is complete
+        if (!out) {
+            remove(tempFile.c_str());
+            return;
+        }
+        
+        if (rename(tempFile.c_str(), logFile.c_str()) == 0) {
+            logRecords = written;
+        }
+    }
+};
+
+// Coordinates to place names without the network. Places live in a uniform grid searched
+// ring by ring like RoadSegmentIndex; admin areas are polygons registered in a coarser grid
+// by bounding box and tested with an even-odd ray cast. Lookups only read the index, so
+// batches split across threads without locking.
+class ReverseGeocoder {
+public:
+    struct Result {
+        string place;                                       // nearest known place, empty if none in range
+        double distance = numeric_limits<double>::infinity(); // km to that place
+        string area;                                        // most specific admin area containing the point
+
+        bool found() const { return !place.empty() || !area.empty(); }
+
+        string label() const {
+            if (place.empty()) return area;
+            if (area.empty() || Gazetteer::normalize(area) == Gazetteer::normalize(place)) return place;
+            return place + ", " + area;
+        }
+    };
+
+    explicit ReverseGeocoder(double placeCellDegrees = 0.05, double areaCellDegrees = 0.25)
+        : placeCellSize(placeCellDegrees), areaCellSize(areaCellDegrees) {}
+
+    void addPlace(const string& name, double lat, double lon) {
+        uint32_t placeId = static_cast<uint32_t>(places.size());
+        places.push_back({name, lat, lon});
+        placeCells[cellKey(cellCoord(lat, placeCellSize), cellCoord(lon, placeCellSize))].push_back(placeId);
+    }
+
+    // Ring as (lat, lon) vertices; closing the ring is optional
+    void addArea(const string& name, const vector<pair<double, double>>& ring) {
+        if (ring.size() < 3) return;
+        
+        AdminArea area;
+        area.name = name;
+        area.ring = ring;
+        area.minLat = area.maxLat = ring[0].first;
+        area.minLon = area.maxLon = ring[0].second;
+        double twiceArea = 0;
+        for (size_t i = 0; i < ring.size(); i++) {
+            const auto& a = ring[i];
+            const auto& b = ring[(i + 1) % ring.size()];
+            area.minLat = min(area.minLat, a.first);
+            area.maxLat = max(area.maxLat, a.first);
+            area.minLon = min(area.minLon, a.second);
+            area.maxLon = max(area.maxLon, a.second);
+            twiceArea += a.second * b.first - b.second * a.first;
+        }
+        area.size = fabs(twiceArea) / 2;
+        
+        uint32_t areaId = static_cast<uint32_t>(areas.size());
+        areas.push_back(area);
+        for (int64_t y = cellCoord(area.minLat, areaCellSize); y <= cellCoord(area.maxLat, areaCellSize); y++) {
+            for (int64_t x = cellCoord(area.minLon, areaCellSize); x <= cellCoord(area.maxLon, areaCellSize); x++) {
+                areaCells[cellKey(y, x)].push_back(areaId);
+            }
+        }
+    }
+
+    // Tab separated: name, then "lat lon" vertices joined by ';'. Lines starting with '#' are skipped.
+    bool loadAreasFromFile(const string& filename) {
+        ifstream file(filename);
+        if (!file.is_open()) {
+            return false;
+        }
+        
+        string line;
+        size_t loaded = 0;
+        while (getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            size_t tab = line.find('\t');
+            if (tab == string::npos) continue;
+            
+            vector<pair<double, double>> ring;
+            stringstream vertices(line.substr(tab + 1));
+            string vertex;
+            while (getline(vertices, vertex, ';')) {
+                stringstream coords(vertex);
+                double lat, lon;
+                if (coords >> lat >> lon) ring.push_back(make_pair(lat, lon));
+            }
+            if (ring.size() >= 3) {
+                addArea(line.substr(0, tab), ring);
+                loaded++;
+            }
+        }
+        return loaded > 0;
+    }
+
+    size_t placeCount() const { return places.size(); }
+    size_t areaCount() const { return areas.size(); }
+
+    Result reverse(double lat, double lon, double maxDistanceKm = 25.0) const {
+        Result result;
+        nearestPlace(lat, lon, maxDistanceKm, result);
+        
+        auto cell = areaCells.find(cellKey(cellCoord(lat, areaCellSize), cellCoord(lon, areaCellSize)));
+        if (cell != areaCells.end()) {
+            const AdminArea* best = nullptr;
+            for (uint32_t areaId : cell->second) {
+                const AdminArea& area = areas[areaId];
+                if (best && area.size >= best->size) continue;
+                if (lat < area.minLat || lat > area.maxLat || lon < area.minLon || lon > area.maxLon) continue;
+                if (contains(area.ring, lat, lon)) best = &area;
+            }
+            if (best) result.area = best->name;
+        }
+        return result;
+    }
+
+    // Points as (lat, lon); splits the batch into one contiguous chunk per thread
+    vector<Result> reverseBatch(const vector<pair<double, double>>& points, double maxDistanceKm = 25.0,
+                                size_t threadCount = 0) const {
+        vector<Result> results(points.size());
+        if (threadCount == 0) threadCount = max(1u, thread::hardware_concurrency());
+        threadCount = max<size_t>(1, min(threadCount, points.size() / 1024 + 1));
+        
+        size_t chunk = (points.size() + threadCount - 1) / threadCount;
+        vector<future<void>> pending;
+        for (size_t begin = 0; begin < points.size(); begin += chunk) {
+            size_t end = min(points.size(), begin + chunk);
+            pending.push_back(async(launch::async, [this, &points, &results, begin, end, maxDistanceKm]() {
+                for (size_t i = begin; i < end; i++) {
+                    results[i] = reverse(points[i].first, points[i].second, maxDistanceKm);
+                }
+            }));
+        }
+        for (auto& task : pending) task.get();
+        return results;
+    }
+
+private:
+    struct Place {
+        string name;
+        double lat;
+        double lon;
+    };
+
+    struct AdminArea {
+        string name;
+        vector<pair<double, double>> ring;
+        double minLat, maxLat, minLon, maxLon;
+        double size;    // planar area in square degrees, only used to prefer the smaller match
+    };
+
+    double placeCellSize;
+    double areaCellSize;
+    vector<Place> places;
+    vector<AdminArea> areas;
+    unordered_map<int64_t, vector<uint32_t>> placeCells;
+    unordered_map<int64_t, vector<uint32_t>> areaCells;
+
+    static int64_t cellCoord(double degrees, double cellSize) {
+        return static_cast<int64_t>(floor(degrees / cellSize));
+    }
+
+    static int64_t cellKey(int64_t latCell, int64_t lonCell) {
+        return (latCell << 32) ^ (lonCell & 0xffffffffLL);
+    }
+
+    void nearestPlace(double lat, double lon, double maxDistanceKm, Result& result) const {
+        if (places.empty()) return;
+        
+        double kmPerDegLat = 111.32;
+        double kmPerDegLon = 111.32 * max(0.01, cos(lat * M_PI / 180.0));
+        double cellKm = placeCellSize * min(kmPerDegLat, kmPerDegLon);
+        int maxRing = static_cast<int>(ceil(maxDistanceKm / cellKm)) + 1;
+        int64_t centerLat = cellCoord(lat, placeCellSize);
+        int64_t centerLon = cellCoord(lon, placeCellSize);
+        
+        const Place* best = nullptr;
+        double bestDistance = maxDistanceKm;
+        for (int ring = 0; ring <= maxRing; ring++) {
+            // Places outside this ring are at least (ring - 1) cells away
+            if (ring > 1 && (ring - 1) * cellKm > bestDistance) break;
+            
+            for (int64_t dy = -ring; dy <= ring; dy++) {
+                for (int64_t dx = -ring; dx <= ring; dx++) {
+                    if (max(llabs(dx), llabs(dy)) != ring) continue;
+                    auto cell = placeCells.find(cellKey(centerLat + dy, centerLon + dx));
+                    if (cell == placeCells.end()) continue;
                     
-    //                 try {
-    //                     unordered_map<string, Node> graph;
-    //                     string startId = "start";
-    //                     string endId = "end";
-                        
-    //                     graph[startId] = Node(startId, startLocation);
-    //                     graph[endId] = Node(endId, endLocation);
-    //                     graph[startId].edges.push_back(make_pair(endId, directDistance));
-                        
-    //                     vector<vector<string>> routes = routeFinder.generateMultipleRoutes(
-    //                         graph, startId, endId, startLocation, endLocation, routeType);
-                        
-    //                     if (routes.empty()) {
+                    for (uint32_t placeId : cell->second) {
+                        const Place& place = places[placeId];
+                        double dLat = (place.lat - lat) * kmPerDegLat;
+                        double dLon = (place.lon - lon) * kmPerDegLon;
+                        double distance = sqrt(dLat * dLat + dLon * dLon);
+                        if (distance < bestDistance) {
+                            bestDistance = distance;
+                            best = &place;
+                        }
+                    }
+                }
+            }
+        }
+        
+        if (best) {
+            result.place = best->name;
+            result.distance = RouteUtils::calculateDistance(lat, lon, best->lat, best->lon);
+        }
+    }
+
+    // Even-odd rule on the (lon, lat) plane
+    static bool contains(const vector<pair<double, double>>& ring, double lat, double lon) {
+        bool inside = false;
+        for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+            double latI = ring[i].first, lonI = ring[i].second;
+            double latJ = ring[j].first, lonJ = ring[j].second;
+            if ((latI > lat) != (latJ > lat) &&
+                lon < (lonJ - lonI) * (lat - latI) / (latJ - latI) + lonI) {
+                inside = !inside;
+            }
+        }
+        return inside;
+    }
+};
+
+class Geocoder {
+private:
+    Gazetteer gazetteer;
+    GeocodeCache cache;
+    SingleFlight<string, pair<Location, string>> remoteFlights;
+    LocationSearchIndex placeSearch;
+    once_flag placeSearchBuilt;
+    ReverseGeocoder reverseIndex;
+    once_flag reverseIndexBuilt;
+    const string GAZETTEER_FILE = "gazetteer.tsv";
+    const string ADMIN_AREAS_FILE = "admin_areas.tsv";
+
+    // Seed places so common lookups work without an extract on disk
+    void loadBuiltinPlaces() {
+        gazetteer.addPlace("Jakarta", "Jakarta, Daerah Khusus Ibukota Jakarta, Indonesia", -6.1754, 106.8272, 0.85);
+        gazetteer.addPlace("Surabaya", "Surabaya, Jawa Timur, Indonesia", -7.2458, 112.7378, 0.80);
+        gazetteer.addPlace("Bandung", "Bandung, Jawa Barat, Indonesia", -6.9147, 107.6098, 0.78);
+        gazetteer.addPlace("Semarang", "Semarang, Jawa Tengah, Indonesia", -6.9932, 110.4203, 0.74);
+        gazetteer.addPlace("Yogyakarta", "Yogyakarta, Daerah Istimewa Yogyakarta, Indonesia", -7.7971, 110.3688, 0.74);
+        gazetteer.addPlace("Malang", "Malang, Jawa Timur, Indonesia", -7.9666, 112.6326, 0.70);
+        gazetteer.addPlace("Kota Malang", "Kota Malang, Jawa Timur, Indonesia", -7.9797, 112.6304, 0.68);
+        gazetteer.addPlace("Surakarta", "Surakarta, Jawa Tengah, Indonesia", -7.5755, 110.8243, 0.66);
+        gazetteer.addPlace("Solo", "Solo, Jawa Tengah, Indonesia", -7.5755, 110.8243, 0.64);
+        gazetteer.addPlace("Bogor", "Bogor, Jawa Barat, Indonesia", -6.5971, 106.8060, 0.66);
+        gazetteer.addPlace("Bekasi", "Bekasi, Jawa Barat, Indonesia", -6.2349, 106.9924, 0.64);
+        gazetteer.addPlace("Tangerang", "Tangerang, Banten, Indonesia", -6.1783, 106.6319, 0.64);
+        gazetteer.addPlace("Depok", "Depok, Jawa Barat, Indonesia", -6.4025, 106.7942, 0.62);
+        gazetteer.addPlace("Cimahi", "Cimahi, Jawa Barat, Indonesia", -6.8722, 107.5425, 0.56);
+        gazetteer.addPlace("Sidoarjo", "Sidoarjo, Jawa Timur, Indonesia", -7.4458, 112.7183, 0.60);
+        gazetteer.addPlace("Gresik", "Gresik, Jawa Timur, Indonesia", -7.1539, 112.6561, 0.58);
+        gazetteer.addPlace("Mojokerto", "Mojokerto, Jawa Timur, Indonesia", -7.4722, 112.4338, 0.56);
+        gazetteer.addPlace("Lamongan", "Lamongan, Jawa Timur, Indonesia", -7.1167, 112.4167, 0.54);
+        gazetteer.addPlace("Probolinggo", "Probolinggo, Jawa Timur, Indonesia", -7.7543, 113.2159, 0.56);
+        gazetteer.addPlace("Pasuruan", "Pasuruan, Jawa Timur, Indonesia", -7.6453, 112.9075, 0.54);
+        gazetteer.addPlace("Jember", "Jember, Jawa Timur, Indonesia", -8.1845, 113.6681, 0.58);
+        gazetteer.addPlace("Bondowoso", "Bondowoso, Jawa Timur, Indonesia", -7.9135, 113.8215, 0.52);
+        gazetteer.addPlace("Situbondo", "Situbondo, Jawa Timur, Indonesia", -7.7052, 113.9931, 0.50);
+        gazetteer.addPlace("Banyuwangi", "Banyuwangi, Jawa Timur, Indonesia", -8.2192, 114.3691, 0.56);
+        gazetteer.addPlace("Lumajang", "Lumajang, Jawa Timur, Indonesia", -8.1182, 113.2226, 0.50);
+        gazetteer.addPlace("Pandaan", "Pandaan, Pasuruan, Jawa Timur, Indonesia", -7.6488, 112.6858, 0.40);
+        gazetteer.addPlace("Lawang", "Lawang, Malang, Jawa Timur, Indonesia", -7.8652, 112.6955, 0.40);
+        gazetteer.addPlace("Porong", "Porong, Sidoarjo, Jawa Timur, Indonesia", -7.5461, 112.6744, 0.38);
+        gazetteer.addPlace("Karawang", "Karawang, Jawa Barat, Indonesia", -6.3227, 107.3376, 0.54);
+        gazetteer.addPlace("Purwakarta", "Purwakarta, Jawa Barat, Indonesia", -6.5569, 107.4494, 0.52);
+        gazetteer.addPlace("Padalarang", "Padalarang, Bandung Barat, Jawa Barat, Indonesia", -6.8428, 107.4746, 0.40);
+        gazetteer.addPlace("Magelang", "Magelang, Jawa Tengah, Indonesia", -7.4706, 110.2178, 0.52);
+        gazetteer.addPlace("Klaten", "Klaten, Jawa Tengah, Indonesia", -7.7058, 110.6061, 0.50);
+        gazetteer.finalize();
+    }
+
+public:
+    Geocoder() {
+        loadBuiltinPlaces();
+        gazetteer.loadFromFile(GAZETTEER_FILE);
+    }
+
+    const Gazetteer& getGazetteer() const {
+        return gazetteer;
+    }
+
+    // Ranked autocomplete over every gazetteer place; the index is built on first use
+    vector<LocationSearchIndex::Match> searchPlaces(const string& query, size_t limit) {
+        call_once(placeSearchBuilt, [this]() {
+            for (const auto& entry : gazetteer.allEntries()) {
+                placeSearch.add(entry.name, entry.importance);
+            }
+            placeSearch.finalize();
+        });
+        return placeSearch.search(query, limit);
+    }
+
+    // Nearest gazetteer place plus containing admin area; the index is built on first use
+    ReverseGeocoder::Result reverseGeocode(double lat, double lon) {
+        return getReverseIndex().reverse(lat, lon);
+    }
+
+    vector<ReverseGeocoder::Result> reverseGeocodeBatch(const vector<pair<double, double>>& points) {
+        return getReverseIndex().reverseBatch(points);
+    }
+
+    const ReverseGeocoder& getReverseIndex() {
+        call_once(reverseIndexBuilt, [this]() {
+            for (const auto& entry : gazetteer.allEntries()) {
+                reverseIndex.addPlace(entry.name, entry.lat, entry.lon);
+            }
+            reverseIndex.loadAreasFromFile(ADMIN_AREAS_FILE);
+        });
+        return reverseIndex;
+    }
+
+    // Offline lookup only; empty Location when the gazetteer has no exact match
+    Location geocodeLocal(const string& locationName) const {
+        const Gazetteer::Entry* entry = gazetteer.findExact(locationName);
+        if (!entry) {
+            return Location();
+        }
+        return Location(Location::extractCityName(entry->displayName), entry->lat, entry->lon);
+    }
+
+    // Gazetteer or persistent cache, never the network
+    bool geocodeOffline(const string& locationName, Location& result) {
+        result = geocodeLocal(locationName);
+        if (!result.name.empty()) {
+            return true;
+        }
+        return cache.lookup(locationName, result);
+    }
+
+    // error, if given, receives why a lookup failed instead of it being printed, so
+    // background callers can report on the UI thread
+    Location geocodeLocation(const string& locationName, Deadline deadline = Deadline(), string* error = nullptr) {
+        Location offline;
+        if (geocodeOffline(locationName, offline)) {
+            return offline;
+        }
+        
+        // Concurrent lookups of the same name share one Nominatim request
+        pair<Location, string> resolved = remoteFlights.run(Gazetteer::normalize(locationName), [&]() {
+            Location cached;
+            if (cache.lookup(locationName, cached)) {
+                return make_pair(cached, string());
+            }
+            string failure;
+            Location remote = geocodeRemote(locationName, deadline, &failure);
+            if (!remote.name.empty()) {
+                cache.store(locationName, remote);
+            }
+            return make_pair(remote, failure);
+        });
+        if (!resolved.second.empty()) {
+            if (error) *error = resolved.second;
+            else cerr << "Error: " << resolved.second << endl;
+        }
+        return resolved.first;
+    }
+
+    // Nominatim fallback for names the gazetteer does not know. Fails fast while the
+    // Nominatim circuit is open. Failures go to error when given, otherwise to cerr.
+    Location geocodeRemote(const string& locationName, Deadline deadline = Deadline(), string* error = nullptr) {
+        auto fail = [error](const string& message) {
+            if (error) *error = message;
+            else cerr << "Error: " << message << endl;
+            return Location();
+        };
+        try {
+            UpstreamClient& nominatim = UpstreamClient::forHost(UpstreamConfig::nominatimUrl());
+            httplib::Headers headers = {{"User-Agent", "MapsPathfinder/1.0"}};
+            
+            UpstreamClient::Response res = nominatim.get("/search?q=" + httplib::detail::encode_url(locationName) + 
+                            "&format=json&limit=1", headers, deadline);
+            
+            if (res.status == 0) {
+                return fail("Geocoding service unavailable (" + res.error + ")");
+            }
+            
+            if (res.status != 200) {
+                return fail("Geocoding API returned status code " + to_string(res.status));
+            }
+            
+            auto json = nlohmann::json::parse(res.body);
+            if (!json.empty()) {
+                double lat = stod(json[0]["lat"].get<string>());
+                double lon = stod(json[0]["lon"].get<string>());
+                string fullName = json[0]["display_name"].get<string>();
+                string cityName = Location::extractCityName(fullName);
+                return Location(cityName, lat, lon);
+            } else {
+                throw runtime_error("Location not found");
+            }
+        } catch (const exception& e) {
+            return fail(string("Geocoding failed: ") + e.what());
+        }
+    }
+};
+
+// Geocodes a list of names in the background. Names are deduplicated, answered from the
+// gazetteer/cache when possible, and the rest go to a worker pool whose requests are
+// paced by a token bucket at the Nominatim host's own rate policy. Every result is
+// appended to resultsFile as it arrives (and lands in the persistent geocode cache), so
+// an interrupted import resumes cheaply.
+class BatchGeocoder {
+public:
+    struct Progress {
+        size_t total = 0;
+        size_t fromCache = 0;
+        size_t completed = 0;
+        size_t failed = 0;
+        bool finished = false;
+    };
+
+    // Workers wait their turn here rather than inside UpstreamClient, whose process-wide
+    // limit then finds a token ready and leaves each lookup its whole deadline. Hosts
+    // without a policy, such as a private instance or --mock-upstream, are not paced.
+    explicit BatchGeocoder(Geocoder& geo, size_t workerCount = 4)
+        : geocoder(geo), workers(workerCount) {
+        double rate = UpstreamConfig::requestRateLimit(UpstreamConfig::nominatimUrl());
+        if (rate > 0) bucket = make_unique<TokenBucket>(rate, 1.0);
+    }
+
+    ~BatchGeocoder() {
+        cancel();
+        if (coordinator.joinable()) coordinator.join();
+        workers.shutdown();
+    }
+
+    bool start(const vector<string>& names, const string& resultsFile) {
+        if (isRunning()) return false;
+        if (coordinator.joinable()) coordinator.join();
+        
+        {
+            lock_guard<mutex> lock(resultMutex);
+            progressState = Progress();
+            resultsOut.close();
+            resultsOut.clear();
+            resultsOut.open(resultsFile, ios::app);
+            if (!resultsOut.is_open()) return false;
+        }
+        cancelled = false;
+        running = true;
+        coordinator = thread([this, names]() { run(names); });
+        return true;
+    }
+
+    void cancel() {
+        cancelled = true;
+    }
+
+    bool isRunning() const {
+        return running;
+    }
+
+    Progress progress() {
+        lock_guard<mutex> lock(resultMutex);
+        return progressState;
+    }
+
+    // Results that arrived since the previous call
+    vector<Location> takeCompleted() {
+        lock_guard<mutex> lock(resultMutex);
+        vector<Location> taken;
+        taken.swap(completed);
+        return taken;
+    }
+
+    // "name: reason" for lookups that failed since the previous call. Workers never print,
+    // so an import running behind the menu cannot write over its prompt.
+    vector<string> takeFailures() {
+        lock_guard<mutex> lock(resultMutex);
+        vector<string> taken;
+        taken.swap(failures);
+        return taken;
+    }
+
+private:
+    Geocoder& geocoder;
+    unique_ptr<TokenBucket> bucket;
+    WorkerPool workers;
+    thread coordinator;
+    atomic<bool> running{false};
+    atomic<bool> cancelled{false};
+    mutex resultMutex;
+    Progress progressState;
+    vector<Location> completed;
+    vector<string> failures;
+    ofstream resultsOut;
+
+    void run(vector<string> names) {
+        unordered_set<string> seen;
+        vector<string> uniqueNames;
+        for (const string& name : names) {
+            string key = Gazetteer::normalize(name);
+            if (!key.empty() && seen.insert(key).second) uniqueNames.push_back(name);
+        }
+        {
+            lock_guard<mutex> lock(resultMutex);
+            progressState.total = uniqueNames.size();
+        }
+        
+        for (const string& name : uniqueNames) {
+            if (cancelled) break;
+            Location offline;
+            if (geocoder.geocodeOffline(name, offline)) {
+                record(name, offline, true, "");
+                continue;
+            }
+            workers.submit([this, name]() {
+                if (cancelled) return;
+                if (bucket) bucket->acquire();
+                if (cancelled) return;
+                string error;
+                Location location = geocoder.geocodeLocation(name, Deadline(), &error);
+                record(name, location, false, error);
+            });
+        }
+        workers.waitIdle();
+        
+        {
+            lock_guard<mutex> lock(resultMutex);
+            progressState.finished = true;
+            resultsOut.flush();
+        }
+        running = false;
+    }
+
+    void record(const string& query, const Location& location, bool fromCache, const string& error) {
+        lock_guard<mutex> lock(resultMutex);
+        if (location.name.empty()) {
+            progressState.failed++;
+            failures.push_back(query + ": " + (error.empty() ? "not found" : error));
+            return;
+        }
+        progressState.completed++;
+        if (fromCache) progressState.fromCache++;
+        completed.push_back(location);
+        resultsOut << query << "," << location.name << "," << setprecision(9)
+                   << location.lat << "," << location.lon << "\n";
+        resultsOut.flush();
+    }
+};
+
+// Parsed OSRM route: the steps of every leg plus the overview geometry
+class OsrmRoute {
+public:
+    class Step {
+    public:
+        string name;
+        double distance = 0;    // metres
+        double duration = 0;    // seconds
+    };
+
+    class Leg {
+    public:
+        vector<Step> steps;
+        double distance = 0;
+        double duration = 0;
+    };
+
+    vector<Leg> legs;
+    vector<pair<double, double>> geometry;  // (lat, lon)
+
+    // Reads routes[0] of an OSRM /route response; geometry may be a polyline or GeoJSON
+    static bool fromJson(const nlohmann::json& json, OsrmRoute& route) {
+        if (!json.contains("routes") || json["routes"].empty()) return false;
+        const auto& first = json["routes"][0];
+        
+        route = OsrmRoute();
+        if (first.contains("legs")) {
+            for (const auto& jsonLeg : first["legs"]) {
+                Leg leg;
+                leg.distance = jsonLeg.value("distance", 0.0);
+                leg.duration = jsonLeg.value("duration", 0.0);
+                if (jsonLeg.contains("steps")) {
+                    for (const auto& jsonStep : jsonLeg["steps"]) {
+                        Step step;
+                        if (jsonStep.contains("name") && jsonStep["name"].is_string()) {
+                            step.name = jsonStep["name"].get<string>();
+                        }
+                        step.distance = jsonStep.value("distance", 0.0);
+                        step.duration = jsonStep.value("duration", 0.0);
+                        leg.steps.push_back(step);
+                    }
+                }
+                route.legs.push_back(leg);
+            }
+        }
+        
+        if (first.contains("geometry")) {
+            const auto& geometry = first["geometry"];
+            if (geometry.is_string()) {
+                route.geometry = decodePolyline(geometry.get<string>());
+            } else if (geometry.is_object() && geometry.contains("coordinates")) {
+                for (const auto& point : geometry["coordinates"]) {
+                    route.geometry.push_back(make_pair(point[1].get<double>(), point[0].get<double>()));
+                }
+            }
+        }
+        return true;
+    }
+
+    // Streaming equivalent of fromJson for a raw response body. Only routes[0] leg and step
+    // names, distances and durations (plus the overview geometry when asked for) are read;
+    // step geometries, intersections, alternatives and waypoints are skipped without ever
+    // being materialized.
+    static bool fromResponse(const string& body, OsrmRoute& route, bool withGeometry = true) {
+        route.legs.clear();
+        route.geometry.clear();
+        StepExtractor extractor(route, withGeometry);
+        if (!nlohmann::json::sax_parse(body, &extractor)) {
+            return false;
+        }
+        return extractor.foundRoute();
+    }
+
+    // Google encoded polyline, precision 5 (the OSRM default)
+    static string encodePolyline(const vector<pair<double, double>>& points) {
+        string encoded;
+        int64_t lastLat = 0, lastLon = 0;
+        auto appendValue = [&encoded](int64_t delta) {
+            uint64_t value = delta < 0 ? ~(static_cast<uint64_t>(delta) << 1) : static_cast<uint64_t>(delta) << 1;
+            while (value >= 0x20) {
+                encoded += static_cast<char>((0x20 | (value & 0x1f)) + 63);
+                value >>= 5;
+            }
+            encoded += static_cast<char>(value + 63);
+        };
+        for (const auto& point : points) {
+            int64_t lat = llround(point.first * 1e5);
+            int64_t lon = llround(point.second * 1e5);
+            appendValue(lat - lastLat);
+            appendValue(lon - lastLon);
+            lastLat = lat;
+            lastLon = lon;
+        }
+        return encoded;
+    }
+
+    static vector<pair<double, double>> decodePolyline(const string& encoded) {
+        vector<pair<double, double>> points;
+        int64_t lat = 0, lon = 0;
+        size_t pos = 0;
+        auto nextValue = [&](int64_t& value) {
+            int64_t result = 0;
+            int shift = 0;
+            while (pos < encoded.size()) {
+                int64_t byte = encoded[pos++] - 63;
+                result |= (byte & 0x1f) << shift;
+                shift += 5;
+                if (byte < 0x20) {
+                    value += (result & 1) ? ~(result >> 1) : (result >> 1);
+                    return true;
+                }
+            }
+            return false;
+        };
+        while (pos < encoded.size()) {
+            if (!nextValue(lat) || !nextValue(lon)) break;
+            points.push_back(make_pair(lat / 1e5, lon / 1e5));
+        }
+        return points;
+    }
+
+private:
+    // SAX handler as a small state machine over the few containers worth descending into;
+    // any other object or array is skipped by depth counting
+    class StepExtractor : public nlohmann::json_sax<nlohmann::json> {
+    public:
+        StepExtractor(OsrmRoute& target, bool geometry)
+            : route(target), withGeometry(geometry) {}
+
+        bool foundRoute() const { return sawRoute; }
+
+        bool null() override { return value(); }
+        bool boolean(bool) override { return value(); }
+        bool number_integer(number_integer_t number) override { return number_value(static_cast<double>(number)); }
+        bool number_unsigned(number_unsigned_t number) override { return number_value(static_cast<double>(number)); }
+        bool number_float(number_float_t number, const string_t&) override { return number_value(number); }
+        bool binary(binary_t&) override { return value(); }
+
+        bool string(string_t& text) override {
+            if (skipDepth == 0 && !frames.empty()) {
+                Frame& top = frames.back();
+                if (top.level == STEP && top.key == "name") {
+                    route.legs.back().steps.back().name = text;
+                } else if (top.level == ROUTE && top.key == "geometry" && withGeometry) {
+                    route.geometry = decodePolyline(text);
+                }
+            }
+            return value();
+        }
+
+        bool key(string_t& name) override {
+            if (skipDepth == 0) frames.back().key = name;
+            return true;
+        }
+
+        bool start_object(size_t) override { return enter(true); }
+        bool end_object() override { return leave(); }
+        bool start_array(size_t) override { return enter(false); }
+        bool end_array() override { return leave(); }
+
+        bool parse_error(size_t, const std::string&, const nlohmann::detail::exception&) override {
+            return false;
+        }
+
+    private:
+        enum Level { ROOT, ROUTES, ROUTE, LEGS, LEG, STEPS, STEP, GEOMETRY, COORDINATES, POINT, SKIP };
+
+        struct Frame {
+            Level level;
+            std::string key;    // last key seen, for objects
+            size_t index;       // next element, for arrays
+        };
+
+        OsrmRoute& route;
+        bool withGeometry;
+        bool sawRoute = false;
+        vector<Frame> frames;
+        size_t skipDepth = 0;
+        double pendingLon = 0;
+
+        Level childLevel(bool isObject) const {
+            if (frames.empty()) return isObject ? ROOT : SKIP;
+            const Frame& top = frames.back();
+            switch (top.level) {
+                case ROOT: return !isObject && top.key == "routes" ? ROUTES : SKIP;
+                case ROUTES: return isObject && top.index == 0 ? ROUTE : SKIP;
+                case ROUTE:
+                    if (!isObject && top.key == "legs") return LEGS;
+                    if (isObject && top.key == "geometry" && withGeometry) return GEOMETRY;
+                    return SKIP;
+                case LEGS: return isObject ? LEG : SKIP;
+                case LEG: return !isObject && top.key == "steps" ? STEPS : SKIP;
+                case STEPS: return isObject ? STEP : SKIP;
+                case GEOMETRY: return !isObject && top.key == "coordinates" ? COORDINATES : SKIP;
+                case COORDINATES: return !isObject ? POINT : SKIP;
+                default: return SKIP;
+            }
+        }
+
+        bool enter(bool isObject) {
+            if (skipDepth > 0) {
+                skipDepth++;
+                return true;
+            }
+            Level level = childLevel(isObject);
+            if (level == SKIP) {
+                skipDepth = 1;
+                return true;
+            }
+            if (level == ROUTE) sawRoute = true;
+            if (level == LEG) route.legs.emplace_back();
+            if (level == STEP) route.legs.back().steps.emplace_back();
+            frames.push_back({level, "", 0});
+            return true;
+        }
+
+        bool leave() {
+            if (skipDepth > 0) {
+                if (--skipDepth == 0) advance();
+                return true;
+            }
+            frames.pop_back();
+            advance();
+            return true;
+        }
+
+        // A value or container just finished inside the current frame
+        bool value() {
+            if (skipDepth == 0) advance();
+            return true;
+        }
+
+        void advance() {
+            if (!frames.empty()) frames.back().index++;
+        }
+
+        bool number_value(double number) {
+            if (skipDepth == 0 && !frames.empty()) {
+                Frame& top = frames.back();
+                if (top.level == LEG) {
+                    if (top.key == "distance") route.legs.back().distance = number;
+                    else if (top.key == "duration") route.legs.back().duration = number;
+                } else if (top.level == STEP) {
+                    if (top.key == "distance") route.legs.back().steps.back().distance = number;
+                    else if (top.key == "duration") route.legs.back().steps.back().duration = number;
+                } else if (top.level == POINT) {
+                    // GeoJSON positions are [lon, lat]
+                    if (top.index == 0) pendingLon = number;
+                    else if (top.index == 1) route.geometry.push_back(make_pair(number, pendingLon));
+                }
+            }
+            return value();
+        }
+    };
+};
+
+// Disk-backed LRU of parsed OSRM routes. Entries live in memory as compact binary payloads
+// (float32 geometry, length-prefixed strings) and are appended to a checksummed log; the
+// log is replayed at startup and rewritten least-recent-first once dead records dominate,
+// so recency survives restarts. Total payload size is capped by maxBytes.
+class OsrmRouteCache {
+public:
+    explicit OsrmRouteCache(const string& file = "osrm_cache.bin", size_t maxPayloadBytes = 32u << 20)
+        : logFile(file), maxBytes(maxPayloadBytes) {
+        load();
+    }
+
+    bool lookup(const string& key, OsrmRoute& route) {
+        lock_guard<mutex> lock(cacheMutex);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return false;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        return deserialize(it->second->second, route);
+    }
+
+    void store(const string& key, const OsrmRoute& route) {
+        string payload = serialize(route);
+        
+        lock_guard<mutex> lock(cacheMutex);
+        insert(key, payload);
+        
+        ofstream file(logFile, ios::binary | ios::app);
+        if (file.is_open()) {
+            if (file.tellp() == 0) file.write(MAGIC, sizeof(MAGIC));
+            logBytes += writeRecord(file, key, payload);
+        }
+        if (logBytes > 2 * liveBytes + (1u << 20)) {
+            compact();
+        }
+    }
+
+    size_t size() {
+        lock_guard<mutex> lock(cacheMutex);
+        return entries.size();
+    }
+
+    size_t bytes() {
+        lock_guard<mutex> lock(cacheMutex);
+        return liveBytes;
+    }
+
+private:
+    static constexpr char MAGIC[8] = {'O', 'S', 'R', 'M', 'C', '0', '0', '1'};
+
+    string logFile;
+    size_t maxBytes;
+    list<pair<string, string>> entries;     // key, payload; most recently used first
+    unordered_map<string, list<pair<string, string>>::iterator> index;
+    size_t liveBytes = 0;
+    size_t logBytes = 0;
+    mutex cacheMutex;
+
+    // Caller holds cacheMutex
+    void insert(const string& key, const string& payload) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            liveBytes -= it->second->first.size() + it->second->second.size();
+            entries.erase(it->second);
+        }
+        entries.emplace_front(key, payload);
+        index[key] = entries.begin();
+        liveBytes += key.size() + payload.size();
+        
+        while (liveBytes > maxBytes && entries.size() > 1) {
+            liveBytes -= entries.back().first.size() + entries.back().second.size();
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    static uint32_t checksum(const string& data) {
+        uint32_t hash = 2166136261u;
+        for (unsigned char c : data) {
+            hash = (hash ^ c) * 16777619u;
+        }
+        return hash;
+    }
+
+    template <typename T>
+    static void put(string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static void putString(string& out, const string& value) {
+        put<uint32_t>(out, static_cast<uint32_t>(value.size()));
+        out += value;
+    }
+
+    template <typename T>
+    static bool get(const string& in, size_t& pos, T& value) {
+        if (pos + sizeof(T) > in.size()) return false;
+        memcpy(&value, in.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    static bool getString(const string& in, size_t& pos, string& value) {
+        uint32_t length;
+        if (!get(in, pos, length) || pos + length > in.size()) return false;
+        value.assign(in, pos, length);
+        pos += length;
+        return true;
+    }
+
+    static string serialize(const OsrmRoute& route) {
+        string out;
+        put<uint32_t>(out, static_cast<uint32_t>(route.legs.size()));
+        for (const auto& leg : route.legs) {
+            put<float>(out, static_cast<float>(leg.distance));
+            put<float>(out, static_cast<float>(leg.duration));
+            put<uint32_t>(out, static_cast<uint32_t>(leg.steps.size()));
+            for (const auto& step : leg.steps) {
+                putString(out, step.name);
+                put<float>(out, static_cast<float>(step.distance));
+                put<float>(out, static_cast<float>(step.duration));
+            }
+        }
+        put<uint32_t>(out, static_cast<uint32_t>(route.geometry.size()));
+        for (const auto& point : route.geometry) {
+            put<float>(out, static_cast<float>(point.first));
+            put<float>(out, static_cast<float>(point.second));
+        }
+        return out;
+    }
+
+    static bool deserialize(const string& in, OsrmRoute& route) {
+        route = OsrmRoute();
+        size_t pos = 0;
+        uint32_t legCount;
+        if (!get(in, pos, legCount)) return false;
+        for (uint32_t i = 0; i < legCount; i++) {
+            OsrmRoute::Leg leg;
+            float distance, duration;
+            uint32_t stepCount;
+            if (!get(in, pos, distance) || !get(in, pos, duration) || !get(in, pos, stepCount)) return false;
+            leg.distance = distance;
+            leg.duration = duration;
+            for (uint32_t j = 0; j < stepCount; j++) {
+                OsrmRoute::Step step;
+                if (!getString(in, pos, step.name) || !get(in, pos, distance) || !get(in, pos, duration)) return false;
+                step.distance = distance;
+                step.duration = duration;
+                leg.steps.push_back(step);
+            }
+            route.legs.push_back(leg);
+        }
+        uint32_t pointCount;
+        if (!get(in, pos, pointCount)) return false;
+        route.geometry.reserve(pointCount);
+        for (uint32_t i = 0; i < pointCount; i++) {
+            float lat, lon;
+            if (!get(in, pos, lat) || !get(in, pos, lon)) return false;
+            route.geometry.push_back(make_pair(lat, lon));
+        }
+        return true;
+    }
+
+    // Record: key length, key, payload length, payload, FNV-1a of the payload
+    static size_t writeRecord(ostream& out, const string& key, const string& payload) {
+        string record;
+        putString(record, key);
+        putString(record, payload);
+        put<uint32_t>(record, checksum(payload));
+        out.write(record.data(), record.size());
+        return record.size();
+    }
+
+    void load() {
+        ifstream file(logFile, ios::binary);
+        if (!file.is_open()) {
+            return;
+        }
+        string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (data.size() < sizeof(MAGIC) || data.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0) {
+            return;
+        }
+        
+        size_t pos = sizeof(MAGIC);
+        bool torn = false;
+        while (pos < data.size()) {
+            string key, payload;
+            uint32_t sum;
+            size_t start = pos;
+            if (!getString(data, pos, key) || !getString(data, pos, payload) || !get(data, pos, sum) ||
+                sum != checksum(payload)) {
+                torn = true;
+                break;
+            }
+            insert(key, payload);
+            logBytes += pos - start;
+        }
+        
+        // A torn tail from an interrupted write would hide every later append, so drop it now
+        if (torn) {
+            compact();
+        }
+    }
+
+    // Caller holds cacheMutex
+    void compact() {
+        string tempFile = logFile + ".tmp";
+        ofstream out(tempFile, ios::binary | ios::trunc);
+        if (!out.is_open()) return;
+        
+        out.write(MAGIC, sizeof(MAGIC));
+        size_t written = 0;
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+            written += writeRecord(out, it->first, it->second);
+        }
+        out.close();
+        // Same as GeocodeCache::compact: never let a short write replace the log
+        if (!out) {
+            remove(tempFile.c_str());
+            return;
+        }
+        
+        if (rename(tempFile.c_str(), logFile.c_str()) == 0) {
+            logBytes = written;
+        }
+    }
+};
+
+// One source of segment road names. resolve() is given a path's waypoints and the legs
+// named so far (leg i runs from waypoint i to i + 1), fills the empty legs it can answer
+// and leaves the rest for the next backend. Each backend keeps its own cost accounting.
+class RoutingBackend {
+public:
+    class Stats {
+    public:
+        size_t calls = 0;               // resolve() calls that had legs to name
+        size_t legsRequested = 0;
+        size_t legsAnswered = 0;
+        size_t upstreamRequests = 0;    // network round trips, 0 for in-process backends
+        double totalMs = 0;
+    };
+
+    virtual ~RoutingBackend() = default;
+
+    virtual string name() const = 0;
+
+    void resolve(const vector<Location>& waypoints, RouteType routeType, Deadline deadline,
+                 vector<vector<string>>& legs) {
+        size_t missing = countMissing(legs);
+        if (missing == 0) return;
+        
+        auto started = chrono::steady_clock::now();
+        size_t upstream = resolveMissing(waypoints, routeType, deadline, legs);
+        double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        
+        lock_guard<mutex> lock(statsMutex);
+        totals.calls++;
+        totals.legsRequested += missing;
+        totals.legsAnswered += missing - countMissing(legs);
+        totals.upstreamRequests += upstream;
+        totals.totalMs += elapsedMs;
+    }
+
+    Stats stats() const {
+        lock_guard<mutex> lock(statsMutex);
+        return totals;
+    }
+
+protected:
+    // Fills what it can; returns the number of upstream requests made
+    virtual size_t resolveMissing(const vector<Location>& waypoints, RouteType routeType, Deadline deadline,
+                                  vector<vector<string>>& legs) = 0;
+
+    static size_t countMissing(const vector<vector<string>>& legs) {
+        size_t missing = 0;
+        for (const auto& leg : legs) {
+            if (leg.empty()) missing++;
+        }
+        return missing;
+    }
+
+private:
+    mutable mutex statsMutex;
+    Stats totals;
+};
+
+// Curated city-pair table (RoadDatabase); answers only pairs it knows
+class TableRoutingBackend : public RoutingBackend {
+public:
+    explicit TableRoutingBackend(const RoadDatabase& database) : roadDB(database) {}
+
+    string name() const override { return "table"; }
+
+protected:
+    size_t resolveMissing(const vector<Location>& waypoints, RouteType routeType, Deadline,
+                          vector<vector<string>>& legs) override {
+        for (size_t i = 0; i < legs.size(); i++) {
+            if (!legs[i].empty()) continue;
+            legs[i] = roadDB.getRoadNames(Location::extractCityName(waypoints[i].name),
+                                          Location::extractCityName(waypoints[i + 1].name), routeType);
+        }
+        return 0;
+    }
+
+private:
+    const RoadDatabase& roadDB;
+};
+
+// Plausible names built from the intermediate-city table and the distance; answers every leg
+class LocalRoutingBackend : public RoutingBackend {
+public:
+    LocalRoutingBackend(const RoadDatabase& database, const IntermediateLocationDB& intermediates)
+        : roadDB(database), intermediateDB(intermediates) {}
+
+    string name() const override { return "local"; }
+
+    vector<string> synthesize(const Location& start, const Location& end, RouteType routeType) const {
+        vector<string> steps;
+        string startCity = Location::extractCityName(start.name);
+        string endCity = Location::extractCityName(end.name);
+        
+        auto intermediates = intermediateDB.getIntermediates(startCity, endCity);
+        vector<string> cityNames;
+        for (const auto& item : intermediates) {
+            cityNames.push_back(item.first);
+        }
+        
+        if (!cityNames.empty()) {
+            steps = roadDB.generateDetailedRoadNames(startCity, endCity, cityNames, routeType);
+        } else {
+            steps.push_back("Jalan Raya " + startCity);
+            double distance = RouteUtils::getAccurateDistance(start, end);
+            int segments = max(1, min(10, static_cast<int>(distance / 30)));
+            
+            for (int i = 1; i <= segments; i++) {
+                if (i % 3 == 0) {
+                    steps.push_back("Jalan Lintas " + startCity + "-" + endCity + " (Segmen " + to_string(i) + ")");
+                } else if (i % 2 == 0) {
+                    steps.push_back("Jalan Kabupaten " + to_string(i));
+                } else {
+                    steps.push_back("Jalan Provinsi " + startCity + "-" + endCity);
+                }
+            }
+            steps.push_back("Jalan Masuk " + endCity);
+        }
+        
+        if (routeType == AVOID_TOLLS) {
+            vector<string> filteredSteps;
+            for (const auto& step : steps) {
+                if (step.find("Tol") == string::npos) {
+                    filteredSteps.push_back(step);
+                } else {
+                    filteredSteps.push_back("Jalan Alternatif " + step.substr(4));
+                }
+            }
+            return filteredSteps;
+        }
+        
+        return steps;
+    }
+
+protected:
+    size_t resolveMissing(const vector<Location>& waypoints, RouteType routeType, Deadline,
+                          vector<vector<string>>& legs) override {
+        for (size_t i = 0; i < legs.size(); i++) {
+            if (legs[i].empty()) legs[i] = synthesize(waypoints[i], waypoints[i + 1], routeType);
+        }
+        return 0;
+    }
+
+private:
+    const RoadDatabase& roadDB;
+    const IntermediateLocationDB& intermediateDB;
+};
+
+// OSRM route service. One request per stretch of up to MAX_WAYPOINTS coordinates that
+// still has unnamed legs; parsed routes persist in an OsrmRouteCache across sessions.
+class OsrmRoutingBackend : public RoutingBackend {
+public:
+    // Coordinates per OSRM request; longer paths are split into overlapping stretches
+    static const size_t MAX_WAYPOINTS = 100;
+
+    string name() const override { return "osrm"; }
+
+    static string routeParams(RouteType routeType) {
+        switch (routeType) {
+            case FASTEST: return "steps=true&overview=full";
+            case SHORTEST: return "steps=true&overview=full&alternatives=false&geometries=geojson";
+            case AVOID_TOLLS: return "steps=true&overview=full&exclude=toll";
+            case SCENIC: return "steps=true&overview=full";
+            default: return "steps=true&overview=full";
+        }
+    }
+
+    // Parsed route through the waypoints, from the persistent cache when possible. Returns
+    // false at once while the OSRM circuit is open so callers fall back to other backends.
+    bool fetchRoute(const vector<Location>& waypoints, RouteType routeType, OsrmRoute& route,
+                    Deadline deadline, size_t& upstreamRequests) {
+        string params = routeParams(routeType);
+        // Keyed by server too, so routes from a mock or private OSRM never answer for another
+        stringstream key;
+        key << UpstreamConfig::osrmUrl() << '|';
+        for (const auto& waypoint : waypoints) {
+            key << llround(waypoint.lat / KEY_DEGREES) << ',' << llround(waypoint.lon / KEY_DEGREES) << ';';
+        }
+        key << params;
+        if (routeCache.lookup(key.str(), route)) {
+            return true;
+        }
+        
+        UpstreamClient& osrm = UpstreamClient::forHost(UpstreamConfig::osrmUrl());
+        if (osrm.circuitOpen()) {
+            return false;
+        }
+        
+        try {
+            string path = "/route/v1/driving/";
+            for (size_t i = 0; i < waypoints.size(); i++) {
+                if (i > 0) path += ";";
+                path += to_string(waypoints[i].lon) + "," + to_string(waypoints[i].lat);
+            }
+            path += "?" + params;
+            
+            httplib::Headers headers = {{"User-Agent", "MapsPathfinder/1.0"}};
+            
+            upstreamRequests++;
+            UpstreamClient::Response res = osrm.get(path, headers, deadline);
+            if (res.ok()) {
+                if (OsrmRoute::fromResponse(res.body, route)) {
+                    routeCache.store(key.str(), route);
+                    return true;
+                }
+            } else {
+                throw runtime_error("Failed to get route from OSRM API" +
+                                    (res.error.empty() ? string() : ": " + res.error));
+            }
+        } catch (const exception& e) {
+            cerr << "Error in getRouteDetails: " << e.what() << endl;
+        }
+        
+        return false;
+    }
+
+protected:
+    size_t resolveMissing(const vector<Location>& waypoints, RouteType routeType, Deadline deadline,
+                          vector<vector<string>>& legs) override {
+        size_t upstreamRequests = 0;
+        // Consecutive stretches share their boundary waypoint, so legs map back one to one
+        for (size_t first = 0; first < legs.size(); first += MAX_WAYPOINTS - 1) {
+            size_t last = min(legs.size(), first + MAX_WAYPOINTS - 1);
+            if (none_of(legs.begin() + first, legs.begin() + last,
+                        [](const vector<string>& leg) { return leg.empty(); })) continue;
+            
+            vector<Location> stretch(waypoints.begin() + first, waypoints.begin() + last + 1);
+            OsrmRoute route;
+            if (!fetchRoute(stretch, routeType, route, deadline, upstreamRequests)) continue;
+            
+            for (size_t leg = 0; leg < route.legs.size() && first + leg < last; leg++) {
+                vector<string>& steps = legs[first + leg];
+                if (!steps.empty()) continue;
+                for (const auto& step : route.legs[leg].steps) {
+                    string road_name = step.name.empty() ? "unnamed road" : step.name;
+                    if (steps.empty() || road_name != steps.back()) {
+                        steps.push_back(road_name);
+                    }
+                }
+            }
+        }
+        return upstreamRequests;
+    }
+
+private:
+    static constexpr double KEY_DEGREES = 1e-5;
+    OsrmRouteCache routeCache;
+};
+
+// Scratch containers for route searches. Each thread reuses its own across queries, so a
+// search clears maps that keep their buckets instead of allocating fresh ones; batch
+// workers route many queries back to back on one workspace.
+class SearchWorkspace {
+public:
+    unordered_map<string, Node> graph;
+    unordered_map<string, double> heuristics;
+    unordered_map<string, double> gScore;
+    unordered_map<string, string> cameFrom;
+    unordered_set<string> closedSet;
+    vector<pair<double, string>> openSet;       // min-heap on the f score
+    vector<const Node*> nodes;
+    vector<double> lats, lons, cosLats, distances;
+    // Goal of the current search; heuristics fills in as the frontier reaches nodes
+    const Location* goal = nullptr;
+    HeuristicMode heuristicMode = ACCURATE_HEURISTIC;
+    CheapRuler::Bounds rulerBounds;
+    CheapRuler ruler;
+
+    static SearchWorkspace& forThisThread() {
+        thread_local SearchWorkspace workspace;
+        return workspace;
+    }
+
+    void resetSearch() {
+        gScore.clear();
+        cameFrom.clear();
+        closedSet.clear();
+        openSet.clear();
+    }
+
+    void pushOpen(double score, const string& nodeId) {
+        openSet.emplace_back(score, nodeId);
+        push_heap(openSet.begin(), openSet.end(), greater<pair<double, string>>());
+    }
+
+    string popOpen() {
+        pop_heap(openSet.begin(), openSet.end(), greater<pair<double, string>>());
+        string nodeId = move(openSet.back().second);
+        openSet.pop_back();
+        return nodeId;
+    }
+};
+
+class RouteFinder {
+private:
+    WaypointDatabase waypointDB;
+    IntermediateLocationDB intermediateDB;
+    RoadDatabase roadDB;
+    HeuristicMode heuristicMode = ACCURATE_HEURISTIC;
+    SingleFlight<string, vector<string>> routeDetailFlights;
+    SingleFlight<string, pair<vector<vector<string>>, bool>> pathDetailFlights;
+    TableRoutingBackend tableBackend{roadDB};
+    OsrmRoutingBackend osrmBackend;
+    LocalRoutingBackend localBackend{roadDB, intermediateDB};
+    RoutingBackendMode backendMode = BACKEND_AUTO;
+
+    struct TollResult {
+        vector<TollInfo> tolls;
+        double totalCost = 0;
+        string currency = "IDR";
+    };
+
+    // Session memos of resolved segments, roughly one planning screen's worth many times over
+    static constexpr double SEGMENT_KEY_DEGREES = 1e-5;
+    LruCache<string, vector<string>> segmentDetailMemo{4096};
+    LruCache<string, TollResult> tollMemo{4096};
+    // Resolves prefetched segments and progressive route details
+    WorkerPool detailWorkers;
+    // intermediateDB's corridors joined into one network at shared towns, and its segments.
+    // Both are built once and only read afterwards. Corridor segments run tens of km, so
+    // the cells are coarse too and a point far from every corridor costs only a few rings.
+    unordered_map<string, Node> roadNetwork;
+    unordered_map<string, int> roadComponent;
+    RoadSegmentIndex roadIndex{0.1};
+    // Corridors only hold the towns between their end cities, so a city centre can lie
+    // about 20 km from the nearest corridor segment
+    static constexpr double ROAD_SNAP_KM = 25.0;
+    static constexpr size_t ROAD_SNAP_CANDIDATES = 2;
+
+    void buildRoadNetwork() {
+        intermediateDB.forEachCorridor([this](const vector<pair<string, pair<double, double>>>& corridor) {
+            string prevId;
+            for (const auto& [name, coords] : corridor) {
+                string nodeId = "road_" + name;
+                if (roadNetwork.find(nodeId) == roadNetwork.end()) {
+                    roadNetwork[nodeId] = Node(nodeId, Location(name, coords.first, coords.second));
+                }
+                if (!prevId.empty()) {
+                    double dist = RouteUtils::getAccurateDistance(roadNetwork[prevId].location, roadNetwork[nodeId].location);
+                    roadNetwork[prevId].edges.push_back(make_pair(nodeId, dist));
+                    roadNetwork[nodeId].edges.push_back(make_pair(prevId, dist));
+                }
+                prevId = nodeId;
+            }
+        });
+        roadIndex.build(roadNetwork);
+        
+        // Corridors that share no town stay separate components
+        int components = 0;
+        for (const auto& node : roadNetwork) {
+            if (roadComponent.count(node.first)) continue;
+            vector<string> pending = {node.first};
+            roadComponent[node.first] = components;
+            while (!pending.empty()) {
+                string current = pending.back();
+                pending.pop_back();
+                for (const auto& edge : roadNetwork[current].edges) {
+                    if (roadComponent.emplace(edge.first, components).second) pending.push_back(edge.first);
+                }
+            }
+            components++;
+        }
+    }
+
+public:
+    // detailThreads defaults to the HTTP pool size per host; a server with many concurrent
+    // requests wants more, so slow upstream legs of a few do not hold up the rest
+    explicit RouteFinder(size_t detailThreads = 8)
+        : detailWorkers(detailThreads) {
+        buildRoadNetwork();
+    }
+
+    void setHeuristicMode(HeuristicMode mode) {
+        heuristicMode = mode;
+    }
+
+    void setRoutingBackendMode(RoutingBackendMode mode) {
+        if (mode != BACKEND_DEFAULT) backendMode = mode;
+    }
+
+    RoutingBackendMode getRoutingBackendMode() const {
+        return backendMode;
+    }
+
+    static bool parseRoutingBackendMode(const string& text, RoutingBackendMode& mode) {
+        if (text == "auto") mode = BACKEND_AUTO;
+        else if (text == "local") mode = BACKEND_LOCAL;
+        else if (text == "remote") mode = BACKEND_REMOTE;
+        else return false;
+        return true;
+    }
+
+    // Backends in the order a query in this mode consults them
+    vector<RoutingBackend*> backendChain(RoutingBackendMode mode) {
+        switch (mode == BACKEND_DEFAULT ? backendMode : mode) {
+            case BACKEND_LOCAL: return {&tableBackend, &localBackend};
+            case BACKEND_REMOTE: return {&osrmBackend, &tableBackend, &localBackend};
+            default: return {&tableBackend, &osrmBackend, &localBackend};
+        }
+    }
+
+    // Cost accounting of every backend since startup
+    vector<pair<string, RoutingBackend::Stats>> backendStats() const {
+        return {
+            make_pair(tableBackend.name(), tableBackend.stats()),
+            make_pair(osrmBackend.name(), osrmBackend.stats()),
+            make_pair(localBackend.name(), localBackend.stats())
+        };
+    }
+
+    // Straight-line estimates to the goal are filled in as the search reaches nodes rather
+    // than for the whole graph up front: the start here, then each expansion's unseen
+    // neighbours in one batched pass. Known city pairs keep their table distance. The cheap
+    // ruler's box grows with the frontier, so every estimate is admissible for its own pair.
+    void startHeuristics(
+        const unordered_map<string, Node>& graph,
+        const string& startId,
+        const string& endId,
+        HeuristicMode mode,
+        SearchWorkspace& workspace) {
+        
+        workspace.heuristics.clear();
+        workspace.goal = &graph.at(endId).location;
+        workspace.heuristicMode = mode;
+        
+        const Location& start = graph.at(startId).location;
+        if (mode == CHEAP_RULER_HEURISTIC) {
+            workspace.rulerBounds = CheapRuler::Bounds();
+            workspace.rulerBounds.extend(*workspace.goal);
+            workspace.rulerBounds.extend(start);
+            workspace.ruler = CheapRuler::forBounds(workspace.rulerBounds);
+            workspace.heuristics[startId] = workspace.ruler.distance(start, *workspace.goal);
+        } else {
+            workspace.heuristics[startId] = RouteUtils::getAccurateDistance(start, *workspace.goal);
+        }
+    }
+
+    void estimateNeighbors(const unordered_map<string, Node>& graph, const Node& node, SearchWorkspace& workspace) {
+        const Location& goal = *workspace.goal;
+        unordered_map<string, double>& heuristics = workspace.heuristics;
+        vector<const Node*>& nodes = workspace.nodes;
+        nodes.clear();
+        for (const auto& edge : node.edges) {
+            if (heuristics.find(edge.first) == heuristics.end()) {
+                nodes.push_back(&graph.at(edge.first));
+            }
+        }
+        if (nodes.empty()) return;
+        
+        if (workspace.heuristicMode == CHEAP_RULER_HEURISTIC) {
+            for (const Node* neighbor : nodes) {
+                if (workspace.rulerBounds.extend(neighbor->location)) {
+                    workspace.ruler = CheapRuler::forBounds(workspace.rulerBounds);
+                }
+                heuristics[neighbor->id] = workspace.ruler.distance(neighbor->location, goal);
+            }
+            return;
+        }
+        
+        vector<double>& lats = workspace.lats;
+        vector<double>& lons = workspace.lons;
+        vector<double>& cosLats = workspace.cosLats;
+        lats.clear();
+        lons.clear();
+        cosLats.clear();
+        for (const Node* neighbor : nodes) {
+            lats.push_back(neighbor->location.lat);
+            lons.push_back(neighbor->location.lon);
+            cosLats.push_back(neighbor->location.cosLat);
+        }
+        
+        vector<double>& distances = workspace.distances;
+        distances.resize(nodes.size());
+        RouteUtils::calculateDistanceBatch(goal, lats.data(), lons.data(), cosLats.data(),
+                                           distances.data(), nodes.size());
+        
+        for (size_t i = 0; i < nodes.size(); i++) {
+            double tableDistance;
+            if (RouteUtils::getCityTableDistance(nodes[i]->location, goal, tableDistance)) {
+                distances[i] = tableDistance;
+            }
+            heuristics[nodes[i]->id] = distances[i];
+        }
+    }
+
+    vector<string> findBestFirstPath(
+        const unordered_map<string, Node>& graph,
+        const string& startId,
+        const string& endId,
+        HeuristicMode mode = ACCURATE_HEURISTIC) {
+        
+        SearchWorkspace& workspace = SearchWorkspace::forThisThread();
+        workspace.resetSearch();
+        auto& openSet = workspace.openSet;
+        auto& cameFrom = workspace.cameFrom;
+        auto& closedSet = workspace.closedSet;
+        
+        try {
+            startHeuristics(graph, startId, endId, mode, workspace);
+            const unordered_map<string, double>& heuristics = workspace.heuristics;
+            workspace.pushOpen(heuristics.at(startId), startId);
+            
+            while (!openSet.empty()) {
+                string current = workspace.popOpen();
+                
+                if (current == endId) {
+                    vector<string> path;
+                    while (current != startId) {
+                        path.push_back(current);
+                        current = cameFrom[current];
+                    }
+                    path.push_back(startId);
+                    reverse(path.begin(), path.end());
+                    return path;
+                }
+                
+                closedSet.insert(current);
+                
+                const Node& currentNode = graph.at(current);
+                estimateNeighbors(graph, currentNode, workspace);
+                for (const auto& neighbor : currentNode.edges) {
+                    const string& neighborId = neighbor.first;
+                    
+                    if (closedSet.count(neighborId) > 0) {
+                        continue;
+                    }
+                    
+                    double heuristic = heuristics.at(neighborId);
+                    
+                    if (cameFrom.find(neighborId) == cameFrom.end()) {
+                        cameFrom[neighborId] = current;
+                        workspace.pushOpen(heuristic, neighborId);
+                    }
+                }
+            }
+        } catch (const exception& e) {
+            cerr << "Error in findBestFirstPath: " << e.what() << endl;
+        }
+        
+        return {};
+    }
+
+    vector<string> findShortestPath(
+        const unordered_map<string, Node>& graph,
+        const string& startId,
+        const string& endId,
+        HeuristicMode mode = ACCURATE_HEURISTIC) {
+        
+        SearchWorkspace& workspace = SearchWorkspace::forThisThread();
+        workspace.resetSearch();
+        auto& openSet = workspace.openSet;
+        auto& cameFrom = workspace.cameFrom;
+        auto& gScore = workspace.gScore;
+        
+        try {
+            startHeuristics(graph, startId, endId, mode, workspace);
+            const unordered_map<string, double>& heuristics = workspace.heuristics;
+            // Nodes without a gScore entry have not been reached yet
+            gScore[startId] = 0;
+            workspace.pushOpen(heuristics.at(startId), startId);
+            
+            while (!openSet.empty()) {
+                string current = workspace.popOpen();
+                
+                if (current == endId) {
+                    vector<string> path;
+                    while (current != startId) {
+                        path.push_back(current);
+                        current = cameFrom[current];
+                    }
+                    path.push_back(startId);
+                    reverse(path.begin(), path.end());
+                    return path;
+                }
+                
+                const Node& currentNode = graph.at(current);
+                estimateNeighbors(graph, currentNode, workspace);
+                for (const auto& neighbor : currentNode.edges) {
+                    const string& neighborId = neighbor.first;
+                    double distance = neighbor.second;
+                    
+                    double tentativeGScore = gScore[current] + distance;
+                    
+                    auto known = gScore.find(neighborId);
+                    if (known == gScore.end() || tentativeGScore < known->second) {
+                        cameFrom[neighborId] = current;
+                        gScore[neighborId] = tentativeGScore;
+                        
+                        double heuristic = heuristics.at(neighborId);
+                        
+                        double fScore = tentativeGScore + heuristic;
+                        workspace.pushOpen(fScore, neighborId);
+                    }
+                }
+            }
+        } catch (const exception& e) {
+            cerr << "Error in findShortestPath: " << e.what() << endl;
+        }
+        
+        return {};
+    }
+
+    void addIntermediateLocationsToGraph(
+        unordered_map<string, Node>& graph,
+        const string& startId,
+        const string& endId,
+        const Location& startLocation,
+        const Location& endLocation,
+        const string& startCity,
+        const string& endCity) {
+        
+        auto intermediates = intermediateDB.getIntermediates(startCity, endCity);
+        if (intermediates.empty()) return;
+        
+        for (size_t i = 0; i < intermediates.size(); i++) {
+            const auto& [name, coords] = intermediates[i];
+            const auto& [lat, lon] = coords;
+            
+            string nodeId = "intermediate_" + to_string(i);
+            Location loc(name, lat, lon);
+            graph[nodeId] = Node(nodeId, loc);
+            
+            if (i == 0) {
+                double dist = RouteUtils::getAccurateDistance(startLocation, loc);
+                graph[startId].edges.push_back(make_pair(nodeId, dist));
+            } else {
+                string prevId = "intermediate_" + to_string(i-1);
+                double dist = RouteUtils::getAccurateDistance(graph[prevId].location, loc);
+                graph[prevId].edges.push_back(make_pair(nodeId, dist));
+            }
+            
+            if (i == intermediates.size() - 1) {
+                double dist = RouteUtils::getAccurateDistance(loc, endLocation);
+                graph[nodeId].edges.push_back(make_pair(endId, dist));
+            }
+        }
+    }
+
+    // Attach a graph node to its nearest road segments. Origins get edges out to both ends
+    // of each candidate segment, destinations get edges in from them.
+    bool snapNodeToRoadNetwork(
+        unordered_map<string, Node>& graph,
+        const string& nodeId,
+        bool isOrigin,
+        double maxDistanceKm = ROAD_SNAP_KM) {
+        
+        auto it = graph.find(nodeId);
+        if (it == graph.end()) return false;
+        
+        const Location loc = it->second.location;
+        vector<RoadSegmentIndex::SnapResult> snaps =
+            roadIndex.nearest(loc.lat, loc.lon, ROAD_SNAP_CANDIDATES, maxDistanceKm);
+        for (const auto& snap : snaps) {
+            double segmentLength = RouteUtils::getAccurateDistance(
+                roadNetwork.at(snap.fromId).location, roadNetwork.at(snap.toId).location);
+            double toFrom = snap.distance + segmentLength * snap.ratio;
+            double toTo = snap.distance + segmentLength * (1.0 - snap.ratio);
+            
+            if (isOrigin) {
+                graph[nodeId].edges.push_back(make_pair(snap.fromId, toFrom));
+                graph[nodeId].edges.push_back(make_pair(snap.toId, toTo));
+            } else {
+                graph[snap.fromId].edges.push_back(make_pair(nodeId, toFrom));
+                graph[snap.toId].edges.push_back(make_pair(nodeId, toTo));
+            }
+        }
+        return !snaps.empty();
+    }
+
+    // Routes between endpoints the corridor tables do not know by name, such as "lat,lon"
+    // queries, through the road network when both ends lie near one connected part of it.
+    // Leaves graph untouched otherwise.
+    bool connectToRoadNetwork(unordered_map<string, Node>& graph, const string& startId, const string& endId) {
+        const Location& start = graph.at(startId).location;
+        const Location& end = graph.at(endId).location;
+        RoadSegmentIndex::SnapResult startSnap = roadIndex.snap(start.lat, start.lon, ROAD_SNAP_KM);
+        RoadSegmentIndex::SnapResult endSnap = roadIndex.snap(end.lat, end.lon, ROAD_SNAP_KM);
+        if (!startSnap.found() || !endSnap.found()) return false;
+        
+        int component = roadComponent.at(startSnap.fromId);
+        if (roadComponent.at(endSnap.fromId) != component) return false;
+        for (const auto& node : roadNetwork) {
+            if (roadComponent.at(node.first) == component) graph.insert(node);
+        }
+        snapNodeToRoadNetwork(graph, startId, true);
+        snapNodeToRoadNetwork(graph, endId, false);
+        return true;
+    }
+
+    // The straight start-end edge is shorter than any road, so the route along the road
+    // network is searched with it set aside
+    vector<string> findRoadPath(unordered_map<string, Node>& graph, const string& startId, const string& endId) {
+        auto& edges = graph.at(startId).edges;
+        auto direct = find_if(edges.begin(), edges.end(),
+            [&endId](const pair<string, double>& edge) { return edge.first == endId; });
+        if (direct == edges.end()) return findShortestPath(graph, startId, endId, heuristicMode);
+        
+        size_t position = direct - edges.begin();
+        pair<string, double> saved = *direct;
+        edges.erase(direct);
+        vector<string> path = findShortestPath(graph, startId, endId, heuristicMode);
+        edges.insert(edges.begin() + position, saved);
+        return path;
+    }
+
+    // Fills graph with the two endpoints, the direct edge between them and whatever
+    // alternatives generateMultipleRoutes adds. Touches no shared state, so concurrent
+    // callers only need their own graphs. onRoute, if given, sees each route as soon as its
+    // search finishes, while graph still holds everything that route uses.
+    vector<vector<string>> planRoutes(
+        unordered_map<string, Node>& graph,
+        const Location& startLocation,
+        const Location& endLocation,
+        double directDistance,
+        RouteType routeType = FASTEST,
+        const function<void(const vector<string>&)>& onRoute = nullptr) {
+        
+        graph.clear();
+        string startId = "start";
+        string endId = "end";
+        
+        graph[startId] = Node(startId, startLocation);
+        graph[endId] = Node(endId, endLocation);
+        graph[startId].edges.push_back(make_pair(endId, directDistance));
+        
+        return generateMultipleRoutes(graph, startId, endId, startLocation, endLocation, routeType, onRoute);
+    }
+
+    // planRoutes that delivers results as they become available. onRoute runs on the calling
+    // thread right after each route's search, before any alternative is searched, and
+    // returns whether that route needs road names. Those resolve on the detail workers while
+    // the remaining searches run, and onDetails receives them on the calling thread in
+    // completion order.
+    vector<vector<string>> planRoutesProgressive(
+        unordered_map<string, Node>& graph,
+        const Location& startLocation,
+        const Location& endLocation,
+        double directDistance,
+        RouteType routeType,
+        Deadline deadline,
+        RoutingBackendMode mode,
+        const function<bool(size_t, const vector<string>&)>& onRoute,
+        const function<void(size_t, const vector<vector<string>>&)>& onDetails) {
+        
+        struct Ready {
+            mutex readyMutex;
+            condition_variable arrived;
+            deque<pair<size_t, vector<vector<string>>>> details;
+        };
+        auto ready = make_shared<Ready>();
+        size_t found = 0;
+        size_t pending = 0;
+        
+        vector<vector<string>> routes = planRoutes(graph, startLocation, endLocation, directDistance, routeType,
+            [&](const vector<string>& path) {
+                size_t index = found++;
+                if (!onRoute(index, path)) return;
+                pending++;
+                
+                // Later searches add nodes to graph, so the worker gets its own copy of the waypoints
+                vector<Location> waypoints;
+                for (const auto& nodeId : path) {
+                    waypoints.push_back(graph.at(nodeId).location);
+                }
+                detailWorkers.submit([this, ready, index, waypoints, routeType, deadline, mode]() {
+                    vector<vector<string>> details;
+                    try {
+                        details = getWaypointRouteDetails(waypoints, routeType, deadline, mode);
+                    } catch (const exception& e) {
+                        cerr << "Error resolving route details: " << e.what() << endl;
+                    }
+                    lock_guard<mutex> lock(ready->readyMutex);
+                    ready->details.emplace_back(index, move(details));
+                    ready->arrived.notify_all();
+                });
+            });
+        
+        for (size_t delivered = 0; delivered < pending; delivered++) {
+            pair<size_t, vector<vector<string>>> next;
+            {
+                unique_lock<mutex> lock(ready->readyMutex);
+                ready->arrived.wait(lock, [&ready]() { return !ready->details.empty(); });
+                next = move(ready->details.front());
+                ready->details.pop_front();
+            }
+            onDetails(next.first, next.second);
+        }
+        return routes;
+    }
+
+    // "Surabaya → Sidoarjo → Malang (85 km, 1 hr 25 min)", available before any road names
+    string formatRouteSummary(
+        const vector<string>& path,
+        const unordered_map<string, Node>& graph,
+        RouteType routeType) const {
+        
+        string result;
+        for (size_t i = 0; i < path.size(); i++) {
+            auto node = graph.find(path[i]);
+            if (i > 0) result += " → ";
+            result += node == graph.end() ? path[i] : node->second.location.name;
+        }
+        
+        double totalDistance = pathDistance(path, graph);
+        int totalTime = static_cast<int>(totalDistance / averageSpeedKmh(routeType) * 60);
+        result += " (" + to_string(static_cast<int>(totalDistance)) + " km, ";
+        if (totalTime >= 60) {
+            result += to_string(totalTime / 60) + " hr ";
+        }
+        result += to_string(totalTime % 60) + " min)";
+        return RouteUtils::cleanRouteSymbols(result);
+    }
+
+    // Sum of the edge weights along path, in km
+    static double pathDistance(const vector<string>& path, const unordered_map<string, Node>& graph) {
+        double total = 0;
+        for (size_t i = 0; i + 1 < path.size(); i++) {
+            auto node = graph.find(path[i]);
+            if (node == graph.end()) continue;
+            for (const auto& edge : node->second.edges) {
+                if (edge.first == path[i + 1]) {
+                    total += edge.second;
+                    break;
+                }
+            }
+        }
+        return total;
+    }
+
+    static double averageSpeedKmh(RouteType routeType) {
+        switch (routeType) {
+            case SHORTEST: return 50.0;
+            case AVOID_TOLLS: return 45.0;
+            case SCENIC: return 40.0;
+            default: return 60.0;
+        }
+    }
+
+    vector<vector<string>> generateMultipleRoutes(
+        unordered_map<string, Node>& graph,
+        const string& startId,
+        const string& endId,
+        const Location& startLocation,
+        const Location& endLocation,
+        RouteType routeType = FASTEST,
+        const function<void(const vector<string>&)>& onRoute = nullptr) {
+        
+        vector<vector<string>> routes;
+        
+        try {
+            vector<string> directPath = findBestFirstPath(graph, startId, endId, heuristicMode);
+            if (!directPath.empty()) {
+                routes.push_back(directPath);
+                if (onRoute) onRoute(routes.back());
+            }
+            
+            vector<Location> intermediateLocations;
+            string startCity = Location::extractCityName(startLocation.name);
+            string endCity = Location::extractCityName(endLocation.name);
+            bool foundKnownRoute = false;
+            bool onRoadNetwork = false;
+            
+            static unordered_map<string, unordered_map<string, vector<string>>> knownIntermediates = {
+                {"Surabaya", {
+                    {"Gresik", {"Tandes", "Benowo"}}, 
+                    {"Sidoarjo", {"Wonokromo", "Waru"}},
+                    {"Malang", {"Sidoarjo", "Pandaan", "Lawang"}},
+                    {"Probolinggo", {"Sidoarjo", "Pasuruan", "Kraksaan"}}
+                }},
+                {"Jakarta", {
+                    {"Bandung", {"Bekasi", "Purwakarta", "Cimahi"}},
+                    {"Bogor", {"Depok", "Cibinong"}}
+                }}
+            };
+            
+            auto it1 = knownIntermediates.find(startCity);
+            if (it1 != knownIntermediates.end()) {
+                auto it2 = it1->second.find(endCity);
+                if (it2 != it1->second.end()) {
+                    foundKnownRoute = true;
+                    const auto& waypoints = it2->second;
+                    
+                    for (size_t i = 0; i < waypoints.size(); i++) {
+                        string nodeId = "known_waypoint" + to_string(i+1);
+                        double ratio = (i+1.0) / (waypoints.size()+1.0);
+                        double lat = startLocation.lat + (endLocation.lat - startLocation.lat) * ratio;
+                        double lon = startLocation.lon + (endLocation.lon - startLocation.lon) * ratio;
+                        Location wp(waypoints[i], lat, lon);
+                        graph[nodeId] = Node(nodeId, wp);
+                        
+                        if (i == 0) {
+                            double dist = RouteUtils::getAccurateDistance(startLocation, wp);
+                            graph[startId].edges.push_back(make_pair(nodeId, dist));
+                            dist = RouteUtils::getAccurateDistance(wp, endLocation);
+                            graph[nodeId].edges.push_back(make_pair(endId, dist));
+                        } else {
+                            string prevId = "known_waypoint" + to_string(i);
+                            double dist = RouteUtils::getAccurateDistance(graph[prevId].location, wp);
+                            graph[prevId].edges.push_back(make_pair(nodeId, dist));
+                            dist = RouteUtils::getAccurateDistance(wp, endLocation);
+                            graph[nodeId].edges.push_back(make_pair(endId, dist));
+                        }
+                    }
+                }
+            }
+            
+            if (!foundKnownRoute) {
+                addIntermediateLocationsToGraph(graph, startId, endId, 
+                    startLocation, endLocation, startCity, endCity);
+                
+                bool hasIntermediates = false;
+                for (const auto& edge : graph[startId].edges) {
+                    if (edge.first != endId && edge.first.find("intermediate_") != string::npos) {
+                        hasIntermediates = true;
+                        break;
+                    }
+                }
+                if (!hasIntermediates) hasIntermediates = onRoadNetwork = connectToRoadNetwork(graph, startId, endId);
+                if (hasIntermediates) foundKnownRoute = true;
+            }
+
+            if (!foundKnownRoute && (routeType == AVOID_TOLLS || routeType == SCENIC)) {
+                for (int i = 1; i <= 3; i++) {
+                    double ratio = i / 4.0;
+                    double latOffset = (i % 2 == 0) ? 0.01 : -0.01;
+                    double lonOffset = (i % 2 == 0) ? -0.01 : 0.01;
+                    
+                    if (routeType == SCENIC) {
+                        latOffset *= 2;
+                        lonOffset *= 2;
+                    }
+                    
+                    string waypointName = waypointDB.getWaypointName(
+                        Location::extractCityName(startLocation.name),
+                        Location::extractCityName(endLocation.name),
+                        i-1
+                    );
+                    
+                    Location intermediate(
+                        waypointName,
+                        startLocation.lat + (endLocation.lat - startLocation.lat) * ratio + latOffset,
+                        startLocation.lon + (endLocation.lon - startLocation.lon) * ratio + lonOffset
+                    );
+                    intermediateLocations.push_back(intermediate);
+                    
+                    string nodeId = "waypoint" + to_string(i);
+                    graph[nodeId] = Node(nodeId, intermediate);
+                }
+                
+                for (size_t i = 0; i < intermediateLocations.size(); i++) {
+                    string nodeId = "waypoint" + to_string(i+1);
+                    graph[startId].edges.push_back(make_pair(nodeId, 
+                        RouteUtils::getAccurateDistance(
+                            graph[startId].location, 
+                            graph[nodeId].location
+                        )
+                    ));
+                    graph[nodeId].edges.push_back(make_pair(endId, 
+                        RouteUtils::getAccurateDistance(
+                            graph[nodeId].location, 
+                            graph[endId].location
+                        )
+                    ));
+                    
+                    if (i > 0) {
+                        string prevNodeId = "waypoint" + to_string(i);
+                        graph[prevNodeId].edges.push_back(make_pair(nodeId, 
+                            RouteUtils::getAccurateDistance(
+                                graph[prevNodeId].location, 
+                                graph[nodeId].location
+                            )
+                        ));
+                    }
+                }
+            } else if (!foundKnownRoute) {
+                for (int i = 1; i <= 2; i++) {
+                    double ratio = i / 3.0;
+                    double latOffset = (i % 2 == 0) ? 0.005 : -0.005;
+                    double lonOffset = (i % 2 == 0) ? -0.005 : 0.005;
+                    
+                    string waypointName = waypointDB.getWaypointName(
+                        Location::extractCityName(startLocation.name),
+                        Location::extractCityName(endLocation.name),
+                        i-1
+                    );
+                    
+                    Location intermediate(
+                        waypointName,
+                        startLocation.lat + (endLocation.lat - startLocation.lat) * ratio + latOffset,
+                        startLocation.lon + (endLocation.lon - startLocation.lon) * ratio + lonOffset
+                    );
+                    
+                    string nodeId = "waypoint" + to_string(i);
+                    graph[nodeId] = Node(nodeId, intermediate);
+                    
+                    if (i == 1) {
+                        double dist = RouteUtils::getAccurateDistance(startLocation, intermediate);
+                        graph[startId].edges.push_back(make_pair(nodeId, dist));
+                        dist = RouteUtils::getAccurateDistance(intermediate, endLocation);
+                        graph[nodeId].edges.push_back(make_pair(endId, dist));
+                    } else {
+                        string prevId = "waypoint" + to_string(i-1);
+                        double dist = RouteUtils::getAccurateDistance(startLocation, intermediate);
+                        graph[startId].edges.push_back(make_pair(nodeId, dist));
+                        dist = RouteUtils::getAccurateDistance(graph[prevId].location, intermediate);
+                        graph[prevId].edges.push_back(make_pair(nodeId, dist));
+                        dist = RouteUtils::getAccurateDistance(intermediate, endLocation);
+                        graph[nodeId].edges.push_back(make_pair(endId, dist));
+                    }
+                }
+            }
+            
+            vector<string> altPath1 = findBestFirstPath(graph, startId, endId, heuristicMode);
+            if (!altPath1.empty() && (routes.empty() || altPath1 != routes[0])) {
+                routes.push_back(altPath1);
+                if (onRoute) onRoute(routes.back());
+            }
+            
+            vector<string> altPath2 = findShortestPath(graph, startId, endId, heuristicMode);
+            if (!altPath2.empty() && (routes.empty() || altPath2 != routes[0]) && 
+                (routes.size() < 2 || altPath2 != routes[1])) {
+                routes.push_back(altPath2);
+                if (onRoute) onRoute(routes.back());
+            }
+            
+            if (onRoadNetwork) {
+                vector<string> roadPath = findRoadPath(graph, startId, endId);
+                if (!roadPath.empty() && find(routes.begin(), routes.end(), roadPath) == routes.end()) {
+                    routes.push_back(roadPath);
+                    if (onRoute) onRoute(routes.back());
+                }
+            }
+        } catch (const exception& e) {
+            cerr << "Error in generateMultipleRoutes: " << e.what() << endl;
+        }
+        
+        return routes;
+    }
+
+    // Coordinates quantized to SEGMENT_KEY_DEGREES plus the city names the road and toll
+    // tables are keyed on, so nearby geocodes of one place share memo entries
+    static string segmentKey(const Location& start, const Location& end, RouteType routeType) {
+        auto quantize = [](double degrees) { return llround(degrees / SEGMENT_KEY_DEGREES); };
+        stringstream key;
+        key << quantize(start.lat) << ',' << quantize(start.lon) << '|' << Location::extractCityName(start.name) << '|'
+            << quantize(end.lat) << ',' << quantize(end.lon) << '|' << Location::extractCityName(end.name) << '|'
+            << static_cast<int>(routeType);
+        return key.str();
+    }
+
+    // Segment memo key; a local-only answer must not satisfy a query that may go remote
+    string detailKey(const Location& start, const Location& end, RouteType routeType, RoutingBackendMode mode) const {
+        return segmentKey(start, end, routeType) + '|' + to_string(mode == BACKEND_DEFAULT ? backendMode : mode);
+    }
+
+    // Memoized for the session; concurrent misses for the same segment share one resolution
+    vector<string> getRouteDetails(const Location& start, const Location& end, RouteType routeType = FASTEST,
+                                   Deadline deadline = Deadline(), RoutingBackendMode mode = BACKEND_DEFAULT) {
+        string key = detailKey(start, end, routeType, mode);
+        vector<string> memo;
+        if (segmentDetailMemo.get(key, memo)) {
+            return memo;
+        }
+        return routeDetailFlights.run(key, [&]() {
+            vector<vector<string>> legs(1);
+            if (!resolveLegs({start, end}, routeType, deadline, mode, legs)[0]) {
+                segmentDetailMemo.put(key, legs[0]);
+            }
+            return legs[0];
+        });
+    }
+
+    // Names every empty leg by walking the mode's backend chain. Returns which legs were left
+    // to the backends after OSRM: stand-ins while it is down or out of time, which must not
+    // be remembered like its answers.
+    vector<bool> resolveLegs(const vector<Location>& waypoints, RouteType routeType, Deadline deadline,
+                             RoutingBackendMode mode, vector<vector<string>>& legs) {
+        vector<bool> fallback(legs.size(), false);
+        bool pastOsrm = false;
+        for (RoutingBackend* backend : backendChain(mode)) {
+            if (pastOsrm) {
+                for (size_t i = 0; i < legs.size(); i++) {
+                    if (legs[i].empty()) fallback[i] = true;
+                }
+            }
+            backend->resolve(waypoints, routeType, deadline, legs);
+            if (backend == &osrmBackend) pastOsrm = true;
+        }
+        return fallback;
+    }
+
+    // Resolves the road names of all routes concurrently, one getWaypointRouteDetails task per
+    // route, so OSRM sees one multi-waypoint request per route rather than one per segment.
+    // Returns them in route order and leaves the toll pairs memoized. Waits for its own tasks
+    // only, so callers on different threads can prefetch at the same time. Segments OSRM
+    // cannot answer before the deadline are synthesized, and usedFallback reports whether
+    // any were.
+    vector<vector<vector<string>>> prefetchRouteDetails(
+        const vector<vector<string>>& routes,
+        const unordered_map<string, Node>& graph,
+        RouteType routeType,
+        Deadline deadline = Deadline(),
+        RoutingBackendMode mode = BACKEND_DEFAULT,
+        bool* usedFallback = nullptr) {
+        
+        vector<future<pair<vector<vector<string>>, bool>>> pending;
+        unordered_set<string> seenTolls;
+        vector<pair<Location, Location>> tollPairs;
+        for (const auto& route : routes) {
+            vector<Location> waypoints;
+            for (const auto& nodeId : route) {
+                auto it = graph.find(nodeId);
+                if (it == graph.end()) {
+                    waypoints.clear();
+                    break;
+                }
+                waypoints.push_back(it->second.location);
+            }
+            
+            auto task = make_shared<packaged_task<pair<vector<vector<string>>, bool>()>>(
+                [this, waypoints, routeType, deadline, mode]() {
+                    bool fallback = false;
+                    vector<vector<string>> details = getWaypointRouteDetails(waypoints, routeType, deadline, mode, &fallback);
+                    return make_pair(move(details), fallback);
+                });
+            pending.push_back(task->get_future());
+            detailWorkers.submit([task]() { (*task)(); });
+            
+            if (routeType != AVOID_TOLLS && waypoints.size() >= 2 &&
+                seenTolls.insert(segmentKey(waypoints.front(), waypoints.back(), routeType)).second) {
+                tollPairs.push_back(make_pair(waypoints.front(), waypoints.back()));
+            }
+        }
+        
+        // Toll lookups are table work; do them here while the routes are in flight
+        for (const auto& tollPair : tollPairs) {
+            double cost;
+            string currency;
+            getTollInfo(tollPair.first, tollPair.second, routeType, cost, currency);
+        }
+        
+        vector<vector<vector<string>>> details(routes.size());
+        for (size_t i = 0; i < pending.size(); i++) {
+            try {
+                pair<vector<vector<string>>, bool> resolved = pending[i].get();
+                details[i] = move(resolved.first);
+                if (usedFallback && resolved.second) *usedFallback = true;
+            } catch (const exception& e) {
+                cerr << "Error prefetching route details: " << e.what() << endl;
+            }
+        }
+        return details;
+    }
+
+    // Road names for every segment of a path. Memoized segments are reused and the rest go
+    // through the backend chain together, so OSRM sees one multi-waypoint request per
+    // stretch rather than one per segment. Returns an empty list when the path names a node
+    // missing from the graph.
+    vector<vector<string>> getPathRouteDetails(
+        const vector<string>& path,
+        const unordered_map<string, Node>& graph,
+        RouteType routeType = FASTEST,
+        Deadline deadline = Deadline(),
+        RoutingBackendMode mode = BACKEND_DEFAULT) {
+        
+        vector<Location> waypoints;
+        for (const auto& nodeId : path) {
+            auto it = graph.find(nodeId);
+            if (it == graph.end()) return {};
+            waypoints.push_back(it->second.location);
+        }
+        return getWaypointRouteDetails(waypoints, routeType, deadline, mode);
+    }
+
+    // getPathRouteDetails for a path already turned into its locations. usedFallback, if
+    // given, is set when a leg had to be synthesized in place of an OSRM answer.
+    vector<vector<string>> getWaypointRouteDetails(
+        const vector<Location>& waypoints,
+        RouteType routeType = FASTEST,
+        Deadline deadline = Deadline(),
+        RoutingBackendMode mode = BACKEND_DEFAULT,
+        bool* usedFallback = nullptr) {
+        
+        if (waypoints.size() < 2) return {};
+        
+        stringstream key;
+        for (size_t i = 0; i + 1 < waypoints.size(); i++) {
+            key << detailKey(waypoints[i], waypoints[i + 1], routeType, mode) << ';';
+        }
+        pair<vector<vector<string>>, bool> resolved = pathDetailFlights.run(key.str(), [&]() {
+            return resolvePathDetails(waypoints, routeType, deadline, mode);
+        });
+        if (usedFallback && resolved.second) *usedFallback = true;
+        return move(resolved.first);
+    }
+
+    // Fallback legs stay out of the memo so the next request asks OSRM again
+    pair<vector<vector<string>>, bool> resolvePathDetails(const vector<Location>& waypoints, RouteType routeType,
+                                                          Deadline deadline, RoutingBackendMode mode) {
+        size_t segments = waypoints.size() - 1;
+        vector<vector<string>> details(segments);
+        vector<string> keys(segments);
+        vector<bool> memoized(segments, false);
+        for (size_t i = 0; i < segments; i++) {
+            keys[i] = detailKey(waypoints[i], waypoints[i + 1], routeType, mode);
+            memoized[i] = segmentDetailMemo.get(keys[i], details[i]);
+        }
+        
+        vector<bool> fallback = resolveLegs(waypoints, routeType, deadline, mode, details);
+        
+        bool usedFallback = false;
+        for (size_t i = 0; i < segments; i++) {
+            if (fallback[i]) {
+                usedFallback = true;
+            } else if (!memoized[i]) {
+                segmentDetailMemo.put(keys[i], details[i]);
+            }
+        }
+        return make_pair(move(details), usedFallback);
+    }
+
+    // Memoized for the session under the same key as segment details
+    vector<TollInfo> getTollInfo(const Location& start, const Location& end, RouteType routeType, 
+                              double& totalCost, string& currency) {
+        string key = segmentKey(start, end, routeType);
+        TollResult memo;
+        if (!tollMemo.get(key, memo)) {
+            memo.tolls = computeTollInfo(start, end, routeType, memo.totalCost, memo.currency);
+            tollMemo.put(key, memo);
+        }
+        totalCost = memo.totalCost;
+        currency = memo.currency;
+        return memo.tolls;
+    }
+
+    vector<TollInfo> computeTollInfo(const Location& start, const Location& end, RouteType routeType, 
+                              double& totalCost, string& currency) {
+        vector<TollInfo> tolls;
+        totalCost = 0;
+        currency = "IDR";
+        
+        if (routeType == AVOID_TOLLS) {
+            return tolls;
+        }
+        
+        string startCity = Location::extractCityName(start.name);
+        string endCity = Location::extractCityName(end.name);
+        
+        static unordered_map<string, unordered_map<string, vector<TollInfo>>> knownTolls = {
+            {"Jakarta", {
+                {"Bogor", {
+                    TollInfo("Jagorawi Toll Road", "Jasa Marga", 15000),
+                    TollInfo("Jakarta Inner Ring Road", "Jasa Marga", 10000)
+                }},
+                {"Bandung", {
+                    TollInfo("Cipularang Toll Road", "Jasa Marga", 35000),
+                    TollInfo("Jakarta-Cikampek Toll Road", "Jasa Marga", 25000)
+                }},
+                {"Bekasi", {
+                    TollInfo("Jakarta-Cikampek Toll Road", "Jasa Marga", 12000)
+                }},
+                {"Tangerang", {
+                    TollInfo("Jakarta-Tangerang Toll Road", "Jasa Marga", 11000)
+                }}
+            }},
+            {"Surabaya", {
+                {"Sidoarjo", {
+                    TollInfo("Surabaya-Gempol Toll Road", "Jasa Marga", 7500)
+                }},
+                {"Malang", {
+                    TollInfo("Surabaya-Malang Toll Road", "Jasa Marga", 28000)
+                }},
+                {"Gresik", {
+                    TollInfo("MERR Toll Road", "Jasa Marga", 7000)
+                }},
+                {"Mojokerto", {
+                    TollInfo("Surabaya-Mojokerto Toll Road", "Jasa Marga", 17500)
+                }},
+                {"Probolinggo", {
+                    TollInfo("Surabaya-Probolinggo Toll Road", "Jasa Marga", 25000)
+                }}
+            }},
+            {"Bandung", {
+                {"Jakarta", {
+                    TollInfo("Cipularang Toll Road", "Jasa Marga", 35000),
+                    TollInfo("Jakarta-Cikampek Toll Road", "Jasa Marga", 25000)
+                }},
+                {"Cimahi", {
+                    TollInfo("Padalarang-Cileunyi Toll Road", "Jasa Marga", 8000)
+                }}
+            }}
+        };
+        
+        auto it1 = knownTolls.find(startCity);
+        if (it1 != knownTolls.end()) {
+            auto it2 = it1->second.find(endCity);
+            if (it2 != it1->second.end()) {
+                tolls = it2->second;
+                for (const auto& toll : tolls) {
+                    totalCost += toll.cost;
+                }
+            }
+        }
+        
+        if (tolls.empty()) {
+            it1 = knownTolls.find(endCity);
+            if (it1 != knownTolls.end()) {
+                auto it2 = it1->second.find(startCity);
+                if (it2 != it1->second.end()) {
+                    tolls = it2->second;
+                    for (const auto& toll : tolls) {
+                        totalCost += toll.cost;
+                    }
+                }
+            }
+        }
+        
+        if (tolls.empty() && RouteUtils::getAccurateDistance(start, end) > 50) {
+            double distance = RouteUtils::getAccurateDistance(start, end);
+            double estimatedCost = distance * 1000;
+            tolls.push_back(TollInfo("Estimated Toll", "Various Operators", estimatedCost));
+            totalCost = estimatedCost;
+        }
+        
+        return tolls;
+    }
+
+    string formatRoute(
+        const vector<string>& path,
+        const unordered_map<string, Node>& graph,
+        RouteType routeType = FASTEST) {
+        
+        return formatRoute(path, graph, routeType, getPathRouteDetails(path, graph, routeType));
+    }
+
+    // segmentDetails[i] holds the road names between path[i] and path[i+1]
+    string formatRoute(
+        const vector<string>& path,
+        const unordered_map<string, Node>& graph,
+        RouteType routeType,
+        const vector<vector<string>>& segmentDetails) {
+        
+        if (path.empty()) return "No route available";
+        
+        string result;
+        double totalDistance = 0;
+        double totalTime = 0;
+        
+        try {
+            for (size_t i = 0; i < path.size() - 1; i++) {
+                const auto& currentNode = graph.at(path[i]);
+                const auto& nextNode = graph.at(path[i+1]);
+                
+                double segmentDistance = 0;
+                for (const auto& edge : currentNode.edges) {
+                    if (edge.first == path[i+1]) {
+                        segmentDistance = edge.second;
+                        break;
+                    }
+                }
+                
+                result += currentNode.location.name;
+                if (i < segmentDetails.size()) {
+                    for (const auto& road : segmentDetails[i]) {
+                        result += " → " + road;
+                    }
+                }
+                
+                if (i == path.size() - 2) {
+                    result += " → " + nextNode.location.name;
+                }
+                
+                totalDistance += segmentDistance;
+            }
+            
+            double speed = 60.0;
+            switch (routeType) {
+                case FASTEST: speed = 60.0; break;
+                case SHORTEST: speed = 50.0; break;
+                case AVOID_TOLLS: speed = 45.0; break;
+                case SCENIC: speed = 40.0; break;
+            }
+            totalTime = (totalDistance / speed) * 60;
+            
+            int hours = static_cast<int>(totalTime) / 60;
+            int minutes = static_cast<int>(totalTime) % 60;
+            
+            result += " (" + to_string(static_cast<int>(totalDistance)) + " km, ";
+            if (hours > 0) {
+                result += to_string(hours) + " hr ";
+            }
+            result += to_string(minutes) + " min)";
+            
+            if (routeType != AVOID_TOLLS && path.size() >= 2) {
+                double tollCost = 0;
+                string currency = "IDR";
+                const auto& startNode = graph.at(path.front());
+                const auto& endNode = graph.at(path.back());
+                vector<TollInfo> tolls = getTollInfo(startNode.location, endNode.location, routeType, tollCost, currency);
+                
+                if (!tolls.empty()) {
+                    result += "\nTotal Toll Cost: " + RouteUtils::formatCurrency(tollCost, currency);
+                }
+            } else if (routeType == AVOID_TOLLS) {
+                result += "\nThis route avoids all toll roads.";
+            }
+        } catch (const exception& e) {
+            cerr << "Error in formatRoute: " << e.what() << endl;
+            return "Error generating route details";
+        }
+        
+        return RouteUtils::cleanRouteSymbols(result);
+    }
+
+    string formatRouteWithRealDirections(
+        const vector<string>& path,
+        const unordered_map<string, Node>& graph,
+        RouteType routeType = FASTEST) {
+        
+        return formatRouteWithRealDirections(path, graph, routeType, getPathRouteDetails(path, graph, routeType));
+    }
+
+    string formatRouteWithRealDirections(
+        const vector<string>& path,
+        const unordered_map<string, Node>& graph,
+        RouteType routeType,
+        const vector<vector<string>>& segmentDetails) {
+        
+        if (path.empty()) return "No route available";
+        static const vector<string> noRoads;
+        
+        string result;
+        double totalDistance = 0;
+        double totalTime = 0;
+        double tollCost = 0;
+        string currency = "IDR";
+        vector<TollInfo> tolls;
+        
+        try {
+            if (path.size() == 2 && path[0] == "start" && path[1] == "end") {
+                const auto& startNode = graph.at(path[0]);
+                const auto& endNode = graph.at(path[1]);
+                const vector<string>& routeSteps = segmentDetails.empty() ? noRoads : segmentDetails[0];
+                result = Location::extractCityName(startNode.location.name);
+                
+                for (const auto& step : routeSteps) {
+                    result += " → " + step;
+                }
+                
+                result += " → " + Location::extractCityName(endNode.location.name);
+                totalDistance = RouteUtils::getAccurateDistance(startNode.location, endNode.location);
+                
+                if (routeType != AVOID_TOLLS) {
+                    tolls = getTollInfo(startNode.location, endNode.location, routeType, tollCost, currency);
+                }
+            } else {
+                for (size_t i = 0; i < path.size() - 1; i++) {
+                    const auto& currentNode = graph.at(path[i]);
+                    const auto& nextNode = graph.at(path[i+1]);
+                    
+                    double segmentDistance = 0;
+                    for (const auto& edge : currentNode.edges) {
+                        if (edge.first == path[i+1]) {
+                            segmentDistance = edge.second;
+                            break;
+                        }
+                    }
+                    
+                    if (i == 0) {
+                        result += currentNode.location.name;
+                    }
+                    
+                    const vector<string>& roadNames = i < segmentDetails.size() ? segmentDetails[i] : noRoads;
+                    for (const auto& road : roadNames) {
+                        result += " → " + road;
+                    }
+                    
+                    if (i == path.size() - 2) {
+                        result += " → " + nextNode.location.name;
+                    }
+                    
+                    totalDistance += segmentDistance;
+                }
+                
+                if (routeType != AVOID_TOLLS && path.size() >= 2) {
+                    const auto& startNode = graph.at(path.front());
+                    const auto& endNode = graph.at(path.back());
+                    tolls = getTollInfo(startNode.location, endNode.location, routeType, tollCost, currency);
+                }
+            }
+            
+            double speed = 60.0;
+            switch (routeType) {
+                case FASTEST: speed = 60.0; break;
+                case SHORTEST: speed = 50.0; break;
+                case AVOID_TOLLS: speed = 45.0; break;
+                case SCENIC: speed = 40.0; break;
+            }
+            totalTime = (totalDistance / speed) * 60;
+            
+            int hours = static_cast<int>(totalTime) / 60;
+            int minutes = static_cast<int>(totalTime) % 60;
+            
+            result += " (" + to_string(static_cast<int>(totalDistance)) + " km, ";
+            if (hours > 0) {
+                result += to_string(hours) + " hr ";
+            }
+            result += to_string(minutes) + " min)";
+            
+            if (!tolls.empty()) {
+                result += "\nTotal Toll Cost: " + RouteUtils::formatCurrency(tollCost, currency);
+                result += "\nToll Details:";
+                for (const auto& toll : tolls) {
+                    result += "\n  - " + toll.name + " (" + toll.operator_name + "): " + 
+                           RouteUtils::formatCurrency(toll.cost, toll.currency);
+                }
+            } else if (routeType != AVOID_TOLLS) {
+                result += "\nNo toll information available for this route.";
+            } else {
+                result += "\nThis route avoids all toll roads.";
+            }
+        } catch (const exception& e) {
+            cerr << "Error in formatRouteWithRealDirections: " << e.what() << endl;
+            return "Error generating route details";
+        }
+        
+        return RouteUtils::cleanRouteSymbols(result);
+    }
+};
+
+class RoutePlanner {
+private:
+    // Geocoder geocoder;
+    // RouteFinder routeFinder;
+    Geocoder geocoder;
+    RouteFinder routeFinder;
+    RouteUtils::LocationManager locationManager;
+    // Kept in step with locationManager so searches never rebuild it
+    LocationSearchIndex savedSearch;
+    RouteUtils::RouteManager routeManager;
+    unordered_map<string, Node> currentGraph;
+    BatchGeocoder batchGeocoder{geocoder};
+    
+    // Upstream budgets for one interactive request; past them the user gets the local
+    // answer instead of a longer wait
+    static constexpr chrono::milliseconds LOOKUP_BUDGET{6000};
+    static constexpr chrono::milliseconds DIRECTIONS_BUDGET{8000};
+
+public:
+    RoutePlanner() {
+        for (const string& name : locationManager.getAllLocationNames()) {
+            savedSearch.add(name, 1.0);
+        }
+        savedSearch.finalize();
+    }
+
+    void setHeuristicMode(HeuristicMode mode) {
+        routeFinder.setHeuristicMode(mode);
+    }
+
+    void setRoutingBackendMode(RoutingBackendMode mode) {
+        routeFinder.setRoutingBackendMode(mode);
+    }
+
+    // Where this session's road names came from and what they cost
+    void printRoutingCosts() {
+        cout << "\n===== Routing Backend Costs =====" << endl;
+        cout << fixed << setprecision(2);
+        for (const auto& entry : routeFinder.backendStats()) {
+            const RoutingBackend::Stats& stats = entry.second;
+            cout << left << setw(8) << entry.first << stats.legsAnswered << "/" << stats.legsRequested
+                 << " legs answered, " << stats.upstreamRequests << " upstream requests, "
+                 << stats.totalMs << " ms" << endl;
+        }
+        cout << defaultfloat;
+    }
+
+    // void planRoute() {
+    //     cout << "===== Maps Pathfinder Application =====" << endl;
+        
+    //     while (true) {
+    //         try {
+    //             string startLocationName, endLocationName;
+                
+    //             cout << "Enter your current location: ";
+    //             getline(cin, startLocationName);
+                
+    //             cout << "Enter your destination: ";
+    //             getline(cin, endLocationName);
+                
+    //             if (startLocationName.empty() || endLocationName.empty()) {
+    //                 cout << "Error: Location names cannot be empty. Please try again." << endl;
+    //                 continue;
+    //             }
+                
+    //             cout << "\nSearching for locations..." << endl;
+                
+    //             Location startLocation = geocoder.geocodeLocation(startLocationName);
+    //             Location endLocation = geocoder.geocodeLocation(endLocationName);
+                
+    //             if (startLocation.name.empty() || endLocation.name.empty()) {
+    //                 cout << "Error: Could not find one or both locations. Please try again with more specific names." << endl;
+    //                 continue;
+    //             }
+                
+    //             cout << "Start: " << startLocation.name << endl;
+    //             cout << "End: " << endLocation.name << endl;
+                
+    //             double directDistance = RouteUtils::getAccurateDistance(startLocation, endLocation);
+    //             cout << "\nDirect distance: " << directDistance << " km" << endl;
+                
+    //             bool exit = false;
+    //             while (!exit) {
+    //                 cout << "\n===== Route Options =====" << endl;
+    //                 cout << "1. Fastest Route (Default)" << endl;
+    //                 cout << "2. Shortest Route" << endl;
+    //                 cout << "3. Avoid Tolls" << endl;
+    //                 cout << "4. Scenic Route" << endl;
+    //                 cout << "0. Enter New Locations" << endl;
+    //                 cout << "9. Exit Program" << endl;
+    //                 cout << "\nSelect an option: ";
+                    
+    //                 int choice;
+    //                 try {
+    //                     string input;
+    //                     getline(cin, input);
+    //                     choice = stoi(input);
+    //                 } catch (const exception&) {
+    //                     cout << "Invalid input. Please enter a number." << endl;
+    //                     continue;
+    //                 }
+                    
+    //                 RouteType routeType;
+    //                 switch (choice) {
+    //                     case 1: routeType = FASTEST; cout << "\nCalculating fastest route..." << endl; break;
+    //                     case 2: routeType = SHORTEST; cout << "\nCalculating shortest route..." << endl; break;
+    //                     case 3: routeType = AVOID_TOLLS; cout << "\nCalculating route avoiding tolls..." << endl; break;
+    //                     case 4: routeType = SCENIC; cout << "\nCalculating scenic route..." << endl; break;
+    //                     case 0: exit = true; continue;
+    //                     case 9: cout << "Exiting program. Thank you for using Maps Pathfinder!" << endl; return;
+    //                     default: cout << "Invalid option. Using Fastest Route." << endl; routeType = FASTEST; break;
+    //                 }
+                    
+    //                 try {
+    //                     unordered_map<string, Node> graph;
+    //                     string startId = "start";
+    //                     string endId = "end";
+                        
+    //                     graph[startId] = Node(startId, startLocation);
+    //                     graph[endId] = Node(endId, endLocation);
+    //                     graph[startId].edges.push_back(make_pair(endId, directDistance));
+                        
+    //                     vector<vector<string>> routes = routeFinder.generateMultipleRoutes(
+    //                         graph, startId, endId, startLocation, endLocation, routeType);
+                        
+    //                     if (routes.empty()) {
     //                         cout << "No routes found between the locations. Please try different locations." << endl;
     //                         continue;
     //                     }
@@ -1822,1003 +5826,3069 @@ public:
     //             cout << "Please try again." << endl;
     //         }
             
-    //         cout << "\nPress Enter to continue or type 'exit' to quit: ";
-    //         string input;
-    //         getline(cin, input);
-    //         if (input == "exit") {
-    //             cout << "Exiting program. Thank you for using Maps Pathfinder!" << endl;
-    //             break;
-    //         }
-    //     }
-    // }
+    //         cout << "\nPress Enter to continue or type 'exit' to quit: ";
+    //         string input;
+    //         getline(cin, input);
+    //         if (input == "exit") {
+    //             cout << "Exiting program. Thank you for using Maps Pathfinder!" << endl;
+    //             break;
+    //         }
+    //     }
+    // }
+
+    void planRoute() {
+    cout << "===== Maps Pathfinder Application =====" << endl;
+    
+    while (true) {
+        try {
+            cout << "\n===== Main Menu =====" << endl;
+            cout << "1. Plan a New Route" << endl;
+            cout << "2. Manage Saved Locations" << endl;
+            cout << "3. Manage Saved Routes" << endl;
+            cout << "4. View Current Graph Visualization" << endl;
+            cout << "9. Exit Program" << endl;
+            cout << "\nSelect an option: ";
+            
+            string input;
+            getline(cin, input);
+            int choice;
+            
+            try {
+                choice = stoi(input);
+            } catch (const exception&) {
+                cout << "Invalid input. Please enter a number." << endl;
+                continue;
+            }
+            
+            switch (choice) {
+                case 1:
+                    planNewRoute();
+                    break;
+                case 2:
+                    manageLocations();
+                    break;
+                case 3:
+                    manageRoutes();
+                    break;
+                case 4:
+                    visualizeCurrentGraph();
+                    break;
+                case 9:
+                    cout << "Exiting program. Thank you for using Maps Pathfinder!" << endl;
+                    return;
+                default:
+                    cout << "Invalid option. Please try again." << endl;
+                    break;
+            }
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            cout << "Please try again." << endl;
+        }
+    }
+}
+
+// Ranked matches over saved locations and known gazetteer places; saved ones win ties
+vector<pair<string, bool>> searchLocations(const string& query, size_t limit) {
+    vector<pair<double, pair<string, bool>>> ranked;
+    unordered_set<string> seen;
+    for (const auto& match : savedSearch.search(query, limit)) {
+        seen.insert(match.name);
+        ranked.push_back(make_pair(match.score + 0.25, make_pair(match.name, true)));
+    }
+    for (const auto& match : geocoder.searchPlaces(query, limit)) {
+        if (seen.insert(match.name).second) {
+            ranked.push_back(make_pair(match.score, make_pair(match.name, false)));
+        }
+    }
+    stable_sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    
+    vector<pair<string, bool>> results;
+    for (size_t i = 0; i < ranked.size() && i < limit; i++) {
+        results.push_back(ranked[i].second);
+    }
+    return results;
+}
+
+// Saved-location edits go through these so savedSearch stays current
+bool saveLocation(const string& name, double lat, double lon) {
+    if (!locationManager.addLocation(name, lat, lon)) return false;
+    savedSearch.insert(name, 1.0);
+    return true;
+}
+
+bool removeLocation(const string& name) {
+    if (!locationManager.deleteLocation(name)) return false;
+    savedSearch.remove(name);
+    return true;
+}
+
+// A number picks from the saved list, any other text searches; falls back to typing a name
+string chooseLocation(const vector<string>& locations, const string& label, const string& manualPrompt) {
+    cout << "\nSelect " << label << " (number), type part of a name to search, or 0 to enter manually: ";
+    string input;
+    getline(cin, input);
+    
+    bool numeric = !input.empty() && all_of(input.begin(), input.end(), [](unsigned char c) { return isdigit(c); });
+    if (numeric) {
+        int index = -1;
+        try {
+            index = stoi(input) - 1;
+        } catch (const exception&) {
+            index = -1;
+        }
+        if (index >= 0 && index < static_cast<int>(locations.size())) {
+            return locations[index];
+        }
+    } else if (!input.empty()) {
+        vector<pair<string, bool>> matches = searchLocations(input, 5);
+        if (matches.empty()) {
+            cout << "No matching locations found." << endl;
+        } else {
+            cout << "Matches:" << endl;
+            for (size_t i = 0; i < matches.size(); i++) {
+                cout << (i+1) << ". " << matches[i].first << (matches[i].second ? " (saved)" : " (known place)") << endl;
+            }
+            cout << "Select match (number) or 0 to enter manually: ";
+            string choice;
+            getline(cin, choice);
+            int index = -1;
+            try {
+                index = stoi(choice) - 1;
+            } catch (const exception&) {
+                index = -1;
+            }
+            if (index >= 0 && index < static_cast<int>(matches.size())) {
+                return matches[index].first;
+            }
+        }
+    }
+    
+    cout << manualPrompt;
+    string name;
+    getline(cin, name);
+    return name;
+}
+
+void planNewRoute() {
+    string startLocationName, endLocationName;
+    
+    // Check if user wants to use saved location
+    cout << "\nDo you want to use a saved location? (y/n): ";
+    string useSaved;
+    getline(cin, useSaved);
+    
+    if (useSaved == "y" || useSaved == "Y") {
+        vector<string> locations = locationManager.getAllLocationNames();
+        sort(locations.begin(), locations.end());
+        if (locations.empty()) {
+            cout << "No saved locations found. Please enter location names manually." << endl;
+            cout << "Enter your current location: ";
+            getline(cin, startLocationName);
+            
+            cout << "Enter your destination: ";
+            getline(cin, endLocationName);
+        } else {
+            cout << "\nSaved locations:" << endl;
+            for (size_t i = 0; i < locations.size(); i++) {
+                cout << (i+1) << ". " << locations[i] << endl;
+            }
+            
+            startLocationName = chooseLocation(locations, "start location", "Enter your current location: ");
+            endLocationName = chooseLocation(locations, "destination location", "Enter your destination: ");
+        }
+    } else {
+        cout << "Enter your current location: ";
+        getline(cin, startLocationName);
+        
+        cout << "Enter your destination: ";
+        getline(cin, endLocationName);
+    }
+    
+    if (startLocationName.empty() || endLocationName.empty()) {
+        cout << "Error: Location names cannot be empty. Please try again." << endl;
+        return;
+    }
+    
+    cout << "\nSearching for locations..." << endl;
+    
+    // Check if these are saved locations first. Both ends resolve concurrently; when they
+    // name the same place the geocoder coalesces them into one request.
+    Deadline lookupDeadline = Deadline::after(LOOKUP_BUDGET);
+    auto resolveLocation = [this, lookupDeadline](const string& name) {
+        Location saved = locationManager.getLocation(name);
+        return saved.name.empty() ? geocoder.geocodeLocation(name, lookupDeadline) : saved;
+    };
+    future<Location> pendingEnd = async(launch::async, resolveLocation, endLocationName);
+    Location startLocation = resolveLocation(startLocationName);
+    Location endLocation = pendingEnd.get();
+    
+    if (startLocation.name.empty() || endLocation.name.empty()) {
+        cout << "Error: Could not find one or both locations. Please try again with more specific names." << endl;
+        return;
+    }
+    
+    cout << "Start: " << startLocation.name << endl;
+    cout << "End: " << endLocation.name << endl;
+    
+    double directDistance = RouteUtils::getAccurateDistance(startLocation, endLocation);
+    cout << "\nDirect distance: " << directDistance << " km" << endl;
+    
+    // Ask if user wants to save these locations
+    cout << "\nDo you want to save these locations for future use? (y/n): ";
+    string saveLocations;
+    getline(cin, saveLocations);
+    
+    if (saveLocations == "y" || saveLocations == "Y") {
+        // Save start location if not already saved
+        if (locationManager.getLocation(startLocation.name).name.empty()) {
+            cout << "Saving " << startLocation.name << " to your locations..." << endl;
+            saveLocation(startLocation.name, startLocation.lat, startLocation.lon);
+        }
+        
+        // Save end location if not already saved
+        if (locationManager.getLocation(endLocation.name).name.empty()) {
+            cout << "Saving " << endLocation.name << " to your locations..." << endl;
+            saveLocation(endLocation.name, endLocation.lat, endLocation.lon);
+        }
+    }
+    
+    // Continue with route planning
+    processRouteOptions(startLocation, endLocation, directDistance);
+}
+
+void processRouteOptions(const Location& startLocation, const Location& endLocation, double directDistance) {
+    bool exit = false;
+    while (!exit) {
+        cout << "\n===== Route Options =====" << endl;
+        cout << "1. Fastest Route (Default)" << endl;
+        cout << "2. Shortest Route" << endl;
+        cout << "3. Avoid Tolls" << endl;
+        cout << "4. Scenic Route" << endl;
+        cout << "0. Return to Main Menu" << endl;
+        cout << "\nSelect an option: ";
+        
+        int choice;
+        try {
+            string input;
+            getline(cin, input);
+            choice = stoi(input);
+        } catch (const exception&) {
+            cout << "Invalid input. Please enter a number." << endl;
+            continue;
+        }
+        
+        if (choice == 0) {
+            exit = true;
+            continue;
+        }
+        
+        RouteType routeType;
+        switch (choice) {
+            case 1: routeType = FASTEST; cout << "\nCalculating fastest route..." << endl; break;
+            case 2: routeType = SHORTEST; cout << "\nCalculating shortest route..." << endl; break;
+            case 3: routeType = AVOID_TOLLS; cout << "\nCalculating route avoiding tolls..." << endl; break;
+            case 4: routeType = SCENIC; cout << "\nCalculating scenic route..." << endl; break;
+            default: cout << "Invalid option. Using Fastest Route." << endl; routeType = FASTEST; break;
+        }
+        
+         generateAndDisplayRoutes(startLocation, endLocation, directDistance, routeType);
+    }
+}
+
+// Full directions for one route once its road names are known
+void displayRouteDirections(
+    size_t index,
+    const vector<string>& route,
+    const vector<vector<string>>& segmentDetails,
+    RouteType routeType) {
+    
+    cout << "\n--- Route " << (index + 1) << " directions ---" << endl;
+    string formattedRoute = RouteUtils::cleanRouteSymbols(
+        routeFinder.formatRoute(route, currentGraph, routeType, segmentDetails));
+    cout << formattedRoute << endl;
+    
+    cout << "Step-by-step directions:" << endl;
+    
+    for (size_t j = 0; j < route.size() - 1; j++) {
+        const auto& currentNode = currentGraph[route[j]];
+        const auto& nextNode = currentGraph[route[j+1]];
+        
+        double segmentDistance = 0;
+        for (const auto& edge : currentNode.edges) {
+            if (edge.first == route[j+1]) {
+                segmentDistance = edge.second;
+                break;
+            }
+        }
+        
+        string stepDescription = "  " + to_string(j+1) + ". " + currentNode.location.name;
+        if (j < segmentDetails.size()) {
+            for (const auto& road : segmentDetails[j]) {
+                stepDescription += " → " + road;
+            }
+        }
+        stepDescription += " → " + nextNode.location.name;
+        
+        double speed = 60.0;
+        switch (routeType) {
+            case FASTEST: speed = 60.0; break;
+            case SHORTEST: speed = 50.0; break;
+            case AVOID_TOLLS: speed = 45.0; break;
+            case SCENIC: speed = 40.0; break;
+        }
+        double time = (segmentDistance / speed) * 60;
+        stepDescription += " (" + to_string(static_cast<int>(segmentDistance)) + 
+                        " km, " + to_string(static_cast<int>(time)) + " min)";
+        
+        cout << RouteUtils::cleanRouteSymbols(stepDescription) << endl;
+    }
+    
+    string detailedRoute = routeFinder.formatRouteWithRealDirections(
+        route, currentGraph, routeType, segmentDetails);
+    cout << "\nFormatted Route: " << RouteUtils::cleanRouteSymbols(detailedRoute) << endl;
+    
+    // Display path visualization
+    cout << RouteUtils::GraphVisualizer::visualizePathInGraph(currentGraph, route) << endl;
+}
+
+void generateAndDisplayRoutes(
+    const Location& startLocation, 
+    const Location& endLocation, 
+    double directDistance,
+    RouteType routeType) {
+    
+    try {
+        cout << "\n===== Available Routes between " 
+            << Location::extractCityName(startLocation.name) << " and " 
+            << Location::extractCityName(endLocation.name) << " =====" << endl;
+        
+        // Each route is listed the moment its search finishes; its road names resolve in the
+        // background and the full directions follow in whatever order they complete
+        Deadline directionsDeadline = Deadline::after(DIRECTIONS_BUDGET);
+        vector<vector<string>> listed;
+        vector<vector<string>> routes = routeFinder.planRoutesProgressive(
+            currentGraph, startLocation, endLocation, directDistance, routeType, directionsDeadline, BACKEND_DEFAULT,
+            [&](size_t index, const vector<string>& route) {
+                listed.push_back(route);
+                cout << "Route " << (index + 1) << ": "
+                     << (index == 0 ? "Recommended Route" : "Alternative Route " + to_string(index)) << endl;
+                cout << "  " << routeFinder.formatRouteSummary(route, currentGraph, routeType) << endl;
+                return true;
+            },
+            [&](size_t index, const vector<vector<string>>& segmentDetails) {
+                displayRouteDirections(index, listed[index], segmentDetails, routeType);
+            });
+        
+        if (routes.empty()) {
+            cout << "No routes found between the locations. Please try different locations." << endl;
+            return;
+        }
+        
+        // Ask if user wants to save this route
+        cout << "\nDo you want to save one of these routes for future use? (y/n): ";
+        string saveRoute;
+        getline(cin, saveRoute);
+        
+        if (saveRoute == "y" || saveRoute == "Y") {
+            cout << "Which route do you want to save? (1-" << routes.size() << "): ";
+            int routeIdx = 0;
+            try {
+                string input;
+                getline(cin, input);
+                routeIdx = stoi(input) - 1;
+            } catch (...) {
+                routeIdx = -1;
+            }
+            
+            if (routeIdx >= 0 && routeIdx < routes.size()) {
+                cout << "Enter a name for this route: ";
+                string routeName;
+                getline(cin, routeName);
+                
+                if (!routeName.empty()) {
+                    routeManager.addRoute(
+                        routeName,
+                        startLocation.name,
+                        endLocation.name,
+                        routeType,
+                        routes[routeIdx]
+                    );
+                    cout << "Route saved as '" << routeName << "'." << endl;
+                }
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Error calculating route: " << e.what() << endl;
+        cout << "Please try again with different locations." << endl;
+    }
+}
+
+void manageLocations() {
+    bool exit = false;
+    while (!exit) {
+        collectImportedLocations();
+        cout << "\n===== Location Management =====" << endl;
+        locationManager.displayAllLocations();
+        
+        cout << "\n1. Add New Location" << endl;
+        cout << "2. Update Existing Location" << endl;
+        cout << "3. Delete Location" << endl;
+        cout << "4. Import Locations from File" << endl;
+        cout << "5. Show Import Progress" << endl;
+        cout << "6. Identify Coordinates" << endl;
+        cout << "0. Return to Main Menu" << endl;
+        cout << "\nSelect an option: ";
+        
+        int choice;
+        try {
+            string input;
+            getline(cin, input);
+            choice = stoi(input);
+        } catch (const exception&) {
+            cout << "Invalid input. Please enter a number." << endl;
+            continue;
+        }
+        
+        switch (choice) {
+            case 0:
+                exit = true;
+                break;
+            case 1:
+                addNewLocation();
+                break;
+            case 2:
+                updateLocation();
+                break;
+            case 3:
+                deleteLocation();
+                break;
+            case 4:
+                importLocations();
+                break;
+            case 5:
+                showImportProgress();
+                break;
+            case 6:
+                identifyCoordinates();
+                break;
+            default:
+                cout << "Invalid option. Please try again." << endl;
+                break;
+        }
+    }
+}
+
+// Names a coordinate pair from the offline gazetteer and admin areas
+void identifyCoordinates() {
+    double lat, lon;
+    cout << "\n===== Identify Coordinates =====" << endl;
+    try {
+        string input;
+        cout << "Enter latitude: ";
+        getline(cin, input);
+        lat = stod(input);
+        cout << "Enter longitude: ";
+        getline(cin, input);
+        lon = stod(input);
+    } catch (const exception&) {
+        cout << "Error: Invalid coordinates." << endl;
+        return;
+    }
+    
+    ReverseGeocoder::Result result = geocoder.reverseGeocode(lat, lon);
+    if (!result.found()) {
+        cout << "No known place near these coordinates." << endl;
+        return;
+    }
+    cout << "Location: " << result.label() << endl;
+    if (!result.place.empty()) {
+        stringstream distance;
+        distance << fixed << setprecision(2) << result.distance;
+        cout << "Nearest place: " << result.place << " (" << distance.str() << " km)" << endl;
+    }
+}
+
+// Starts a background batch geocode of a file with one place name per line
+void importLocations() {
+    if (batchGeocoder.isRunning()) {
+        cout << "An import is already running. Check its progress with option 5." << endl;
+        return;
+    }
+    
+    cout << "\n===== Import Locations =====" << endl;
+    cout << "Enter file with one location name per line: ";
+    string filename;
+    getline(cin, filename);
+    
+    string content = RouteUtils::FileIO::loadFromFile(filename);
+    if (content.empty()) {
+        cout << "Error: Could not read " << filename << "." << endl;
+        return;
+    }
+    
+    vector<string> names;
+    stringstream contentStream(content);
+    string line;
+    while (getline(contentStream, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) names.push_back(line);
+    }
+    
+    string resultsFile = filename + ".geocoded.csv";
+    if (batchGeocoder.start(names, resultsFile)) {
+        cout << "Importing " << names.size() << " names in the background. Results are written to "
+             << resultsFile << " as they arrive." << endl;
+    } else {
+        cout << "Error: Could not start import." << endl;
+    }
+}
+
+void showImportProgress() {
+    collectImportedLocations();
+    BatchGeocoder::Progress progress = batchGeocoder.progress();
+    if (progress.total == 0) {
+        cout << "No import has been started." << endl;
+        return;
+    }
+    
+    cout << "\nImport progress: " << (progress.completed + progress.failed) << "/" << progress.total
+         << " (" << progress.fromCache << " offline, " << progress.failed << " not found)"
+         << (progress.finished ? " - finished" : " - running") << endl;
+    
+    vector<string> failures = batchGeocoder.takeFailures();
+    const size_t shown = 10;
+    for (size_t i = 0; i < failures.size() && i < shown; i++) {
+        cout << "  Failed: " << failures[i] << endl;
+    }
+    if (failures.size() > shown) {
+        cout << "  ... and " << failures.size() - shown << " more" << endl;
+    }
+}
+
+// Moves finished import results into the saved locations (main thread only)
+void collectImportedLocations() {
+    vector<Location> imported = batchGeocoder.takeCompleted();
+    if (!imported.empty()) {
+        size_t added = locationManager.addLocations(imported);
+        for (const Location& location : imported) savedSearch.insert(location.name, 1.0);
+        if (added > 0) {
+            cout << "Imported " << added << " new location(s)." << endl;
+        }
+    }
+}
+
+void addNewLocation() {
+    string name;
+    double lat, lon;
+    
+    cout << "\n===== Add New Location =====" << endl;
+    cout << "Enter location name: ";
+    getline(cin, name);
+    
+    if (name.empty()) {
+        cout << "Error: Name cannot be empty." << endl;
+        return;
+    }
+    
+    cout << "Do you want to use geocoding to find coordinates? (y/n): ";
+    string useGeocoding;
+    getline(cin, useGeocoding);
+    
+    if (useGeocoding == "y" || useGeocoding == "Y") {
+        cout << "Geocoding location..." << endl;
+        Location location = geocoder.geocodeLocation(name);
+        
+        if (location.name.empty()) {
+            cout << "Error: Could not geocode location. Please enter coordinates manually." << endl;
+        } else {
+            name = location.name;
+            lat = location.lat;
+            lon = location.lon;
+            cout << "Found: " << name << " at coordinates (" << lat << ", " << lon << ")" << endl;
+            
+            // Save the location
+            if (saveLocation(name, lat, lon)) {
+                cout << "Location added successfully." << endl;
+            } else {
+                cout << "Error: Location with this name already exists." << endl;
+            }
+            return;
+        }
+    }
+    
+    // Manual coordinate entry
+    cout << "Enter latitude: ";
+    try {
+        string input;
+        getline(cin, input);
+        lat = stod(input);
+    } catch (const exception&) {
+        cout << "Invalid latitude. Please enter a valid number." << endl;
+        return;
+    }
+    
+    cout << "Enter longitude: ";
+    try {
+        string input;
+        getline(cin, input);
+        lon = stod(input);
+    } catch (const exception&) {
+        cout << "Invalid longitude. Please enter a valid number." << endl;
+        return;
+    }
+    
+    if (saveLocation(name, lat, lon)) {
+        cout << "Location added successfully." << endl;
+    } else {
+        cout << "Error: Location with this name already exists." << endl;
+    }
+}
+
+void updateLocation() {
+    vector<string> locationNames = locationManager.getAllLocationNames();
+    if (locationNames.empty()) {
+        cout << "No locations to update." << endl;
+        return;
+    }
+    
+    cout << "\n===== Update Location =====" << endl;
+    cout << "Select location to update:" << endl;
+    
+    for (size_t i = 0; i < locationNames.size(); i++) {
+        cout << (i+1) << ". " << locationNames[i] << endl;
+    }
+    
+    cout << "\nEnter number (0 to cancel): ";
+    int idx;
+    try {
+        string input;
+        getline(cin, input);
+        idx = stoi(input) - 1;
+    } catch (const exception&) {
+        idx = -1;
+    }
+    
+    if (idx < 0 || idx >= locationNames.size()) {
+        cout << "Operation cancelled or invalid selection." << endl;
+        return;
+    }
+    
+    string name = locationNames[idx];
+    Location currentLocation = locationManager.getLocation(name);
+    
+    cout << "\nUpdating location: " << name << endl;
+    cout << "Current coordinates: (" << currentLocation.lat << ", " << currentLocation.lon << ")" << endl;
+    
+    cout << "Enter new latitude (or leave empty to keep current): ";
+    string latInput;
+    getline(cin, latInput);
+    double lat = currentLocation.lat;
+    if (!latInput.empty()) {
+        try {
+            lat = stod(latInput);
+        } catch (const exception&) {
+            cout << "Invalid latitude. Keeping current value." << endl;
+        }
+    }
+    
+    cout << "Enter new longitude (or leave empty to keep current): ";
+    string lonInput;
+    getline(cin, lonInput);
+    double lon = currentLocation.lon;
+    if (!lonInput.empty()) {
+        try {
+            lon = stod(lonInput);
+        } catch (const exception&) {
+            cout << "Invalid longitude. Keeping current value." << endl;
+        }
+    }
+    
+    if (locationManager.updateLocation(name, lat, lon)) {
+        cout << "Location updated successfully." << endl;
+    } else {
+        cout << "Error updating location." << endl;
+    }
+}
 
-    void planRoute() {
-    cout << "===== Maps Pathfinder Application =====" << endl;
+void deleteLocation() {
+    vector<string> locationNames = locationManager.getAllLocationNames();
+    if (locationNames.empty()) {
+        cout << "No locations to delete." << endl;
+        return;
+    }
     
-    while (true) {
+    cout << "\n===== Delete Location =====" << endl;
+    cout << "Select location to delete:" << endl;
+    
+    for (size_t i = 0; i < locationNames.size(); i++) {
+        cout << (i+1) << ". " << locationNames[i] << endl;
+    }
+    
+    cout << "\nEnter number (0 to cancel): ";
+    int idx;
+    try {
+        string input;
+        getline(cin, input);
+        idx = stoi(input) - 1;
+    } catch (const exception&) {
+        idx = -1;
+    }
+    
+    if (idx < 0 || idx >= locationNames.size()) {
+        cout << "Operation cancelled or invalid selection." << endl;
+        return;
+    }
+    
+    string name = locationNames[idx];
+    cout << "Are you sure you want to delete " << name << "? (y/n): ";
+    string confirm;
+    getline(cin, confirm);
+    
+    if (confirm == "y" || confirm == "Y") {
+        if (removeLocation(name)) {
+            cout << "Location deleted successfully." << endl;
+        } else {
+            cout << "Error deleting location." << endl;
+        }
+    } else {
+        cout << "Deletion cancelled." << endl;
+    }
+}
+
+void manageRoutes() {
+    bool exit = false;
+    while (!exit) {
+        cout << "\n===== Route Management =====" << endl;
+        routeManager.displayAllRoutes();
+        
+        cout << "\n1. View Saved Route" << endl;
+        cout << "2. Delete Route" << endl;
+        cout << "0. Return to Main Menu" << endl;
+        cout << "\nSelect an option: ";
+        
+        int choice;
         try {
-            cout << "\n===== Main Menu =====" << endl;
-            cout << "1. Plan a New Route" << endl;
-            cout << "2. Manage Saved Locations" << endl;
-            cout << "3. Manage Saved Routes" << endl;
-            cout << "4. View Current Graph Visualization" << endl;
-            cout << "9. Exit Program" << endl;
-            cout << "\nSelect an option: ";
-            
             string input;
             getline(cin, input);
-            int choice;
-            
-            try {
-                choice = stoi(input);
-            } catch (const exception&) {
-                cout << "Invalid input. Please enter a number." << endl;
-                continue;
-            }
-            
-            switch (choice) {
-                case 1:
-                    planNewRoute();
-                    break;
-                case 2:
-                    manageLocations();
-                    break;
-                case 3:
-                    manageRoutes();
-                    break;
-                case 4:
-                    visualizeCurrentGraph();
-                    break;
-                case 9:
-                    cout << "Exiting program. Thank you for using Maps Pathfinder!" << endl;
-                    return;
-                default:
-                    cout << "Invalid option. Please try again." << endl;
-                    break;
-            }
-        } catch (const exception& e) {
-            cerr << "Error: " << e.what() << endl;
-            cout << "Please try again." << endl;
+            choice = stoi(input);
+        } catch (const exception&) {
+            cout << "Invalid input. Please enter a number." << endl;
+            continue;
+        }
+        
+        switch (choice) {
+            case 0:
+                exit = true;
+                break;
+            case 1:
+                viewSavedRoute();
+                break;
+            case 2:
+                deleteSavedRoute();
+                break;
+            default:
+                cout << "Invalid option. Please try again." << endl;
+                break;
         }
     }
 }
 
-void planNewRoute() {
-    string startLocationName, endLocationName;
+void viewSavedRoute() {
+    vector<string> routeNames = routeManager.getAllRouteNames();
+    if (routeNames.empty()) {
+        cout << "No saved routes." << endl;
+        return;
+    }
     
-    // Check if user wants to use saved location
-    cout << "\nDo you want to use a saved location? (y/n): ";
-    string useSaved;
-    getline(cin, useSaved);
+    cout << "\n===== View Saved Route =====" << endl;
+    cout << "Select route to view:" << endl;
     
-    if (useSaved == "y" || useSaved == "Y") {
-        vector<string> locations = locationManager.getAllLocationNames();
-        if (locations.empty()) {
-            cout << "No saved locations found. Please enter location names manually." << endl;
-        } else {
-            cout << "\nSaved locations:" << endl;
-            for (size_t i = 0; i < locations.size(); i++) {
-                cout << (i+1) << ". " << locations[i] << endl;
-            }
-            
-            // Get start location
-            cout << "\nSelect start location (number) or 0 to enter manually: ";
-            int startIdx = -1;
-            try {
-                string input;
-                getline(cin, input);
-                startIdx = stoi(input) - 1;
-            } catch (const exception&) {
-                startIdx = -1;
-            }
-            
-            if (startIdx >= 0 && startIdx < locations.size()) {
-                startLocationName = locations[startIdx];
-            } else {
-                cout << "Enter your current location: ";
-                getline(cin, startLocationName);
-            }
-            
-            // Get end location
-            cout << "\nSelect destination location (number) or 0 to enter manually: ";
-            int endIdx = -1;
-            try {
-                string input;
-                getline(cin, input);
-                endIdx = stoi(input) - 1;
-            } catch (const exception&) {
-                endIdx = -1;
-            }
-            
-            if (endIdx >= 0 && endIdx < locations.size()) {
-                endLocationName = locations[endIdx];
-            } else {
-                cout << "Enter your destination: ";
-                getline(cin, endLocationName);
-            }
-        }
-    } else {
-        cout << "Enter your current location: ";
-        getline(cin, startLocationName);
-        
-        cout << "Enter your destination: ";
-        getline(cin, endLocationName);
+    for (size_t i = 0; i < routeNames.size(); i++) {
+        cout << (i+1) << ". " << routeNames[i] << endl;
     }
     
-    if (startLocationName.empty() || endLocationName.empty()) {
-        cout << "Error: Location names cannot be empty. Please try again." << endl;
+    cout << "\nEnter number (0 to cancel): ";
+    int idx;
+    try {
+        string input;
+        getline(cin, input);
+        idx = stoi(input) - 1;
+    } catch (const exception&) {
+        idx = -1;
+    }
+    
+    if (idx < 0 || idx >= routeNames.size()) {
+        cout << "Operation cancelled or invalid selection." << endl;
         return;
     }
     
-    cout << "\nSearching for locations..." << endl;
+    string name = routeNames[idx];
+    auto route = routeManager.getRoute(name);
+    
+    cout << "\n===== Route: " << name << " =====" << endl;
+    cout << "From: " << route.startLocationName << endl;
+    cout << "To: " << route.endLocationName << endl;
     
-    // Check if these are saved locations first
-    Location startLocation = locationManager.getLocation(startLocationName);
-    if (startLocation.name.empty()) {
-        startLocation = geocoder.geocodeLocation(startLocationName);
+    string routeType;
+    switch (route.routeType) {
+        case FASTEST: routeType = "Fastest"; break;
+        case SHORTEST: routeType = "Shortest"; break;
+        case AVOID_TOLLS: routeType = "Avoid Tolls"; break;
+        case SCENIC: routeType = "Scenic"; break;
+    }
+    cout << "Route type: " << routeType << endl;
+    
+    // Get the actual locations
+    Location startLoc = locationManager.getLocation(route.startLocationName);
+    if (startLoc.name.empty()) {
+        startLoc = geocoder.geocodeLocation(route.startLocationName);
+    }
+    
+    Location endLoc = locationManager.getLocation(route.endLocationName);
+    if (endLoc.name.empty()) {
+        endLoc = geocoder.geocodeLocation(route.endLocationName);
+    }
+    
+    if (!startLoc.name.empty() && !endLoc.name.empty()) {
+        cout << "\nDo you want to recalculate this route? (y/n): ";
+        string recalc;
+        getline(cin, recalc);
+        
+        if (recalc == "y" || recalc == "Y") {
+            double directDistance = RouteUtils::getAccurateDistance(startLoc, endLoc);
+            generateAndDisplayRoutes(startLoc, endLoc, directDistance, route.routeType);
+        }
+    }
+}
+
+void deleteSavedRoute() {
+    vector<string> routeNames = routeManager.getAllRouteNames();
+    if (routeNames.empty()) {
+        cout << "No saved routes." << endl;
+        return;
+    }
+    
+    cout << "\n===== Delete Saved Route =====" << endl;
+    cout << "Select route to delete:" << endl;
+    
+    for (size_t i = 0; i < routeNames.size(); i++) {
+        cout << (i+1) << ". " << routeNames[i] << endl;
+    }
+    
+    cout << "\nEnter number (0 to cancel): ";
+    int idx;
+    try {
+        string input;
+        getline(cin, input);
+        idx = stoi(input) - 1;
+    } catch (const exception&) {
+        idx = -1;
+    }
+    
+    if (idx < 0 || idx >= routeNames.size()) {
+        cout << "Operation cancelled or invalid selection." << endl;
+        return;
     }
     
-    Location endLocation = locationManager.getLocation(endLocationName);
-    if (endLocation.name.empty()) {
-        endLocation = geocoder.geocodeLocation(endLocationName);
+    string name = routeNames[idx];
+    cout << "Are you sure you want to delete route '" << name << "'? (y/n): ";
+    string confirm;
+    getline(cin, confirm);
+    
+    if (confirm == "y" || confirm == "Y") {
+        if (routeManager.deleteRoute(name)) {
+            cout << "Route deleted successfully." << endl;
+        } else {
+            cout << "Error deleting route." << endl;
+        }
+    } else {
+        cout << "Deletion cancelled." << endl;
     }
-    
-    if (startLocation.name.empty() || endLocation.name.empty()) {
-        cout << "Error: Could not find one or both locations. Please try again with more specific names." << endl;
+}
+void visualizeCurrentGraph() {
+    if (currentGraph.empty()) {
+        cout << "\nNo graph available for visualization. Please plan a route first." << endl;
         return;
     }
     
-    cout << "Start: " << startLocation.name << endl;
-    cout << "End: " << endLocation.name << endl;
-    
-    double directDistance = RouteUtils::getAccurateDistance(startLocation, endLocation);
-    cout << "\nDirect distance: " << directDistance << " km" << endl;
-    
-    // Ask if user wants to save these locations
-    cout << "\nDo you want to save these locations for future use? (y/n): ";
-    string saveLocations;
-    getline(cin, saveLocations);
+    cout << "\n===== Graph Visualization =====" << endl;
+    cout << RouteUtils::GraphVisualizer::visualizeGraph(currentGraph) << endl;
     
-    if (saveLocations == "y" || saveLocations == "Y") {
-        // Save start location if not already saved
-        if (locationManager.getLocation(startLocation.name).name.empty()) {
-            cout << "Saving " << startLocation.name << " to your locations..." << endl;
-            locationManager.addLocation(startLocation.name, startLocation.lat, startLocation.lon);
-        }
-        
-        // Save end location if not already saved
-        if (locationManager.getLocation(endLocation.name).name.empty()) {
-            cout << "Saving " << endLocation.name << " to your locations..." << endl;
-            locationManager.addLocation(endLocation.name, endLocation.lat, endLocation.lon);
-        }
-    }
+    // Option to save visualization
+    cout << "Do you want to save this graph visualization to a file? (y/n): ";
+    string saveGraph;
+    getline(cin, saveGraph);
     
-    // Continue with route planning
-    processRouteOptions(startLocation, endLocation, directDistance);
-}
-
-void processRouteOptions(const Location& startLocation, const Location& endLocation, double directDistance) {
-    bool exit = false;
-    while (!exit) {
-        cout << "\n===== Route Options =====" << endl;
-        cout << "1. Fastest Route (Default)" << endl;
-        cout << "2. Shortest Route" << endl;
-        cout << "3. Avoid Tolls" << endl;
-        cout << "4. Scenic Route" << endl;
-        cout << "0. Return to Main Menu" << endl;
-        cout << "\nSelect an option: ";
+    if (saveGraph == "y" || saveGraph == "Y") {
+        // Get current timestamp for filename
+        time_t now = time(0);
+        tm* ltm = localtime(&now);
+        stringstream timestamp;
+        timestamp << 1900 + ltm->tm_year << "-" 
+                  << setw(2) << setfill('0') << 1 + ltm->tm_mon << "-"
+                  << setw(2) << setfill('0') << ltm->tm_mday << "_"
+                  << setw(2) << setfill('0') << ltm->tm_hour 
+                  << setw(2) << setfill('0') << ltm->tm_min;
         
-        int choice;
-        try {
-            string input;
-            getline(cin, input);
-            choice = stoi(input);
-        } catch (const exception&) {
-            cout << "Invalid input. Please enter a number." << endl;
-            continue;
-        }
+        string defaultFilename = "graph_visualization_" + timestamp.str() + ".txt";
+        cout << "Enter filename (default: " << defaultFilename << "): ";
+        string filename;
+        getline(cin, filename);
         
-        if (choice == 0) {
-            exit = true;
-            continue;
+        if (filename.empty()) {
+            filename = defaultFilename;
         }
         
-        RouteType routeType;
-        switch (choice) {
-            case 1: routeType = FASTEST; cout << "\nCalculating fastest route..." << endl; break;
-            case 2: routeType = SHORTEST; cout << "\nCalculating shortest route..." << endl; break;
-            case 3: routeType = AVOID_TOLLS; cout << "\nCalculating route avoiding tolls..." << endl; break;
-            case 4: routeType = SCENIC; cout << "\nCalculating scenic route..." << endl; break;
-            default: cout << "Invalid option. Using Fastest Route." << endl; routeType = FASTEST; break;
+        if (filename.find(".txt") == string::npos) {
+            filename += ".txt";
         }
         
-         generateAndDisplayRoutes(startLocation, endLocation, directDistance, routeType);
+        RouteUtils::GraphVisualizer::saveGraphVisualization(currentGraph, filename);
+        cout << "Graph visualization saved to " << filename << endl;
     }
 }
 
-void generateAndDisplayRoutes(
-    const Location& startLocation, 
-    const Location& endLocation, 
-    double directDistance,
-    RouteType routeType) {
+
+// void generateAndDisplayRoutes(
+//     const Location& startLocation, 
+//     const Location& endLocation, 
+//     double directDistance,
+//     RouteType routeType) {
     
-    try {
-        currentGraph.clear();
-        string startId = "start";
-        string endId = "end";
+//     try {
+//         currentGraph.clear();
+//         string startId = "start";
+//         string endId = "end";
         
-        currentGraph[startId] = Node(startId, startLocation);
-        currentGraph[endId] = Node(endId, endLocation);
-        currentGraph[startId].edges.push_back(make_pair(endId, directDistance));
+//         currentGraph[startId] = Node(startId, startLocation);
+//         currentGraph[endId] = Node(endId, endLocation);
+//         currentGraph[startId].edges.push_back(make_pair(endId, directDistance));
         
-        vector<vector<string>> routes = routeFinder.generateMultipleRoutes(
-            currentGraph, startId, endId, startLocation, endLocation, routeType);
+//         vector<vector<string>> routes = routeFinder.generateMultipleRoutes(
+//             currentGraph, startId, endId, startLocation, endLocation, routeType);
         
-        if (routes.empty()) {
-            cout << "No routes found between the locations. Please try different locations." << endl;
-            return;
-        }
+//         if (routes.empty()) {
+//             cout << "No routes found between the locations. Please try different locations." << endl;
+//             return;
+//         }
         
-        cout << "\n===== Available Routes between " 
-            << Location::extractCityName(startLocation.name) << " and " 
-            << Location::extractCityName(endLocation.name) << " =====" << endl;
+//         cout << "\n===== Available Routes between " 
+//             << Location::extractCityName(startLocation.name) << " and " 
+//             << Location::extractCityName(endLocation.name) << " =====" << endl;
         
-        vector<string> routeDescriptions;
+//         vector<string> routeDescriptions;
+//         vector<string> detailedRoutes;
         
-        for (size_t i = 0; i < routes.size(); i++) {
-            const auto& route = routes[i];
-            cout << "Route " << (i+1) << ": ";
+//         for (size_t i = 0; i < routes.size(); i++) {
+//             const auto& route = routes[i];
+//             cout << "Route " << (i+1) << ": ";
             
-            if (i == 0) {
-                cout << "Recommended Route" << endl;
-            } else {
-                cout << "Alternative Route " << i << endl;
-            }
+//             if (i == 0) {
+//                 cout << "Recommended Route" << endl;
+//             } else {
+//                 cout << "Alternative Route " << i << endl;
+//             }
             
-            string formattedRoute = RouteUtils::cleanRouteSymbols(routeFinder.formatRoute(route, currentGraph, routeType));
-            cout << formattedRoute << endl;
-            routeDescriptions.push_back(formattedRoute);
+//             string formattedRoute = RouteUtils::cleanRouteSymbols(routeFinder.formatRoute(route, currentGraph, routeType));
+//             cout << formattedRoute << endl;
+//             routeDescriptions.push_back(formattedRoute);
             
-            cout << "Step-by-step directions:" << endl;
+//             cout << "Step-by-step directions:" << endl;
             
-            for (size_t j = 0; j < route.size() - 1; j++) {
-                const auto& currentNode = currentGraph[route[j]];
-                const auto& nextNode = currentGraph[route[j+1]];
+//             stringstream stepDetails;
+//             for (size_t j = 0; j < route.size() - 1; j++) {
+//                 const auto& currentNode = currentGraph[route[j]];
+//                 const auto& nextNode = currentGraph[route[j+1]];
                 
-                double segmentDistance = 0;
-                for (const auto& edge : currentNode.edges) {
-                    if (edge.first == route[j+1]) {
-                        segmentDistance = edge.second;
-                        break;
-                    }
-                }
+//                 double segmentDistance = 0;
+//                 for (const auto& edge : currentNode.edges) {
+//                     if (edge.first == route[j+1]) {
+//                         segmentDistance = edge.second;
+//                         break;
+//                     }
+//                 }
                 
-                vector<string> segmentRoads = routeFinder.getRouteDetails(
-                    currentNode.location, 
-                    nextNode.location, 
-                    routeType
-                );
+//                 vector<string> segmentRoads = routeFinder.getRouteDetails(
+//                     currentNode.location, 
+//                     nextNode.location, 
+//                     routeType
+//                 );
                 
-                string stepDescription = "  " + to_string(j+1) + ". " + currentNode.location.name;
-                for (const auto& road : segmentRoads) {
-                    stepDescription += " → " + road;
-                }
-                stepDescription += " → " + nextNode.location.name;
+//                 string stepDescription = "  " + to_string(j+1) + ". " + currentNode.location.name;
+//                 for (const auto& road : segmentRoads) {
+//                     stepDescription += " → " + road;
+//                 }
+//                 stepDescription += " → " + nextNode.location.name;
                 
-                double speed = 60.0;
-                switch (routeType) {
-                    case FASTEST: speed = 60.0; break;
-                    case SHORTEST: speed = 50.0; break;
-                    case AVOID_TOLLS: speed = 45.0; break;
-                    case SCENIC: speed = 40.0; break;
-                }
-                double time = (segmentDistance / speed) * 60;
-                stepDescription += " (" + to_string(static_cast<int>(segmentDistance)) + 
-                                " km, " + to_string(static_cast<int>(time)) + " min)";
+//                 double speed = 60.0;
+//                 switch (routeType) {
+//                     case FASTEST: speed = 60.0; break;
+//                     case SHORTEST: speed = 50.0; break;
+//                     case AVOID_TOLLS: speed = 45.0; break;
+//                     case SCENIC: speed = 40.0; break;
+//                 }
+//                 double time = (segmentDistance / speed) * 60;
+//                 stepDescription += " (" + to_string(static_cast<int>(segmentDistance)) + 
+//                                 " km, " + to_string(static_cast<int>(time)) + " min)";
                 
-                cout << RouteUtils::cleanRouteSymbols(stepDescription) << endl;
-            }
+//                 cout << RouteUtils::cleanRouteSymbols(stepDescription) << endl;
+//                 stepDetails << RouteUtils::cleanRouteSymbols(stepDescription) << "\n";
+//             }
             
-            string detailedRoute = routeFinder.formatRouteWithRealDirections(
-                route, currentGraph, routeType);
-            cout << "\nFormatted Route: " << RouteUtils::cleanRouteSymbols(detailedRoute) << endl;
+//             string detailedRoute = routeFinder.formatRouteWithRealDirections(
+//                 route, currentGraph, routeType);
+//             cout << "\nFormatted Route: " << RouteUtils::cleanRouteSymbols(detailedRoute) << endl;
+//             detailedRoutes.push_back("Route " + to_string(i+1) + 
+//                 (i == 0 ? " (Recommended Route):\n" : " (Alternative Route):\n") +
+//                 RouteUtils::cleanRouteSymbols(detailedRoute) + 
+//                 "\n\nStep-by-step directions:\n" + stepDetails.str());
             
-            // Display path visualization
-            cout << RouteUtils::GraphVisualizer::visualizePathInGraph(currentGraph, route) << endl;
-        }
+//             // Display path visualization
+//             cout << RouteUtils::GraphVisualizer::visualizePathInGraph(currentGraph, route) << endl;
+//         }
         
-        // Ask if user wants to save this route
-        cout << "\nDo you want to save one of these routes for future use? (y/n): ";
-        string saveRoute;
-        getline(cin, saveRoute);
+//         // Option to export route information to text file
+//         cout << "\n===== Export Options =====" << endl;
+//         cout << "1. Save route information to text file" << endl;
+//         cout << "2. Save graph visualization to text file" << endl; 
+//         cout << "3. Save both route and graph visualization" << endl;
+//         cout << "0. Continue without saving" << endl;
+//         cout << "Select an option: ";
         
-        if (saveRoute == "y" || saveRoute == "Y") {
-            cout << "Which route do you want to save? (1-" << routes.size() << "): ";
-            int routeIdx = 0;
-            try {
-                string input;
-                getline(cin, input);
-                routeIdx = stoi(input) - 1;
-            } catch (...) {
-                routeIdx = -1;
-            }
-            
-            if (routeIdx >= 0 && routeIdx < routes.size()) {
-                cout << "Enter a name for this route: ";
-                string routeName;
-                getline(cin, routeName);
-                
-                if (!routeName.empty()) {
-                    routeManager.addRoute(
-                        routeName,
-                        startLocation.name,
-                        endLocation.name,
-                        routeType,
-                        routes[routeIdx]
-                    );
-                    cout << "Route saved as '" << routeName << "'." << endl;
-                }
-            }
-        }
-    } catch (const exception& e) {
-        cerr << "Error calculating route: " << e.what() << endl;
-        cout << "Please try again with different locations." << endl;
-    }
-}
-
-void manageLocations() {
-    bool exit = false;
-    while (!exit) {
-        cout << "\n===== Location Management =====" << endl;
-        locationManager.displayAllLocations();
+//         int exportChoice;
+//         try {
+//             string input;
+//             getline(cin, input);
+//             exportChoice = stoi(input);
+//         } catch (...) {
+//             exportChoice = 0;
+//         }
         
-        cout << "\n1. Add New Location" << endl;
-        cout << "2. Update Existing Location" << endl;
-        cout << "3. Delete Location" << endl;
-        cout << "0. Return to Main Menu" << endl;
-        cout << "\nSelect an option: ";
+//         if (exportChoice == 1 || exportChoice == 3) {
+//             exportRouteToFile(startLocation.name, endLocation.name, detailedRoutes);
+//         }
         
-        int choice;
-        try {
-            string input;
-            getline(cin, input);
-            choice = stoi(input);
-        } catch (const exception&) {
-            cout << "Invalid input. Please enter a number." << endl;
-            continue;
-        }
+//         if (exportChoice == 2 || exportChoice == 3) {
+//             cout << "Enter filename for graph visualization (default: graph_visualization.txt): ";
+//             string filename;
+//             getline(cin, filename);
+            
+//             if (filename.empty()) {
+//                 filename = "graph_visualization.txt";
+//             }
+            
+//             if (filename.find(".txt") == string::npos) {
+//                 filename += ".txt";
+//             }
+            
+//             RouteUtils::GraphVisualizer::saveGraphVisualization(currentGraph, filename);
+//             cout << "Graph visualization saved to " << filename << endl;
+//         }
         
-        switch (choice) {
-            case 0:
-                exit = true;
-                break;
-            case 1:
-                addNewLocation();
-                break;
-            case 2:
-                updateLocation();
-                break;
-            case 3:
-                deleteLocation();
-                break;
-            default:
-                cout << "Invalid option. Please try again." << endl;
-                break;
-        }
-    }
-}
+//         // Ask if user wants to save this route
+//         cout << "\nDo you want to save one of these routes for future use? (y/n): ";
+//         string saveRoute;
+//         getline(cin, saveRoute);
+        
+//         if (saveRoute == "y" || saveRoute == "Y") {
+//             cout << "Which route do you want to save? (1-" << routes.size() << "): ";
+//             int routeIdx = 0;
+//             try {
+//                 string input;
+//                 getline(cin, input);
+//                 routeIdx = stoi(input) - 1;
+//             } catch (...) {
+//                 routeIdx = -1;
+//             }
+            
+//             if (routeIdx >= 0 && routeIdx < routes.size()) {
+//                 cout << "Enter a name for this route: ";
+//                 string routeName;
+//                 getline(cin, routeName);
+                
+//                 if (!routeName.empty()) {
+//                     routeManager.addRoute(
+//                         routeName,
+//                         startLocation.name,
+//                         endLocation.name,
+//                         routeType,
+//                         routes[routeIdx]
+//                     );
+//                     cout << "Route saved as '" << routeName << "'." << endl;
+//                 }
+//             }
+//         }
+//     } catch (const exception& e) {
+//         cerr << "Error calculating route: " << e.what() << endl;
+//         cout << "Please try again with different locations." << endl;
+//     }
+// }
 
-void addNewLocation() {
-    string name;
-    double lat, lon;
-    
-    cout << "\n===== Add New Location =====" << endl;
-    cout << "Enter location name: ";
-    getline(cin, name);
+void exportRouteToFile(const string& startLocation, const string& endLocation, 
+                      const vector<string>& detailedRoutes) {
+    // Get current timestamp for filename
+    time_t now = time(0);
+    tm* ltm = localtime(&now);
+    stringstream timestamp;
+    timestamp << 1900 + ltm->tm_year << "-" 
+              << setw(2) << setfill('0') << 1 + ltm->tm_mon << "-"
+              << setw(2) << setfill('0') << ltm->tm_mday << "_"
+              << setw(2) << setfill('0') << ltm->tm_hour 
+              << setw(2) << setfill('0') << ltm->tm_min;
     
-    if (name.empty()) {
-        cout << "Error: Name cannot be empty." << endl;
-        return;
-    }
+    string defaultFilename = "route_" + 
+        Location::extractCityName(startLocation) + "_to_" + 
+        Location::extractCityName(endLocation) + "_" + 
+        timestamp.str() + ".txt";
     
-    cout << "Do you want to use geocoding to find coordinates? (y/n): ";
-    string useGeocoding;
-    getline(cin, useGeocoding);
+    cout << "Enter filename for route information (default: " << defaultFilename << "): ";
+    string filename;
+    getline(cin, filename);
     
-    if (useGeocoding == "y" || useGeocoding == "Y") {
-        cout << "Geocoding location..." << endl;
-        Location location = geocoder.geocodeLocation(name);
-        
-        if (location.name.empty()) {
-            cout << "Error: Could not geocode location. Please enter coordinates manually." << endl;
-        } else {
-            name = location.name;
-            lat = location.lat;
-            lon = location.lon;
-            cout << "Found: " << name << " at coordinates (" << lat << ", " << lon << ")" << endl;
-            
-            // Save the location
-            if (locationManager.addLocation(name, lat, lon)) {
-                cout << "Location added successfully." << endl;
-            } else {
-                cout << "Error: Location with this name already exists." << endl;
-            }
-            return;
-        }
+    if (filename.empty()) {
+        filename = defaultFilename;
     }
     
-    // Manual coordinate entry
-    cout << "Enter latitude: ";
-    try {
-        string input;
-        getline(cin, input);
-        lat = stod(input);
-    } catch (const exception&) {
-        cout << "Invalid latitude. Please enter a valid number." << endl;
-        return;
+    if (filename.find(".txt") == string::npos) {
+        filename += ".txt";
     }
     
-    cout << "Enter longitude: ";
-    try {
-        string input;
-        getline(cin, input);
-        lon = stod(input);
-    } catch (const exception&) {
-        cout << "Invalid longitude. Please enter a valid number." << endl;
-        return;
+    stringstream content;
+    content << "===== Route from " << startLocation << " to " << endLocation << " =====" << endl;
+    content << "Generated on: " << put_time(ltm, "%Y-%m-%d %H:%M:%S") << endl << endl;
+    
+    for (const auto& route : detailedRoutes) {
+        content << route << endl;
+        content << "---------------------------------------------------" << endl;
     }
     
-    if (locationManager.addLocation(name, lat, lon)) {
-        cout << "Location added successfully." << endl;
+    if (RouteUtils::FileIO::saveToFile(filename, content.str())) {
+        cout << "Route information saved to " << filename << endl;
     } else {
-        cout << "Error: Location with this name already exists." << endl;
+        cout << "Error: Could not save route information to file." << endl;
     }
 }
 
-void updateLocation() {
-    vector<string> locationNames = locationManager.getAllLocationNames();
-    if (locationNames.empty()) {
-        cout << "No locations to update." << endl;
-        return;
-    }
-    
-    cout << "\n===== Update Location =====" << endl;
-    cout << "Select location to update:" << endl;
-    
-    for (size_t i = 0; i < locationNames.size(); i++) {
-        cout << (i+1) << ". " << locationNames[i] << endl;
-    }
-    
-    cout << "\nEnter number (0 to cancel): ";
-    int idx;
-    try {
-        string input;
-        getline(cin, input);
-        idx = stoi(input) - 1;
-    } catch (const exception&) {
-        idx = -1;
-    }
-    
-    if (idx < 0 || idx >= locationNames.size()) {
-        cout << "Operation cancelled or invalid selection." << endl;
-        return;
-    }
-    
-    string name = locationNames[idx];
-    Location currentLocation = locationManager.getLocation(name);
-    
-    cout << "\nUpdating location: " << name << endl;
-    cout << "Current coordinates: (" << currentLocation.lat << ", " << currentLocation.lon << ")" << endl;
-    
-    cout << "Enter new latitude (or leave empty to keep current): ";
-    string latInput;
-    getline(cin, latInput);
-    double lat = currentLocation.lat;
-    if (!latInput.empty()) {
-        try {
-            lat = stod(latInput);
-        } catch (const exception&) {
-            cout << "Invalid latitude. Keeping current value." << endl;
+};
+
+// int main() {
+//     try {
+//         RoutePlanner planner;
+//         planner.planRoute();
+//     } catch (const exception& e) {
+//         cerr << "Fatal error: " << e.what() << endl;
+//         cout << "The program will now exit." << endl;
+//         return 1;
+//     }
+//     return 0;
+// }
+
+
+// Admission in front of routing work: at most `slots` requests plan at once and the rest
+// wait in a bounded queue per priority class. A request is turned away up front when its
+// class queue is full or its deadline cannot cover the expected wait plus a typical service
+// time, and leaves the queue as soon as waiting longer could not finish in time, so
+// overload surfaces as quick rejections instead of ever-growing latency for everyone.
+// Batch work never holds the last quarter of the slots, so an interactive request finds
+// one free soon; when both classes wait, interactive gets INTERACTIVE_WEIGHT grants for
+// every batch grant, so neither starves.
+class AdmissionControl {
+public:
+    enum Priority { INTERACTIVE, BATCH };
+    static const size_t INTERACTIVE_WEIGHT = 3;
+
+    struct Stats {
+        size_t slots = 0;
+        size_t active[2] = {0, 0};
+        size_t queued[2] = {0, 0};
+        size_t admitted[2] = {0, 0};
+        size_t shed[2] = {0, 0};
+        double serviceMs = 0;
+    };
+
+    // Holds one slot until destroyed; empty (false) when the request was shed
+    class Ticket {
+    public:
+        Ticket() = default;
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+        Ticket(Ticket&& other) noexcept
+            : owner(other.owner), priority(other.priority), started(other.started) {
+            other.owner = nullptr;
+        }
+        Ticket& operator=(Ticket&& other) noexcept {
+            if (this != &other) {
+                if (owner) owner->release(priority, started);
+                owner = other.owner;
+                priority = other.priority;
+                started = other.started;
+                other.owner = nullptr;
+            }
+            return *this;
+        }
+        ~Ticket() {
+            if (owner) owner->release(priority, started);
+        }
+
+        explicit operator bool() const { return owner != nullptr; }
+
+    private:
+        friend class AdmissionControl;
+        AdmissionControl* owner = nullptr;
+        Priority priority = INTERACTIVE;
+        chrono::steady_clock::time_point started;
+    };
+
+    AdmissionControl(size_t slotCount, size_t maxQueuedInteractive, size_t maxQueuedBatch)
+        : slots(max<size_t>(1, slotCount)),
+          batchSlots(slots > 1 ? slots - max<size_t>(1, slots / 4) : 1),
+          maxQueued{maxQueuedInteractive, maxQueuedBatch} {}
+
+    // Waits for a slot until deadline; an unset deadline waits as long as the queue takes
+    Ticket admit(Priority priority, Deadline deadline) {
+        unique_lock<mutex> lock(admissionMutex);
+        if (waiting[priority].empty() && hasRoom(priority)) {
+            return grant(priority);
+        }
+        if (waiting[priority].size() >= maxQueued[priority] ||
+            (deadline.isSet() && deadline.remaining() < expectedWait(priority) + serviceTime())) {
+            shed[priority]++;
+            return Ticket();
+        }
+        
+        Waiter waiter;
+        if (waiting[INTERACTIVE].empty() && waiting[BATCH].empty()) {
+            lastHandoff = chrono::steady_clock::now();
         }
+        waiting[priority].push_back(&waiter);
+        if (!deadline.isSet()) {
+            waiter.wake.wait(lock, [&waiter]() { return waiter.granted; });
+            return claim(priority);
+        }
+        // Once a typical service time no longer fits, a slot would come too late to help
+        auto giveUpAt = deadline.at() - serviceTime();
+        while (!waiter.granted) {
+            if (waiter.wake.wait_until(lock, giveUpAt) == cv_status::timeout && !waiter.granted) {
+                waiting[priority].erase(find(waiting[priority].begin(), waiting[priority].end(), &waiter));
+                shed[priority]++;
+                return Ticket();
+            }
+        }
+        return claim(priority);
     }
-    
-    cout << "Enter new longitude (or leave empty to keep current): ";
-    string lonInput;
-    getline(cin, lonInput);
-    double lon = currentLocation.lon;
-    if (!lonInput.empty()) {
-        try {
-            lon = stod(lonInput);
-        } catch (const exception&) {
-            cout << "Invalid longitude. Keeping current value." << endl;
+
+    Stats stats() {
+        lock_guard<mutex> lock(admissionMutex);
+        Stats snapshot;
+        snapshot.slots = slots;
+        snapshot.serviceMs = serviceUs / 1000;
+        for (int p = INTERACTIVE; p <= BATCH; p++) {
+            snapshot.active[p] = active[p];
+            snapshot.queued[p] = waiting[p].size();
+            snapshot.admitted[p] = admitted[p];
+            snapshot.shed[p] = shed[p];
         }
+        return snapshot;
     }
-    
-    if (locationManager.updateLocation(name, lat, lon)) {
-        cout << "Location updated successfully." << endl;
-    } else {
-        cout << "Error updating location." << endl;
+
+private:
+    struct Waiter {
+        condition_variable wake;
+        bool granted = false;
+    };
+
+    size_t slots;
+    size_t batchSlots;
+    size_t maxQueued[2];
+    size_t active[2] = {0, 0};
+    deque<Waiter*> waiting[2];
+    size_t interactiveStreak = 0;
+    // Moving averages of how long a slot is held and, while requests wait, how often one
+    // is handed on; the latter is the real drain rate, CPU contention included
+    double serviceUs = 0;
+    double handoffUs = 0;
+    chrono::steady_clock::time_point lastHandoff;
+    size_t admitted[2] = {0, 0};
+    size_t shed[2] = {0, 0};
+    mutex admissionMutex;
+
+    // Caller holds admissionMutex for all of the helpers below
+    bool hasRoom(Priority priority) const {
+        return active[INTERACTIVE] + active[BATCH] < slots && (priority == INTERACTIVE || active[BATCH] < batchSlots);
     }
-}
 
-void deleteLocation() {
-    vector<string> locationNames = locationManager.getAllLocationNames();
-    if (locationNames.empty()) {
-        cout << "No locations to delete." << endl;
-        return;
+    Ticket grant(Priority priority) {
+        active[priority]++;
+        return claim(priority);
     }
-    
-    cout << "\n===== Delete Location =====" << endl;
-    cout << "Select location to delete:" << endl;
-    
-    for (size_t i = 0; i < locationNames.size(); i++) {
-        cout << (i+1) << ". " << locationNames[i] << endl;
+
+    // The slot itself was already counted by whoever granted it
+    Ticket claim(Priority priority) {
+        admitted[priority]++;
+        Ticket ticket;
+        ticket.owner = this;
+        ticket.priority = priority;
+        ticket.started = chrono::steady_clock::now();
+        return ticket;
     }
-    
-    cout << "\nEnter number (0 to cancel): ";
-    int idx;
-    try {
-        string input;
-        getline(cin, input);
-        idx = stoi(input) - 1;
-    } catch (const exception&) {
-        idx = -1;
+
+    chrono::microseconds serviceTime() const {
+        return chrono::microseconds(llround(serviceUs));
     }
-    
-    if (idx < 0 || idx >= locationNames.size()) {
-        cout << "Operation cancelled or invalid selection." << endl;
-        return;
+
+    // The queue ahead of a new arrival, drained at this class's share of the handoffs
+    chrono::microseconds expectedWait(Priority priority) const {
+        double share = 1.0;
+        if (!waiting[priority == INTERACTIVE ? BATCH : INTERACTIVE].empty()) {
+            share = priority == INTERACTIVE ? INTERACTIVE_WEIGHT / (INTERACTIVE_WEIGHT + 1.0)
+                                            : 1.0 / (INTERACTIVE_WEIGHT + 1.0);
+        }
+        double perHandoffUs = handoffUs > 0 ? handoffUs : serviceUs / slots;
+        return chrono::microseconds(llround((waiting[priority].size() + 1) * perHandoffUs / share));
     }
-    
-    string name = locationNames[idx];
-    cout << "Are you sure you want to delete " << name << "? (y/n): ";
-    string confirm;
-    getline(cin, confirm);
-    
-    if (confirm == "y" || confirm == "Y") {
-        if (locationManager.deleteLocation(name)) {
-            cout << "Location deleted successfully." << endl;
-        } else {
-            cout << "Error deleting location." << endl;
+
+    // Hands the freed slot straight to the next waiter that may use it, so a new arrival
+    // cannot overtake the queue
+    void release(Priority priority, chrono::steady_clock::time_point started) {
+        auto now = chrono::steady_clock::now();
+        double heldUs = chrono::duration<double, micro>(now - started).count();
+        lock_guard<mutex> lock(admissionMutex);
+        serviceUs = serviceUs == 0 ? heldUs : serviceUs * 0.9 + heldUs * 0.1;
+        active[priority]--;
+        
+        bool interactive = !waiting[INTERACTIVE].empty() && hasRoom(INTERACTIVE);
+        bool batch = !waiting[BATCH].empty() && hasRoom(BATCH);
+        if (!interactive && !batch) return;
+        
+        double sinceUs = chrono::duration<double, micro>(now - lastHandoff).count();
+        handoffUs = handoffUs == 0 ? sinceUs : handoffUs * 0.9 + sinceUs * 0.1;
+        lastHandoff = now;
+        
+        Priority next = interactive && (!batch || interactiveStreak < INTERACTIVE_WEIGHT) ? INTERACTIVE : BATCH;
+        interactiveStreak = next == INTERACTIVE ? interactiveStreak + 1 : 0;
+        active[next]++;
+        Waiter* waiter = waiting[next].front();
+        waiting[next].pop_front();
+        waiter->granted = true;
+        waiter->wake.notify_one();
+    }
+};
+
+// Appends JSON straight to a string so responses never pass through a DOM. Only tracks
+// whether a comma is due; callers nest the begin/end calls themselves.
+class JsonWriter {
+public:
+    JsonWriter& beginObject() { separate(); out += '{'; needComma = false; return *this; }
+    JsonWriter& endObject() { out += '}'; needComma = true; return *this; }
+    JsonWriter& beginArray() { separate(); out += '['; needComma = false; return *this; }
+    JsonWriter& endArray() { out += ']'; needComma = true; return *this; }
+
+    JsonWriter& key(const string& name) {
+        separate();
+        appendString(name);
+        out += ':';
+        needComma = false;
+        return *this;
+    }
+
+    JsonWriter& value(const string& text) { separate(); appendString(text); needComma = true; return *this; }
+    JsonWriter& value(const char* text) { return value(string(text)); }
+    JsonWriter& boolean(bool flag) { separate(); out += flag ? "true" : "false"; needComma = true; return *this; }
+    JsonWriter& null() { separate(); out += "null"; needComma = true; return *this; }
+    JsonWriter& integer(long long number) { separate(); out += to_string(number); needComma = true; return *this; }
+    // Already serialized JSON, e.g. a client-supplied id echoed back
+    JsonWriter& raw(const string& json) { separate(); out += json; needComma = true; return *this; }
+
+    // Fixed decimals with trailing zeros dropped; NaN and infinities become null
+    JsonWriter& number(double number, int decimals = 6) {
+        if (!isfinite(number)) return null();
+        separate();
+        char buffer[64];
+        int length = snprintf(buffer, sizeof(buffer), "%.*f", decimals, number);
+        if (decimals > 0) {
+            while (length > 1 && buffer[length - 1] == '0') length--;
+            if (buffer[length - 1] == '.') length--;
         }
-    } else {
-        cout << "Deletion cancelled." << endl;
+        out.append(buffer, length);
+        needComma = true;
+        return *this;
     }
-}
 
-void manageRoutes() {
-    bool exit = false;
-    while (!exit) {
-        cout << "\n===== Route Management =====" << endl;
-        routeManager.displayAllRoutes();
-        
-        cout << "\n1. View Saved Route" << endl;
-        cout << "2. Delete Route" << endl;
-        cout << "0. Return to Main Menu" << endl;
-        cout << "\nSelect an option: ";
-        
-        int choice;
-        try {
-            string input;
-            getline(cin, input);
-            choice = stoi(input);
-        } catch (const exception&) {
-            cout << "Invalid input. Please enter a number." << endl;
-            continue;
+    const string& str() const { return out; }
+    string take() { return move(out); }
+
+private:
+    string out;
+    bool needComma = false;
+
+    void separate() {
+        if (needComma) out += ',';
+    }
+
+    void appendString(const string& text) {
+        out += '"';
+        for (unsigned char c : text) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (c < 0x20) {
+                        char escaped[8];
+                        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        out += escaped;
+                    } else {
+                        out += static_cast<char>(c);
+                    }
+            }
+        }
+        out += '"';
+    }
+};
+
+// JSON API over the planner's routing and geocoding. Every handler thread shares one
+// RouteFinder and one Geocoder (read-only tables, internally locked memos) and reads saved
+// locations from an immutable snapshot, so requests never wait on each other for routing
+// data. Rendered routes are cached per graph version; /reload swaps the snapshot and
+// starts a new version.
+class RoutingServer {
+public:
+    class Options {
+    public:
+        string host = "0.0.0.0";
+        int port = 8080;
+        // A keep-alive connection holds its handler thread, so size for concurrent clients
+        size_t threads = max<size_t>(32, 4 * thread::hardware_concurrency());
+        size_t keepAliveRequests = 1000;
+        int keepAliveSeconds = 30;
+        size_t maxMatrixLocations = 100;
+        size_t batchThreads = max<size_t>(1, thread::hardware_concurrency());
+        // Rendered /route and batch results; 0 entries disables the cache
+        size_t routeCacheEntries = 10000;
+        int routeCacheSeconds = 600;
+        // Concurrent route computations and the queues in front of them (see AdmissionControl)
+        size_t routingSlots = max<size_t>(4, 2 * thread::hardware_concurrency());
+        size_t maxQueuedInteractive = 64;
+        size_t maxQueuedBatch = 1024;
+        // Accepted connections waiting for a handler thread; beyond this they are closed
+        size_t maxPendingConnections = 1024;
+        // Road-name lookups of all requests share these; one per handler thread means a few
+        // slow upstream legs cannot queue everyone else's lookups behind them
+        size_t detailThreads = max<size_t>(32, 4 * thread::hardware_concurrency());
+    };
+
+    // Upstream budget for one API request (or one batch query)
+    static constexpr chrono::milliseconds REQUEST_BUDGET{5000};
+    static const size_t BATCH_WINDOW_PER_THREAD = 4;
+    // "lat,lon" endpoints snap to this grid (about 11 m) so nearby fixes share cached routes
+    static constexpr double COORDINATE_SNAP_DEGREES = 1e-4;
+    // Cache lifetime of routes whose road names fell back to local synthesis
+    static const int FALLBACK_CACHE_SECONDS = 10;
+    // /matrix pairs closer than this are the same place and get 0 without a search
+    static constexpr double COINCIDENT_KM = 0.001;
+
+    RoutingServer(const Options& opts, HeuristicMode heuristicMode, RoutingBackendMode backendMode)
+        : options(opts), routeFinder(opts.detailThreads), routeCache(opts.routeCacheEntries),
+          admission(opts.routingSlots, opts.maxQueuedInteractive, opts.maxQueuedBatch) {
+        routeFinder.setHeuristicMode(heuristicMode);
+        routeFinder.setRoutingBackendMode(backendMode);
+        saved = loadSavedLocations();
+        
+        size_t threads = max<size_t>(1, options.threads);
+        size_t pending = options.maxPendingConnections;
+        server.new_task_queue = [threads, pending]() { return new httplib::ThreadPool(threads, pending); };
+        server.set_keep_alive_max_count(options.keepAliveRequests);
+        server.set_keep_alive_timeout(options.keepAliveSeconds);
+        
+        server.Get("/route", [this](const httplib::Request& req, httplib::Response& res) { handleRoute(req, res); });
+        server.Get("/route/events", [this](const httplib::Request& req, httplib::Response& res) { handleRouteEvents(req, res); });
+        server.Get("/geocode", [this](const httplib::Request& req, httplib::Response& res) { handleGeocode(req, res); });
+        server.Get("/matrix", [this](const httplib::Request& req, httplib::Response& res) { handleMatrix(req, res); });
+        server.Get("/locations", [this](const httplib::Request& req, httplib::Response& res) { handleLocations(req, res); });
+        server.Post("/batch", [this](const httplib::Request& req, httplib::Response& res) { handleBatch(req, res); });
+        server.Post("/reload", [this](const httplib::Request& req, httplib::Response& res) { handleReload(req, res); });
+        server.Get("/stats", [this](const httplib::Request& req, httplib::Response& res) { handleStats(req, res); });
+        server.set_exception_handler([](const httplib::Request&, httplib::Response& res, exception_ptr ep) {
+            string message = "internal error";
+            try {
+                rethrow_exception(ep);
+            } catch (const exception& e) {
+                message = e.what();
+            } catch (...) {
+            }
+            sendError(res, 500, message);
+        });
+    }
+
+    // Blocks until stop() is called or the port cannot be bound
+    bool listen() {
+        cout << "Routing API listening on http://" << options.host << ":" << options.port << " ("
+             << options.threads << " threads, " << savedLocations()->locations.size() << " saved locations)" << endl;
+        return server.listen(options.host, options.port);
+    }
+
+    void stop() {
+        server.stop();
+    }
+
+    // Routes NDJSON queries, one object per line:
+    //   {"id": any, "from": "...", "to": "...", "type": "fastest", "backend": "local",
+    //    "alternatives": false, "details": false}
+    // Lines come from nextLine until it returns false and go to `threads` workers; each
+    // result line goes to emit as soon as it is ready, so output is in completion order
+    // and "index" gives the input position. At most BATCH_WINDOW_PER_THREAD queries per
+    // worker are in flight, so memory stays flat however long the input is. Stops early
+    // when emit returns false. Returns the number of queries answered.
+    size_t runBatch(const function<bool(string&)>& nextLine, const function<bool(const string&)>& emit,
+                    size_t threads) {
+        threads = max<size_t>(1, threads);
+        size_t window = threads * BATCH_WINDOW_PER_THREAD;
+        mutex queueMutex;
+        condition_variable queueChanged;
+        deque<pair<size_t, string>> queued;
+        bool inputDone = false;
+        bool cancelled = false;
+        size_t answered = 0;
+        mutex emitMutex;
+        
+        vector<thread> workers;
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&]() {
+                while (true) {
+                    pair<size_t, string> query;
+                    {
+                        unique_lock<mutex> lock(queueMutex);
+                        queueChanged.wait(lock, [&]() { return !queued.empty() || inputDone || cancelled; });
+                        if (cancelled || queued.empty()) return;
+                        query = move(queued.front());
+                        queued.pop_front();
+                    }
+                    queueChanged.notify_all();
+                    
+                    string result = routeQueryLine(query.second, query.first);
+                    result += '\n';
+                    
+                    lock_guard<mutex> lock(emitMutex);
+                    if (!emit(result)) {
+                        lock_guard<mutex> queueLock(queueMutex);
+                        cancelled = true;
+                        queueChanged.notify_all();
+                        return;
+                    }
+                    answered++;
+                }
+            });
         }
         
-        switch (choice) {
-            case 0:
-                exit = true;
-                break;
-            case 1:
-                viewSavedRoute();
-                break;
-            case 2:
-                deleteSavedRoute();
-                break;
-            default:
-                cout << "Invalid option. Please try again." << endl;
-                break;
+        string line;
+        size_t index = 0;
+        while (nextLine(line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            unique_lock<mutex> lock(queueMutex);
+            queueChanged.wait(lock, [&]() { return queued.size() < window || cancelled; });
+            if (cancelled) break;
+            queued.emplace_back(index++, move(line));
+            lock.unlock();
+            queueChanged.notify_all();
         }
+        {
+            lock_guard<mutex> lock(queueMutex);
+            inputDone = true;
+        }
+        queueChanged.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        return answered;
     }
-}
 
-void viewSavedRoute() {
-    vector<string> routeNames = routeManager.getAllRouteNames();
-    if (routeNames.empty()) {
-        cout << "No saved routes." << endl;
-        return;
+    static bool parseRouteType(const string& text, RouteType& routeType) {
+        if (text.empty() || text == "fastest") routeType = FASTEST;
+        else if (text == "shortest") routeType = SHORTEST;
+        else if (text == "avoid_tolls") routeType = AVOID_TOLLS;
+        else if (text == "scenic") routeType = SCENIC;
+        else return false;
+        return true;
     }
-    
-    cout << "\n===== View Saved Route =====" << endl;
-    cout << "Select route to view:" << endl;
-    
-    for (size_t i = 0; i < routeNames.size(); i++) {
-        cout << (i+1) << ". " << routeNames[i] << endl;
+
+    static string routeTypeName(RouteType routeType) {
+        switch (routeType) {
+            case SHORTEST: return "shortest";
+            case AVOID_TOLLS: return "avoid_tolls";
+            case SCENIC: return "scenic";
+            default: return "fastest";
+        }
     }
-    
-    cout << "\nEnter number (0 to cancel): ";
-    int idx;
-    try {
-        string input;
-        getline(cin, input);
-        idx = stoi(input) - 1;
-    } catch (const exception&) {
-        idx = -1;
+
+private:
+    class RouteQuery {
+    public:
+        RouteType routeType = FASTEST;
+        RoutingBackendMode backendMode = BACKEND_DEFAULT;
+        bool alternatives = true;
+        bool details = true;
+        AdmissionControl::Priority priority = AdmissionControl::INTERACTIVE;
+    };
+
+    // Thrown out of cachedRoutes when admission control sheds the request
+    class Overloaded : public runtime_error {
+    public:
+        Overloaded() : runtime_error("server overloaded, retry later") {}
+    };
+
+    struct SavedLocations {
+        vector<Location> locations;
+        unordered_map<string, size_t> byName;
+        LocationSearchIndex index;
+    };
+
+    // A rendered /route body and its validator, usable while the graph version it was
+    // planned against is current
+    struct CachedRoute {
+        string body;
+        string etag;
+        uint64_t graphVersion = 0;
+        chrono::steady_clock::time_point expiresAt;
+    };
+
+    Options options;
+    RouteFinder routeFinder;
+    Geocoder geocoder;
+    // Swapped whole by /reload; read through savedLocations()
+    shared_ptr<const SavedLocations> saved;
+    // Bumped whenever routing inputs change, which retires every cached route at once
+    atomic<uint64_t> graphVersion{1};
+    ShardedLruCache<string, shared_ptr<const CachedRoute>> routeCache;
+    SingleFlight<string, shared_ptr<const CachedRoute>> routeFlights;
+    AdmissionControl admission;
+    httplib::Server server;
+
+    static shared_ptr<const SavedLocations> loadSavedLocations() {
+        auto snapshot = make_shared<SavedLocations>();
+        RouteUtils::LocationManager locationManager;
+        vector<string> names = locationManager.getAllLocationNames();
+        sort(names.begin(), names.end());
+        for (const string& name : names) {
+            snapshot->byName[name] = snapshot->locations.size();
+            snapshot->locations.push_back(locationManager.getLocation(name));
+            snapshot->index.add(name);
+        }
+        snapshot->index.finalize();
+        return snapshot;
     }
-    
-    if (idx < 0 || idx >= routeNames.size()) {
-        cout << "Operation cancelled or invalid selection." << endl;
-        return;
+
+    shared_ptr<const SavedLocations> savedLocations() const {
+        return atomic_load(&saved);
     }
-    
-    string name = routeNames[idx];
-    auto route = routeManager.getRoute(name);
-    
-    cout << "\n===== Route: " << name << " =====" << endl;
-    cout << "From: " << route.startLocationName << endl;
-    cout << "To: " << route.endLocationName << endl;
-    
-    string routeType;
-    switch (route.routeType) {
-        case FASTEST: routeType = "Fastest"; break;
-        case SHORTEST: routeType = "Shortest"; break;
-        case AVOID_TOLLS: routeType = "Avoid Tolls"; break;
-        case SCENIC: routeType = "Scenic"; break;
+
+    static void sendJson(httplib::Response& res, string body) {
+        res.set_content(move(body), "application/json");
     }
-    cout << "Route type: " << routeType << endl;
-    
-    // Get the actual locations
-    Location startLoc = locationManager.getLocation(route.startLocationName);
-    if (startLoc.name.empty()) {
-        startLoc = geocoder.geocodeLocation(route.startLocationName);
+
+    static void sendError(httplib::Response& res, int status, const string& message) {
+        res.status = status;
+        JsonWriter json;
+        json.beginObject().key("error").value(message).endObject();
+        sendJson(res, json.take());
     }
-    
-    Location endLoc = locationManager.getLocation(route.endLocationName);
-    if (endLoc.name.empty()) {
-        endLoc = geocoder.geocodeLocation(route.endLocationName);
+
+    static void sendOverloaded(httplib::Response& res) {
+        res.set_header("Retry-After", "1");
+        sendError(res, 503, Overloaded().what());
     }
-    
-    if (!startLoc.name.empty() && !endLoc.name.empty()) {
-        cout << "\nDo you want to recalculate this route? (y/n): ";
-        string recalc;
-        getline(cin, recalc);
+
+    static void writeLocation(JsonWriter& json, const Location& location) {
+        json.beginObject()
+            .key("name").value(location.name)
+            .key("lat").number(location.lat)
+            .key("lon").number(location.lon)
+            .endObject();
+    }
+
+    // "lat,lon", a saved location name, or anything the geocoder resolves
+    bool resolveLocation(const string& text, Deadline deadline, Location& location) {
+        const char* begin = text.c_str();
+        char* end = nullptr;
+        double lat = strtod(begin, &end);
+        if (end != begin && *end == ',') {
+            const char* lonBegin = end + 1;
+            double lon = strtod(lonBegin, &end);
+            if (end != lonBegin && *end == '\0' && fabs(lat) <= 90 && fabs(lon) <= 180) {
+                lat = round(lat / COORDINATE_SNAP_DEGREES) * COORDINATE_SNAP_DEGREES;
+                lon = round(lon / COORDINATE_SNAP_DEGREES) * COORDINATE_SNAP_DEGREES;
+                ReverseGeocoder::Result place = geocoder.reverseGeocode(lat, lon);
+                location = Location(place.found() ? place.label() : text, lat, lon);
+                return true;
+            }
+        }
         
-        if (recalc == "y" || recalc == "Y") {
-            double directDistance = RouteUtils::getAccurateDistance(startLoc, endLoc);
-            generateAndDisplayRoutes(startLoc, endLoc, directDistance, route.routeType);
+        shared_ptr<const SavedLocations> snapshot = savedLocations();
+        auto it = snapshot->byName.find(text);
+        if (it != snapshot->byName.end()) {
+            location = snapshot->locations[it->second];
+            return true;
+        }
+        location = geocoder.geocodeLocation(text, deadline);
+        return !location.name.empty();
+    }
+
+    bool readOptions(const httplib::Request& req, httplib::Response& res, RouteType& routeType,
+                     RoutingBackendMode& backendMode) {
+        if (!parseRouteType(req.get_param_value("type"), routeType)) {
+            sendError(res, 400, "type must be fastest, shortest, avoid_tolls or scenic");
+            return false;
+        }
+        backendMode = BACKEND_DEFAULT;
+        string backend = req.get_param_value("backend");
+        if (!backend.empty() && !RouteFinder::parseRoutingBackendMode(backend, backendMode)) {
+            sendError(res, 400, "backend must be auto, local or remote");
+            return false;
+        }
+        return true;
+    }
+
+    // Optional timeout_ms shortens REQUEST_BUDGET for callers that need an answer sooner
+    bool readDeadline(const httplib::Request& req, httplib::Response& res, Deadline& deadline) {
+        chrono::milliseconds budget = REQUEST_BUDGET;
+        if (req.has_param("timeout_ms")) {
+            long long timeoutMs = 0;
+            try {
+                timeoutMs = stoll(req.get_param_value("timeout_ms"));
+            } catch (const exception&) {
+                timeoutMs = 0;
+            }
+            if (timeoutMs <= 0) {
+                sendError(res, 400, "timeout_ms must be a positive number");
+                return false;
+            }
+            budget = min(budget, chrono::milliseconds(timeoutMs));
+        }
+        deadline = Deadline::after(budget);
+        return true;
+    }
+
+    // GET /route?from=&to=[&type=][&backend=][&alternatives=false][&details=false][&timeout_ms=]
+    void handleRoute(const httplib::Request& req, httplib::Response& res) {
+        string from = req.get_param_value("from");
+        string to = req.get_param_value("to");
+        if (from.empty() || to.empty()) {
+            sendError(res, 400, "from and to are required");
+            return;
+        }
+        RouteQuery query;
+        if (!readOptions(req, res, query.routeType, query.backendMode)) return;
+        query.alternatives = req.get_param_value("alternatives") != "false";
+        query.details = req.get_param_value("details") != "false";
+        
+        Deadline deadline;
+        if (!readDeadline(req, res, deadline)) return;
+        Location start, end;
+        if (!resolveLocation(from, deadline, start)) {
+            sendError(res, 404, "location not found: " + from);
+            return;
+        }
+        if (!resolveLocation(to, deadline, end)) {
+            sendError(res, 404, "location not found: " + to);
+            return;
+        }
+        
+        bool hit = false;
+        shared_ptr<const CachedRoute> rendered;
+        try {
+            rendered = cachedRoutes(start, end, query, deadline, hit);
+        } catch (const Overloaded&) {
+            sendOverloaded(res);
+            return;
+        }
+        if (!rendered) {
+            sendError(res, 404, "no route found");
+            return;
+        }
+        // no-cache: clients may keep the body but must revalidate, so a graph change reaches them
+        res.set_header("ETag", rendered->etag);
+        res.set_header("Cache-Control", "no-cache");
+        res.set_header("X-Cache", hit ? "hit" : "miss");
+        if (etagMatches(req.get_header_value("If-None-Match"), rendered->etag)) {
+            res.status = 304;
+            return;
         }
+        sendJson(res, rendered->body);
     }
-}
 
-void deleteSavedRoute() {
-    vector<string> routeNames = routeManager.getAllRouteNames();
-    if (routeNames.empty()) {
-        cout << "No saved routes." << endl;
-        return;
-    }
-    
-    cout << "\n===== Delete Saved Route =====" << endl;
-    cout << "Select route to delete:" << endl;
-    
-    for (size_t i = 0; i < routeNames.size(); i++) {
-        cout << (i+1) << ". " << routeNames[i] << endl;
+    // The resolved endpoints as responses print them plus every option that shapes the
+    // body, so different spellings of one place share an entry
+    static string routeCacheKey(const Location& start, const Location& end, const RouteQuery& query) {
+        JsonWriter key;
+        writeLocation(key, start);
+        writeLocation(key, end);
+        key.integer(query.routeType).integer(query.backendMode);
+        key.boolean(query.alternatives).boolean(query.details);
+        return key.take();
     }
-    
-    cout << "\nEnter number (0 to cancel): ";
-    int idx;
-    try {
-        string input;
-        getline(cin, input);
-        idx = stoi(input) - 1;
-    } catch (const exception&) {
-        idx = -1;
+
+    // If-None-Match holds "*" or a list of quoted, possibly weak, tags
+    static bool etagMatches(const string& header, const string& etag) {
+        return !header.empty() && (header == "*" || header.find(etag) != string::npos);
     }
-    
-    if (idx < 0 || idx >= routeNames.size()) {
-        cout << "Operation cancelled or invalid selection." << endl;
-        return;
+
+    // The rendered /route body for start to end, or null when there is no route. Served
+    // from routeCache while the entry is fresh and from the current graph version, without
+    // going through admission; concurrent misses on one key plan once and share the result.
+    // Throws Overloaded when the planning is shed.
+    shared_ptr<const CachedRoute> cachedRoutes(const Location& start, const Location& end,
+                                               const RouteQuery& query, Deadline deadline, bool& hit) {
+        string key = routeCacheKey(start, end, query);
+        uint64_t version = graphVersion.load();
+        shared_ptr<const CachedRoute> entry;
+        hit = routeCache.get(key, entry) && entry->graphVersion == version &&
+              entry->expiresAt > chrono::steady_clock::now();
+        if (hit) return entry;
+        
+        // Flights are per priority class: a follower inherits the leader's admission, so an
+        // interactive caller must never wait behind an unbounded batch admission, nor a
+        // batch query be shed along with an interactive leader
+        bool batch = query.priority == AdmissionControl::BATCH;
+        return routeFlights.run(key + (batch ? "#batch" : "#interactive"), [&]() -> shared_ptr<const CachedRoute> {
+            // Batch queries wait out the queue instead of being shed, so their upstream
+            // budget starts once they are admitted
+            AdmissionControl::Ticket ticket = admission.admit(query.priority, batch ? Deadline() : deadline);
+            if (!ticket) throw Overloaded();
+            Deadline planDeadline = batch ? Deadline::after(REQUEST_BUDGET) : deadline;
+            
+            JsonWriter json;
+            json.beginObject();
+            bool usedFallback = false;
+            if (!writeRoutes(json, start, end, query, planDeadline, usedFallback)) {
+                return nullptr;
+            }
+            json.endObject();
+            
+            auto rendered = make_shared<CachedRoute>();
+            rendered->body = json.take();
+            char etag[24];
+            snprintf(etag, sizeof(etag), "\"%016zx\"", hash<string>()(rendered->body));
+            rendered->etag = etag;
+            rendered->graphVersion = version;
+            // Synthesized road names only stand in until OSRM answers again
+            int ttlSeconds = usedFallback ? min(options.routeCacheSeconds, FALLBACK_CACHE_SECONDS) : options.routeCacheSeconds;
+            rendered->expiresAt = chrono::steady_clock::now() + chrono::seconds(ttlSeconds);
+            if (options.routeCacheEntries > 0 && options.routeCacheSeconds > 0) {
+                routeCache.put(key, rendered);
+            }
+            return rendered;
+        });
     }
-    
-    string name = routeNames[idx];
-    cout << "Are you sure you want to delete route '" << name << "'? (y/n): ";
-    string confirm;
-    getline(cin, confirm);
-    
-    if (confirm == "y" || confirm == "Y") {
-        if (routeManager.deleteRoute(name)) {
-            cout << "Route deleted successfully." << endl;
-        } else {
-            cout << "Error deleting route." << endl;
+
+    // GET /route/events with the /route parameters, answered as server-sent events:
+    //   route    one per route as soon as its search finishes (waypoints, distance, duration)
+    //   tolls    right after the first route
+    //   details  road names per leg for one route, in the order they resolve
+    //   done     the route count; error instead of all of these when planning fails
+    // The stream holds a routing slot from admission until it ends.
+    void handleRouteEvents(const httplib::Request& req, httplib::Response& res) {
+        string from = req.get_param_value("from");
+        string to = req.get_param_value("to");
+        if (from.empty() || to.empty()) {
+            sendError(res, 400, "from and to are required");
+            return;
         }
-    } else {
-        cout << "Deletion cancelled." << endl;
+        RouteQuery query;
+        if (!readOptions(req, res, query.routeType, query.backendMode)) return;
+        query.alternatives = req.get_param_value("alternatives") != "false";
+        query.details = req.get_param_value("details") != "false";
+        Deadline deadline;
+        if (!readDeadline(req, res, deadline)) return;
+        
+        auto ticket = make_shared<AdmissionControl::Ticket>(admission.admit(AdmissionControl::INTERACTIVE, deadline));
+        if (!*ticket) {
+            sendOverloaded(res);
+            return;
+        }
+        res.set_header("Cache-Control", "no-cache");
+        res.set_chunked_content_provider("text/event-stream",
+            [this, from, to, query, deadline, ticket](size_t, httplib::DataSink& sink) {
+                streamRouteEvents(from, to, query, deadline, sink);
+                sink.done();
+                return true;
+            });
     }
-}
-void visualizeCurrentGraph() {
-    if (currentGraph.empty()) {
-        cout << "\nNo graph available for visualization. Please plan a route first." << endl;
-        return;
+
+    static bool sendEvent(httplib::DataSink& sink, const string& event, const string& data) {
+        string frame = "event: " + event + "\ndata: " + data + "\n\n";
+        return sink.write(frame.data(), frame.size());
     }
-    
-    cout << "\n===== Graph Visualization =====" << endl;
-    cout << RouteUtils::GraphVisualizer::visualizeGraph(currentGraph) << endl;
-    
-    // Option to save visualization
-    cout << "Do you want to save this graph visualization to a file? (y/n): ";
-    string saveGraph;
-    getline(cin, saveGraph);
-    
-    if (saveGraph == "y" || saveGraph == "Y") {
-        // Get current timestamp for filename
-        time_t now = time(0);
-        tm* ltm = localtime(&now);
-        stringstream timestamp;
-        timestamp << 1900 + ltm->tm_year << "-" 
-                  << setw(2) << setfill('0') << 1 + ltm->tm_mon << "-"
-                  << setw(2) << setfill('0') << ltm->tm_mday << "_"
-                  << setw(2) << setfill('0') << ltm->tm_hour 
-                  << setw(2) << setfill('0') << ltm->tm_min;
+
+    void streamRouteEvents(const string& from, const string& to, const RouteQuery& query, Deadline deadline,
+                           httplib::DataSink& sink) {
+        Location start, end;
+        for (const auto& endpoint : {make_pair(from, &start), make_pair(to, &end)}) {
+            if (!resolveLocation(endpoint.first, deadline, *endpoint.second)) {
+                JsonWriter json;
+                json.beginObject().key("error").value("location not found: " + endpoint.first).endObject();
+                sendEvent(sink, "error", json.str());
+                return;
+            }
+        }
         
-        string defaultFilename = "graph_visualization_" + timestamp.str() + ".txt";
-        cout << "Enter filename (default: " << defaultFilename << "): ";
-        string filename;
-        getline(cin, filename);
+        RouteType routeType = query.routeType;
+        unordered_map<string, Node>& graph = SearchWorkspace::forThisThread().graph;
+        vector<vector<string>> paths;
+        bool connected = true;
+        
+        vector<vector<string>> routes = routeFinder.planRoutesProgressive(
+            graph, start, end, RouteUtils::getAccurateDistance(start, end), routeType, deadline, query.backendMode,
+            [&](size_t index, const vector<string>& path) {
+                paths.push_back(path);
+                if (!connected || (index > 0 && !query.alternatives)) return false;
+                double distance = RouteFinder::pathDistance(path, graph);
+                JsonWriter json;
+                json.beginObject().key("index").integer(static_cast<long long>(index));
+                json.key("recommended").boolean(index == 0);
+                json.key("distance_km").number(distance, 3);
+                json.key("duration_min").number(distance / RouteFinder::averageSpeedKmh(routeType) * 60, 1);
+                json.key("waypoints").beginArray();
+                for (const auto& nodeId : path) {
+                    writeLocation(json, graph.at(nodeId).location);
+                }
+                json.endArray().endObject();
+                connected = sendEvent(sink, "route", json.str());
+                
+                // Tolls depend only on the endpoints, so they need not wait for the alternatives
+                if (connected && index == 0) {
+                    double tollCost = 0;
+                    string currency = "IDR";
+                    if (routeType != AVOID_TOLLS) {
+                        routeFinder.getTollInfo(start, end, routeType, tollCost, currency);
+                    }
+                    JsonWriter tolls;
+                    tolls.beginObject().key("toll_cost").number(tollCost, 0).key("currency").value(currency).endObject();
+                    connected = sendEvent(sink, "tolls", tolls.str());
+                }
+                return connected && query.details;
+            },
+            [&](size_t index, const vector<vector<string>>& segmentDetails) {
+                if (!connected) return;
+                JsonWriter json;
+                json.beginObject().key("index").integer(static_cast<long long>(index));
+                json.key("legs").beginArray();
+                for (size_t leg = 0; leg < segmentDetails.size(); leg++) {
+                    json.beginObject();
+                    json.key("distance_km").number(RouteFinder::pathDistance({paths[index][leg], paths[index][leg + 1]}, graph), 3);
+                    json.key("roads").beginArray();
+                    for (const auto& road : segmentDetails[leg]) json.value(road);
+                    json.endArray().endObject();
+                }
+                json.endArray().endObject();
+                connected = sendEvent(sink, "details", json.str());
+            });
+        if (!connected) return;
         
-        if (filename.empty()) {
-            filename = defaultFilename;
+        if (routes.empty()) {
+            sendEvent(sink, "error", "{\"error\":\"no route found\"}");
+            return;
         }
         
-        if (filename.find(".txt") == string::npos) {
-            filename += ".txt";
+        JsonWriter done;
+        done.beginObject().key("routes").integer(static_cast<long long>(query.alternatives ? routes.size() : 1)).endObject();
+        sendEvent(sink, "done", done.str());
+    }
+
+    // Plans start to end on this thread's workspace graph and writes the /route fields
+    // (from, to, type, tolls, routes) into the open object. False when no route exists;
+    // usedFallback is set when road names had to be synthesized in place of OSRM's.
+    bool writeRoutes(JsonWriter& json, const Location& start, const Location& end, const RouteQuery& query,
+                     Deadline deadline, bool& usedFallback) {
+        RouteType routeType = query.routeType;
+        unordered_map<string, Node>& graph = SearchWorkspace::forThisThread().graph;
+        vector<vector<string>> routes = routeFinder.planRoutes(
+            graph, start, end, RouteUtils::getAccurateDistance(start, end), routeType);
+        if (routes.empty()) {
+            return false;
+        }
+        if (!query.alternatives) routes.resize(1);
+        vector<vector<vector<string>>> routeDetails;
+        if (query.details) {
+            routeDetails = routeFinder.prefetchRouteDetails(routes, graph, routeType, deadline, query.backendMode,
+                                                            &usedFallback);
         }
         
-        RouteUtils::GraphVisualizer::saveGraphVisualization(currentGraph, filename);
-        cout << "Graph visualization saved to " << filename << endl;
+        double tollCost = 0;
+        string currency = "IDR";
+        if (routeType != AVOID_TOLLS) {
+            routeFinder.getTollInfo(start, end, routeType, tollCost, currency);
+        }
+        
+        json.key("from");
+        writeLocation(json, start);
+        json.key("to");
+        writeLocation(json, end);
+        json.key("type").value(routeTypeName(routeType));
+        json.key("toll_cost").number(tollCost, 0).key("currency").value(currency);
+        json.key("routes").beginArray();
+        for (size_t i = 0; i < routes.size(); i++) {
+            const auto& route = routes[i];
+            vector<vector<string>> segmentDetails;
+            if (query.details) segmentDetails = move(routeDetails[i]);
+            double distance = RouteFinder::pathDistance(route, graph);
+            
+            json.beginObject();
+            json.key("recommended").boolean(i == 0);
+            json.key("distance_km").number(distance, 3);
+            json.key("duration_min").number(distance / RouteFinder::averageSpeedKmh(routeType) * 60, 1);
+            json.key("waypoints").beginArray();
+            for (const auto& nodeId : route) {
+                writeLocation(json, graph.at(nodeId).location);
+            }
+            json.endArray();
+            json.key("legs").beginArray();
+            for (size_t leg = 0; leg + 1 < route.size(); leg++) {
+                json.beginObject();
+                json.key("distance_km").number(RouteFinder::pathDistance({route[leg], route[leg + 1]}, graph), 3);
+                if (leg < segmentDetails.size()) {
+                    json.key("roads").beginArray();
+                    for (const auto& road : segmentDetails[leg]) json.value(road);
+                    json.endArray();
+                }
+                json.endObject();
+            }
+            json.endArray();
+            json.endObject();
+        }
+        json.endArray();
+        return true;
     }
-}
 
+    // One batch query line to one result line (without the newline)
+    string routeQueryLine(const string& line, size_t index) {
+        JsonWriter json;
+        json.beginObject().key("index").integer(static_cast<long long>(index));
+        try {
+            nlohmann::json query = nlohmann::json::parse(line);
+            if (query.contains("id")) {
+                json.key("id").raw(query["id"].dump());
+            }
+            
+            RouteQuery options;
+            options.priority = AdmissionControl::BATCH;
+            options.alternatives = query.value("alternatives", false);
+            options.details = query.value("details", false);
+            string from = query.value("from", string());
+            string to = query.value("to", string());
+            if (from.empty() || to.empty()) {
+                json.key("error").value("from and to are required").endObject();
+                return json.take();
+            }
+            if (!parseRouteType(query.value("type", string()), options.routeType)) {
+                json.key("error").value("type must be fastest, shortest, avoid_tolls or scenic").endObject();
+                return json.take();
+            }
+            string backend = query.value("backend", string());
+            if (!backend.empty() && !RouteFinder::parseRoutingBackendMode(backend, options.backendMode)) {
+                json.key("error").value("backend must be auto, local or remote").endObject();
+                return json.take();
+            }
+            
+            Deadline deadline = Deadline::after(REQUEST_BUDGET);
+            Location start, end;
+            if (!resolveLocation(from, deadline, start)) {
+                json.key("error").value("location not found: " + from).endObject();
+                return json.take();
+            }
+            if (!resolveLocation(to, deadline, end)) {
+                json.key("error").value("location not found: " + to).endObject();
+                return json.take();
+            }
+            
+            // The cached body's members follow "index" and "id"
+            bool hit = false;
+            shared_ptr<const CachedRoute> rendered = cachedRoutes(start, end, options, deadline, hit);
+            if (rendered) {
+                json.raw(rendered->body.substr(1, rendered->body.size() - 2));
+            } else {
+                json.key("error").value("no route found");
+            }
+            json.endObject();
+            return json.take();
+        } catch (const Overloaded& e) {
+            json.key("error").value(e.what()).endObject();
+            return json.take();
+        } catch (const exception& e) {
+            json.key("error").value(string("invalid query: ") + e.what()).endObject();
+            return json.take();
+        }
+    }
 
-// void generateAndDisplayRoutes(
-//     const Location& startLocation, 
-//     const Location& endLocation, 
-//     double directDistance,
-//     RouteType routeType) {
-    
-//     try {
-//         currentGraph.clear();
-//         string startId = "start";
-//         string endId = "end";
+    // POST /batch with an NDJSON body of queries (see runBatch); results stream back as
+    // NDJSON over chunked transfer while the batch runs. The request body is held in memory,
+    // the response never is.
+    void handleBatch(const httplib::Request& req, httplib::Response& res) {
+        auto body = make_shared<string>(req.body);
+        size_t threads = options.batchThreads;
+        res.set_chunked_content_provider("application/x-ndjson",
+            [this, body, threads](size_t, httplib::DataSink& sink) {
+                istringstream input(*body);
+                runBatch([&input](string& line) { return static_cast<bool>(getline(input, line)); },
+                         [&sink](const string& result) { return sink.write(result.data(), result.size()); },
+                         threads);
+                sink.done();
+                return true;
+            });
+    }
+
+    // GET /geocode?q=NAME, or /geocode?lat=&lon= for the nearest known place
+    void handleGeocode(const httplib::Request& req, httplib::Response& res) {
+        if (req.has_param("lat") || req.has_param("lon")) {
+            double lat, lon;
+            try {
+                lat = stod(req.get_param_value("lat"));
+                lon = stod(req.get_param_value("lon"));
+            } catch (const exception&) {
+                sendError(res, 400, "lat and lon must be numbers");
+                return;
+            }
+            ReverseGeocoder::Result result = geocoder.reverseGeocode(lat, lon);
+            if (!result.found()) {
+                sendError(res, 404, "no known place near these coordinates");
+                return;
+            }
+            JsonWriter json;
+            json.beginObject()
+                .key("lat").number(lat)
+                .key("lon").number(lon)
+                .key("label").value(result.label())
+                .key("place").value(result.place)
+                .key("area").value(result.area)
+                .key("distance_km").number(result.distance, 3)
+                .endObject();
+            sendJson(res, json.take());
+            return;
+        }
         
-//         currentGraph[startId] = Node(startId, startLocation);
-//         currentGraph[endId] = Node(endId, endLocation);
-//         currentGraph[startId].edges.push_back(make_pair(endId, directDistance));
+        string query = req.get_param_value("q");
+        if (query.empty()) {
+            sendError(res, 400, "q, or lat and lon, are required");
+            return;
+        }
+        Location location = geocoder.geocodeLocation(query, Deadline::after(REQUEST_BUDGET));
+        if (location.name.empty()) {
+            sendError(res, 404, "location not found: " + query);
+            return;
+        }
+        JsonWriter json;
+        json.beginObject().key("query").value(query).key("location");
+        writeLocation(json, location);
+        json.endObject();
+        sendJson(res, json.take());
+    }
+
+    // GET /matrix?locations=A;B;C[&type=][&timeout_ms=] — recommended-route distance and
+    // duration between every ordered pair; null where no route exists
+    void handleMatrix(const httplib::Request& req, httplib::Response& res) {
+        RouteType routeType;
+        RoutingBackendMode backendMode;
+        if (!readOptions(req, res, routeType, backendMode)) return;
         
-//         vector<vector<string>> routes = routeFinder.generateMultipleRoutes(
-//             currentGraph, startId, endId, startLocation, endLocation, routeType);
+        vector<string> names;
+        stringstream list(req.get_param_value("locations"));
+        string name;
+        while (getline(list, name, ';')) {
+            if (!name.empty()) names.push_back(name);
+        }
+        if (names.size() < 2 || names.size() > options.maxMatrixLocations) {
+            sendError(res, 400, "locations needs between 2 and " + to_string(options.maxMatrixLocations) +
+                                " entries separated by ';'");
+            return;
+        }
         
-//         if (routes.empty()) {
-//             cout << "No routes found between the locations. Please try different locations." << endl;
-//             return;
-//         }
+        Deadline deadline;
+        if (!readDeadline(req, res, deadline)) return;
+        vector<Location> locations(names.size());
+        for (size_t i = 0; i < names.size(); i++) {
+            if (!resolveLocation(names[i], deadline, locations[i])) {
+                sendError(res, 404, "location not found: " + names[i]);
+                return;
+            }
+        }
         
-//         cout << "\n===== Available Routes between " 
-//             << Location::extractCityName(startLocation.name) << " and " 
-//             << Location::extractCityName(endLocation.name) << " =====" << endl;
+        AdmissionControl::Ticket ticket = admission.admit(AdmissionControl::INTERACTIVE, deadline);
+        if (!ticket) {
+            sendOverloaded(res);
+            return;
+        }
+        vector<vector<double>> distances(locations.size(), vector<double>(locations.size(), 0.0));
+        unordered_map<string, Node>& graph = SearchWorkspace::forThisThread().graph;
+        vector<double> lats, lons, cosLats, direct(locations.size());
+        for (const auto& location : locations) {
+            lats.push_back(location.lat);
+            lons.push_back(location.lon);
+            cosLats.push_back(location.cosLat);
+        }
+        for (size_t i = 0; i < locations.size(); i++) {
+            // One batched pass gives this row's straight-line distances; pairs that resolve to
+            // the same point need no search
+            RouteUtils::calculateDistanceBatch(locations[i], lats.data(), lons.data(), cosLats.data(),
+                                               direct.data(), locations.size());
+            for (size_t j = 0; j < locations.size(); j++) {
+                if (i == j || direct[j] < COINCIDENT_KM) continue;
+                double tableDistance;
+                if (RouteUtils::getCityTableDistance(locations[i], locations[j], tableDistance)) {
+                    direct[j] = tableDistance;
+                }
+                vector<vector<string>> routes = routeFinder.planRoutes(
+                    graph, locations[i], locations[j], direct[j], routeType);
+                distances[i][j] = routes.empty() ? numeric_limits<double>::quiet_NaN()
+                                                 : RouteFinder::pathDistance(routes[0], graph);
+            }
+        }
         
-//         vector<string> routeDescriptions;
-//         vector<string> detailedRoutes;
+        double speed = RouteFinder::averageSpeedKmh(routeType);
+        JsonWriter json;
+        json.beginObject().key("type").value(routeTypeName(routeType));
+        json.key("locations").beginArray();
+        for (const auto& location : locations) writeLocation(json, location);
+        json.endArray();
+        json.key("distances_km").beginArray();
+        for (const auto& row : distances) {
+            json.beginArray();
+            for (double distance : row) json.number(distance, 3);
+            json.endArray();
+        }
+        json.endArray();
+        json.key("durations_min").beginArray();
+        for (const auto& row : distances) {
+            json.beginArray();
+            for (double distance : row) json.number(distance / speed * 60, 1);
+            json.endArray();
+        }
+        json.endArray().endObject();
+        sendJson(res, json.take());
+    }
+
+    // GET /locations[?q=&limit=] — saved locations, ranked by name match when q is given
+    void handleLocations(const httplib::Request& req, httplib::Response& res) {
+        string query = req.get_param_value("q");
+        shared_ptr<const SavedLocations> saved = savedLocations();
+        size_t limit = saved->locations.size();
+        if (req.has_param("limit")) {
+            try {
+                limit = stoul(req.get_param_value("limit"));
+            } catch (const exception&) {
+                sendError(res, 400, "limit must be a number");
+                return;
+            }
+        }
         
-//         for (size_t i = 0; i < routes.size(); i++) {
-//             const auto& route = routes[i];
-//             cout << "Route " << (i+1) << ": ";
-            
-//             if (i == 0) {
-//                 cout << "Recommended Route" << endl;
-//             } else {
-//                 cout << "Alternative Route " << i << endl;
-//             }
-            
-//             string formattedRoute = RouteUtils::cleanRouteSymbols(routeFinder.formatRoute(route, currentGraph, routeType));
-//             cout << formattedRoute << endl;
-//             routeDescriptions.push_back(formattedRoute);
-            
-//             cout << "Step-by-step directions:" << endl;
-            
-//             stringstream stepDetails;
-//             for (size_t j = 0; j < route.size() - 1; j++) {
-//                 const auto& currentNode = currentGraph[route[j]];
-//                 const auto& nextNode = currentGraph[route[j+1]];
-                
-//                 double segmentDistance = 0;
-//                 for (const auto& edge : currentNode.edges) {
-//                     if (edge.first == route[j+1]) {
-//                         segmentDistance = edge.second;
-//                         break;
-//                     }
-//                 }
-                
-//                 vector<string> segmentRoads = routeFinder.getRouteDetails(
-//                     currentNode.location, 
-//                     nextNode.location, 
-//                     routeType
-//                 );
-                
-//                 string stepDescription = "  " + to_string(j+1) + ". " + currentNode.location.name;
-//                 for (const auto& road : segmentRoads) {
-//                     stepDescription += " → " + road;
-//                 }
-//                 stepDescription += " → " + nextNode.location.name;
-                
-//                 double speed = 60.0;
-//                 switch (routeType) {
-//                     case FASTEST: speed = 60.0; break;
-//                     case SHORTEST: speed = 50.0; break;
-//                     case AVOID_TOLLS: speed = 45.0; break;
-//                     case SCENIC: speed = 40.0; break;
-//                 }
-//                 double time = (segmentDistance / speed) * 60;
-//                 stepDescription += " (" + to_string(static_cast<int>(segmentDistance)) + 
-//                                 " km, " + to_string(static_cast<int>(time)) + " min)";
-                
-//                 cout << RouteUtils::cleanRouteSymbols(stepDescription) << endl;
-//                 stepDetails << RouteUtils::cleanRouteSymbols(stepDescription) << "\n";
-//             }
-            
-//             string detailedRoute = routeFinder.formatRouteWithRealDirections(
-//                 route, currentGraph, routeType);
-//             cout << "\nFormatted Route: " << RouteUtils::cleanRouteSymbols(detailedRoute) << endl;
-//             detailedRoutes.push_back("Route " + to_string(i+1) + 
-//                 (i == 0 ? " (Recommended Route):\n" : " (Alternative Route):\n") +
-//                 RouteUtils::cleanRouteSymbols(detailedRoute) + 
-//                 "\n\nStep-by-step directions:\n" + stepDetails.str());
-            
-//             // Display path visualization
-//             cout << RouteUtils::GraphVisualizer::visualizePathInGraph(currentGraph, route) << endl;
-//         }
+        JsonWriter json;
+        json.beginObject().key("locations").beginArray();
+        if (query.empty()) {
+            for (size_t i = 0; i < saved->locations.size() && i < limit; i++) {
+                writeLocation(json, saved->locations[i]);
+            }
+        } else {
+            for (const auto& match : saved->index.search(query, limit)) {
+                auto it = saved->byName.find(match.name);
+                if (it != saved->byName.end()) writeLocation(json, saved->locations[it->second]);
+            }
+        }
+        json.endArray().endObject();
+        sendJson(res, json.take());
+    }
+
+    // POST /reload — re-reads saved locations and starts a new graph version, so every
+    // cached route is planned afresh on its next request
+    void handleReload(const httplib::Request&, httplib::Response& res) {
+        shared_ptr<const SavedLocations> snapshot = loadSavedLocations();
+        atomic_store(&saved, snapshot);
+        uint64_t version = ++graphVersion;
+        
+        JsonWriter json;
+        json.beginObject()
+            .key("graph_version").integer(static_cast<long long>(version))
+            .key("saved_locations").integer(static_cast<long long>(snapshot->locations.size()))
+            .endObject();
+        sendJson(res, json.take());
+    }
+
+    // GET /stats — admission queues and counters, route cache effectiveness
+    void handleStats(const httplib::Request&, httplib::Response& res) {
+        AdmissionControl::Stats stats = admission.stats();
+        JsonWriter json;
+        json.beginObject().key("admission").beginObject();
+        json.key("slots").integer(static_cast<long long>(stats.slots));
+        json.key("service_ms").number(stats.serviceMs, 3);
+        const char* classes[] = {"interactive", "batch"};
+        for (int p = AdmissionControl::INTERACTIVE; p <= AdmissionControl::BATCH; p++) {
+            json.key(classes[p]).beginObject()
+                .key("active").integer(static_cast<long long>(stats.active[p]))
+                .key("queued").integer(static_cast<long long>(stats.queued[p]))
+                .key("admitted").integer(static_cast<long long>(stats.admitted[p]))
+                .key("shed").integer(static_cast<long long>(stats.shed[p]))
+                .endObject();
+        }
+        json.endObject();
+        json.key("route_cache").beginObject()
+            .key("entries").integer(static_cast<long long>(routeCache.size()))
+            .key("hits").integer(static_cast<long long>(routeCache.hitCount()))
+            .key("misses").integer(static_cast<long long>(routeCache.missCount()))
+            .endObject();
+        json.key("graph_version").integer(static_cast<long long>(graphVersion.load()));
+        json.endObject();
+        sendJson(res, json.take());
+    }
+};
+
+// Stand-in for Nominatim and OSRM so network-path experiments run offline and repeatably.
+// Requests whose target appears in the recordings file get the recorded body; everything
+// else gets a synthetic but deterministic answer. Latency (base plus uniform jitter) and a
+// rate of HTTP 503 responses can be injected.
+class MockUpstreamServer {
+public:
+    class Options {
+    public:
+        string host = "127.0.0.1";
+        int port = 8089;
+        int latencyMs = 0;
+        int jitterMs = 0;
+        double errorRate = 0.0;
+        double slowRate = 0.0;      // share of requests that take slowMs extra (tail latency)
+        int slowMs = 0;
+        string recordingsFile;
+        uint64_t seed = 42;
+    };
+
+    explicit MockUpstreamServer(const Options& opts)
+        : options(opts), rng(opts.seed) {
+        // Keep-alive clients each hold a handler thread, so allow plenty of them
+        server.new_task_queue = []() { return new httplib::ThreadPool(64); };
+        if (!options.recordingsFile.empty() && !loadRecordings(options.recordingsFile)) {
+            cerr << "Warning: no recordings loaded from " << options.recordingsFile << endl;
+        }
         
-//         // Option to export route information to text file
-//         cout << "\n===== Export Options =====" << endl;
-//         cout << "1. Save route information to text file" << endl;
-//         cout << "2. Save graph visualization to text file" << endl; 
-//         cout << "3. Save both route and graph visualization" << endl;
-//         cout << "0. Continue without saving" << endl;
-//         cout << "Select an option: ";
+        server.Get("/search", [this](const httplib::Request& req, httplib::Response& res) {
+            if (injectFaults(req, res)) return;
+            handleSearch(req, res);
+        });
+        server.Get(R"(/route/v1/driving/([^/?]+))", [this](const httplib::Request& req, httplib::Response& res) {
+            if (injectFaults(req, res)) return;
+            handleRoute(req, res);
+        });
+    }
+
+    // Tab separated: request target (path and query, as sent by the client), response body
+    bool loadRecordings(const string& filename) {
+        ifstream file(filename);
+        if (!file.is_open()) {
+            return false;
+        }
         
-//         int exportChoice;
-//         try {
-//             string input;
-//             getline(cin, input);
-//             exportChoice = stoi(input);
-//         } catch (...) {
-//             exportChoice = 0;
-//         }
+        string line;
+        while (getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            size_t tab = line.find('\t');
+            if (tab == string::npos) continue;
+            recordings[line.substr(0, tab)] = line.substr(tab + 1);
+        }
+        return !recordings.empty();
+    }
+
+    // Blocks until stop() is called or the port cannot be bound
+    bool listen() {
+        cout << "Mock upstream listening on http://" << options.host << ":" << options.port
+             << " (latency " << options.latencyMs << "+" << options.jitterMs << " ms, error rate "
+             << options.errorRate << ", " << options.slowRate << " slowed by " << options.slowMs << " ms)" << endl;
+        return server.listen(options.host, options.port);
+    }
+
+    void stop() {
+        server.stop();
+    }
+
+    size_t requestCount() const {
+        return served.load();
+    }
+
+private:
+    Options options;
+    httplib::Server server;
+    unordered_map<string, string> recordings;
+    mt19937_64 rng;
+    mutex rngMutex;
+    atomic<size_t> served{0};
+
+    // Sleeps for the configured latency; true when this request was turned into a 503
+    bool injectFaults(const httplib::Request& req, httplib::Response& res) {
+        served++;
+        int delayMs = options.latencyMs;
+        bool fail = false;
+        {
+            lock_guard<mutex> lock(rngMutex);
+            if (options.jitterMs > 0) delayMs += static_cast<int>(rng() % (options.jitterMs + 1));
+            fail = uniform_real_distribution<double>(0.0, 1.0)(rng) < options.errorRate;
+            if (uniform_real_distribution<double>(0.0, 1.0)(rng) < options.slowRate) delayMs += options.slowMs;
+        }
+        if (delayMs > 0) this_thread::sleep_for(chrono::milliseconds(delayMs));
         
-//         if (exportChoice == 1 || exportChoice == 3) {
-//             exportRouteToFile(startLocation.name, endLocation.name, detailedRoutes);
-//         }
+        if (fail) {
+            res.status = 503;
+            res.set_content("{\"code\":\"ServiceUnavailable\"}", "application/json");
+            return true;
+        }
         
-//         if (exportChoice == 2 || exportChoice == 3) {
-//             cout << "Enter filename for graph visualization (default: graph_visualization.txt): ";
-//             string filename;
-//             getline(cin, filename);
-            
-//             if (filename.empty()) {
-//                 filename = "graph_visualization.txt";
-//             }
-            
-//             if (filename.find(".txt") == string::npos) {
-//                 filename += ".txt";
-//             }
-            
-//             RouteUtils::GraphVisualizer::saveGraphVisualization(currentGraph, filename);
-//             cout << "Graph visualization saved to " << filename << endl;
-//         }
+        auto recorded = recordings.find(req.target);
+        if (recorded != recordings.end()) {
+            res.set_content(recorded->second, "application/json");
+            return true;
+        }
+        return false;
+    }
+
+    // Deterministic point on Java for any query string
+    void handleSearch(const httplib::Request& req, httplib::Response& res) {
+        string query = req.get_param_value("q");
+        if (query.empty()) {
+            res.set_content("[]", "application/json");
+            return;
+        }
         
-//         // Ask if user wants to save this route
-//         cout << "\nDo you want to save one of these routes for future use? (y/n): ";
-//         string saveRoute;
-//         getline(cin, saveRoute);
+        uint64_t hash = 1469598103934665603ULL;
+        for (unsigned char c : Gazetteer::normalize(query)) {
+            hash = (hash ^ c) * 1099511628211ULL;
+        }
+        double lat = -8.5 + static_cast<double>(hash % 100000) / 100000 * 2.5;
+        double lon = 105.5 + static_cast<double>((hash / 100000) % 100000) / 100000 * 9.0;
         
-//         if (saveRoute == "y" || saveRoute == "Y") {
-//             cout << "Which route do you want to save? (1-" << routes.size() << "): ";
-//             int routeIdx = 0;
-//             try {
-//                 string input;
-//                 getline(cin, input);
-//                 routeIdx = stoi(input) - 1;
-//             } catch (...) {
-//                 routeIdx = -1;
-//             }
+        nlohmann::json place = {
+            {"lat", to_string(lat)},
+            {"lon", to_string(lon)},
+            {"display_name", query + ", Jawa, Indonesia"}
+        };
+        res.set_content(nlohmann::json::array({place}).dump(), "application/json");
+    }
+
+    // Straight legs between the requested waypoints, 25% longer than the great circle
+    void handleRoute(const httplib::Request& req, httplib::Response& res) {
+        vector<pair<double, double>> waypoints;
+        stringstream coordinates(req.matches[1].str());
+        string pairText;
+        while (getline(coordinates, pairText, ';')) {
+            size_t comma = pairText.find(',');
+            try {
+                if (comma == string::npos) throw invalid_argument("missing comma");
+                waypoints.push_back(make_pair(stod(pairText.substr(comma + 1)), stod(pairText.substr(0, comma))));
+            } catch (const exception&) {
+                waypoints.clear();
+                break;
+            }
+        }
+        if (waypoints.size() < 2) {
+            res.status = 400;
+            res.set_content("{\"code\":\"InvalidQuery\"}", "application/json");
+            return;
+        }
+        
+        nlohmann::json legs = nlohmann::json::array();
+        double totalDistance = 0;
+        for (size_t i = 0; i + 1 < waypoints.size(); i++) {
+            double distance = 1250.0 * RouteUtils::calculateDistance(waypoints[i].first, waypoints[i].second,
+                                                                     waypoints[i + 1].first, waypoints[i + 1].second);
+            double duration = distance / (60.0 / 3.6);
+            totalDistance += distance;
             
-//             if (routeIdx >= 0 && routeIdx < routes.size()) {
-//                 cout << "Enter a name for this route: ";
-//                 string routeName;
-//                 getline(cin, routeName);
-                
-//                 if (!routeName.empty()) {
-//                     routeManager.addRoute(
-//                         routeName,
-//                         startLocation.name,
-//                         endLocation.name,
-//                         routeType,
-//                         routes[routeIdx]
-//                     );
-//                     cout << "Route saved as '" << routeName << "'." << endl;
-//                 }
-//             }
-//         }
-//     } catch (const exception& e) {
-//         cerr << "Error calculating route: " << e.what() << endl;
-//         cout << "Please try again with different locations." << endl;
-//     }
-// }
+            nlohmann::json steps = nlohmann::json::array();
+            steps.push_back({{"name", "Jalan Mock " + to_string(i + 1) + "A"}, {"distance", distance * 0.3}, {"duration", duration * 0.3}});
+            steps.push_back({{"name", "Jalan Mock " + to_string(i + 1) + "B"}, {"distance", distance * 0.6}, {"duration", duration * 0.6}});
+            steps.push_back({{"name", ""}, {"distance", distance * 0.1}, {"duration", duration * 0.1}});
+            legs.push_back({{"distance", distance}, {"duration", duration}, {"steps", steps}});
+        }
+        
+        nlohmann::json geometry;
+        if (req.get_param_value("geometries") == "geojson") {
+            nlohmann::json points = nlohmann::json::array();
+            for (const auto& point : waypoints) points.push_back({point.second, point.first});
+            geometry = {{"type", "LineString"}, {"coordinates", points}};
+        } else {
+            geometry = OsrmRoute::encodePolyline(waypoints);
+        }
+        
+        nlohmann::json route = {
+            {"distance", totalDistance},
+            {"duration", totalDistance / (60.0 / 3.6)},
+            {"legs", legs},
+            {"geometry", geometry}
+        };
+        res.set_content(nlohmann::json({{"code", "Ok"}, {"routes", nlohmann::json::array({route})}}).dump(),
+                        "application/json");
+    }
+};
 
-void exportRouteToFile(const string& startLocation, const string& endLocation, 
-                      const vector<string>& detailedRoutes) {
-    // Get current timestamp for filename
-    time_t now = time(0);
-    tm* ltm = localtime(&now);
-    stringstream timestamp;
-    timestamp << 1900 + ltm->tm_year << "-" 
-              << setw(2) << setfill('0') << 1 + ltm->tm_mon << "-"
-              << setw(2) << setfill('0') << ltm->tm_mday << "_"
-              << setw(2) << setfill('0') << ltm->tm_hour 
-              << setw(2) << setfill('0') << ltm->tm_min;
+// Times the distance kernels on synthetic coordinates and checks the batch path
+// against the scalar haversine. Exit code is non-zero if the error bound is exceeded.
+int runDistanceBenchmark() {
+    const size_t count = 1 << 20;
+    vector<double> lat1(count), lon1(count), lat2(count), lon2(count);
+    vector<double> scalar(count), batch(count);
     
-    string defaultFilename = "route_" + 
-        Location::extractCityName(startLocation) + "_to_" + 
-        Location::extractCityName(endLocation) + "_" + 
-        timestamp.str() + ".txt";
+    // Deterministic LCG so runs are comparable; a third of the pairs span the whole globe
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    auto next = [&seed]() {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<double>(seed >> 11) / static_cast<double>(1ULL << 53);
+    };
+    for (size_t i = 0; i < count; i++) {
+        bool global = i % 3 == 0;
+        lat1[i] = global ? next() * 180 - 90 : -11 + next() * 17;
+        lon1[i] = global ? next() * 360 - 180 : 95 + next() * 46;
+        lat2[i] = global ? next() * 180 - 90 : lat1[i] + next() - 0.5;
+        lon2[i] = global ? next() * 360 - 180 : lon1[i] + next() - 0.5;
+    }
     
-    cout << "Enter filename for route information (default: " << defaultFilename << "): ";
-    string filename;
-    getline(cin, filename);
+    auto timeIt = [](const function<void()>& body) {
+        auto begin = chrono::steady_clock::now();
+        body();
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count();
+    };
     
-    if (filename.empty()) {
-        filename = defaultFilename;
-    }
+    double scalarNs = timeIt([&]() {
+        for (size_t i = 0; i < count; i++) {
+            scalar[i] = RouteUtils::calculateDistance(lat1[i], lon1[i], lat2[i], lon2[i]);
+        }
+    });
     
-    if (filename.find(".txt") == string::npos) {
-        filename += ".txt";
+    // Precomputed radians/cos(lat): scalar Location overload and the one-to-many batch
+    vector<Location> starts, ends;
+    vector<double> cosLat2(count), oneToMany(count), fromOrigin(count);
+    starts.reserve(count);
+    ends.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        starts.emplace_back("", lat1[i], lon1[i]);
+        ends.emplace_back("", lat2[i], lon2[i]);
+        cosLat2[i] = ends[i].cosLat;
+    }
+    double locationNs = timeIt([&]() {
+        for (size_t i = 0; i < count; i++) {
+            oneToMany[i] = RouteUtils::calculateDistance(starts[i], ends[i]);
+        }
+    });
+    for (size_t i = 0; i < count; i++) {
+        oneToMany[i] = RouteUtils::calculateDistance(starts[0], ends[i]);
+        fromOrigin[i] = RouteUtils::calculateDistance(lat1[0], lon1[0], lat2[i], lon2[i]);
     }
     
-    stringstream content;
-    content << "===== Route from " << startLocation << " to " << endLocation << " =====" << endl;
-    content << "Generated on: " << put_time(ltm, "%Y-%m-%d %H:%M:%S") << endl << endl;
+    cout << "===== Distance Benchmark (" << count << " pairs) =====" << endl;
+    cout << fixed << setprecision(2);
+    cout << left << setw(34) << "calculateDistance" << scalarNs / count << " ns/pair" << endl;
+    cout << left << setw(34) << "calculateDistance(Location)" << locationNs / count << " ns/pair" << endl;
     
-    for (const auto& route : detailedRoutes) {
-        content << route << endl;
-        content << "---------------------------------------------------" << endl;
+    // Every kernel this CPU runs, not just the one AUTO picks, against the scalar haversine:
+    // pairwise, from one origin, and from one origin with cos(lat) supplied
+    double maxError = 0;
+    for (DistanceKernel kernel : RouteUtils::distanceKernels()) {
+        string name = RouteUtils::distanceKernelName(kernel);
+        double kernelError = 0;
+        auto check = [&](const vector<double>& reference) {
+            for (size_t i = 0; i < count; i++) kernelError = max(kernelError, fabs(reference[i] - batch[i]));
+        };
+        double pairwiseNs = timeIt([&]() {
+            RouteUtils::calculateDistanceBatch(lat1.data(), lon1.data(), lat2.data(), lon2.data(),
+                                               batch.data(), count, kernel);
+        });
+        check(scalar);
+        RouteUtils::calculateDistanceBatch(lat1[0], lon1[0], lat2.data(), lon2.data(), batch.data(), count, kernel);
+        check(fromOrigin);
+        double cosLatNs = timeIt([&]() {
+            RouteUtils::calculateDistanceBatch(starts[0], lat2.data(), lon2.data(), cosLat2.data(),
+                                               batch.data(), count, kernel);
+        });
+        check(oneToMany);
+        maxError = max(maxError, kernelError);
+        
+        cout << fixed << setprecision(2);
+        cout << left << setw(34) << "calculateDistanceBatch (" + name + ")" << pairwiseNs / count << " ns/pair, "
+             << cosLatNs / count << " with cosLat, max error " << scientific << setprecision(3) << kernelError << " km" << endl;
     }
+    cout << "Max batch error: " << maxError << " km (bound " << RouteUtils::BATCH_DISTANCE_MAX_ERROR_KM
+         << " km, " << RouteUtils::distanceKernelName(DISTANCE_KERNEL_AUTO) << " by default)" << endl;
+    cout << defaultfloat;
     
-    if (RouteUtils::FileIO::saveToFile(filename, content.str())) {
-        cout << "Route information saved to " << filename << endl;
-    } else {
-        cout << "Error: Could not save route information to file." << endl;
+    // Heuristic cost per relaxation on a synthetic 150x150 street grid around Surabaya
+    unordered_map<string, Node> grid;
+    const int side = 150;
+    auto gridId = [](int r, int c) { return "n" + to_string(r) + "_" + to_string(c); };
+    for (int r = 0; r < side; r++) {
+        for (int c = 0; c < side; c++) {
+            string id = gridId(r, c);
+            grid[id] = Node(id, Location(id, -7.45 - r * 0.004, 112.60 + c * 0.004));
+        }
     }
-}
-
-};
+    for (int r = 0; r < side; r++) {
+        for (int c = 0; c < side; c++) {
+            Node& node = grid[gridId(r, c)];
+            const int dr[] = {1, -1, 0, 0};
+            const int dc[] = {0, 0, 1, -1};
+            for (int k = 0; k < 4; k++) {
+                int nr = r + dr[k], nc = c + dc[k];
+                if (nr < 0 || nc < 0 || nr >= side || nc >= side) continue;
+                const Location& other = grid[gridId(nr, nc)].location;
+                // Streets are ~20% longer than the straight line between intersections
+                node.edges.push_back(make_pair(gridId(nr, nc), 1.2 * RouteUtils::calculateDistance(node.location, other)));
+            }
+        }
+    }
+    
+    const Location& goal = grid[gridId(side - 1, side - 1)].location;
+    CheapRuler ruler = CheapRuler::forGraph(grid);
+    vector<const Location*> gridLocations;
+    for (const auto& node : grid) gridLocations.push_back(&node.second.location);
+    
+    size_t admissibilityViolations = 0;
+    for (const Location* loc : gridLocations) {
+        if (ruler.distance(*loc, goal) > RouteUtils::calculateDistance(*loc, goal)) admissibilityViolations++;
+    }
+    
+    const int rounds = 20;
+    volatile double sink = 0;
+    double accurateNs = timeIt([&]() {
+        for (int round = 0; round < rounds; round++)
+            for (const Location* loc : gridLocations) sink = sink + RouteUtils::getAccurateDistance(*loc, goal);
+    });
+    double rulerNs = timeIt([&]() {
+        for (int round = 0; round < rounds; round++)
+            for (const Location* loc : gridLocations) sink = sink + ruler.distance(*loc, goal);
+    });
+    size_t evaluations = gridLocations.size() * rounds;
+    
+    RouteFinder finder;
+    vector<string> accuratePath, rulerPath;
+    double accurateSearchNs = timeIt([&]() {
+        accuratePath = finder.findShortestPath(grid, gridId(0, 0), gridId(side - 1, side - 1), ACCURATE_HEURISTIC);
+    });
+    double rulerSearchNs = timeIt([&]() {
+        rulerPath = finder.findShortestPath(grid, gridId(0, 0), gridId(side - 1, side - 1), CHEAP_RULER_HEURISTIC);
+    });
+    // A short trip inside the big graph, where estimates only cover the nodes the search
+    // reaches. Median of repeated runs, since the first one also clears the workspace the
+    // whole-grid searches filled.
+    vector<string> localAccuratePath, localRulerPath;
+    auto medianSearchNs = [&](HeuristicMode mode, vector<string>& path) {
+        vector<double> runs;
+        for (int run = 0; run < 11; run++) {
+            runs.push_back(timeIt([&]() { path = finder.findShortestPath(grid, gridId(70, 70), gridId(80, 80), mode); }));
+        }
+        sort(runs.begin(), runs.end());
+        return runs[runs.size() / 2];
+    };
+    double localAccurateNs = medianSearchNs(ACCURATE_HEURISTIC, localAccuratePath);
+    double localRulerNs = medianSearchNs(CHEAP_RULER_HEURISTIC, localRulerPath);
+    bool searchesAgree = fabs(RouteFinder::pathDistance(accuratePath, grid) - RouteFinder::pathDistance(rulerPath, grid)) < 1e-9 &&
+                         fabs(RouteFinder::pathDistance(localAccuratePath, grid) - RouteFinder::pathDistance(localRulerPath, grid)) < 1e-9;
+    
+    cout << "\n===== Heuristic Benchmark (" << grid.size() << " nodes) =====" << endl;
+    cout << fixed << setprecision(2);
+    cout << left << setw(34) << "getAccurateDistance" << accurateNs / evaluations << " ns/eval" << endl;
+    cout << left << setw(34) << "CheapRuler::distance" << rulerNs / evaluations << " ns/eval"
+         << " (" << accurateNs / max(rulerNs, 1.0) << "x)" << endl;
+    cout << left << setw(34) << "A* (accurate heuristic)" << accurateSearchNs / 1e6 << " ms, "
+         << accuratePath.size() << " nodes" << endl;
+    cout << left << setw(34) << "A* (cheap ruler heuristic)" << rulerSearchNs / 1e6 << " ms, "
+         << rulerPath.size() << " nodes" << endl;
+    cout << left << setw(34) << "A* local (accurate heuristic)" << localAccurateNs / 1e6 << " ms, "
+         << localAccuratePath.size() << " nodes" << endl;
+    cout << left << setw(34) << "A* local (cheap ruler heuristic)" << localRulerNs / 1e6 << " ms, "
+         << localRulerPath.size() << " nodes" << endl;
+    cout << "Cheap ruler overestimates: " << admissibilityViolations << ", path lengths agree: "
+         << (searchesAgree ? "yes" : "no") << endl;
+    cout << defaultfloat;
 
-// int main() {
-//     try {
-//         RoutePlanner planner;
-//         planner.planRoute();
-//     } catch (const exception& e) {
-//         cerr << "Fatal error: " << e.what() << endl;
-//         cout << "The program will now exit." << endl;
-//         return 1;
-//     }
-//     return 0;
-// }
+    // Snapping points onto the grid's streets on one core, nearest edge and k-nearest, with
+    // cells one block wide. A street's ends are intersections, so no snap may land farther
+    // away than the nearest one.
+    RoadSegmentIndex streetIndex(0.004);
+    streetIndex.build(grid);
+    vector<pair<double, double>> snapPoints;
+    for (size_t i = 0; i < 200000; i++) {
+        snapPoints.push_back(make_pair(-7.45 - next() * (side - 1) * 0.004, 112.60 + next() * (side - 1) * 0.004));
+    }
+    vector<RoadSegmentIndex::SnapResult> snaps(snapPoints.size());
+    double snapNs = timeIt([&]() {
+        for (size_t i = 0; i < snapPoints.size(); i++) snaps[i] = streetIndex.snap(snapPoints[i].first, snapPoints[i].second);
+    });
+    const size_t snapCandidates = 4;
+    size_t candidatesFound = 0;
+    double nearestNs = timeIt([&]() {
+        for (const auto& point : snapPoints) candidatesFound += streetIndex.nearest(point.first, point.second, snapCandidates).size();
+    });
+    size_t badSnaps = 0;
+    for (size_t i = 0; i < snapPoints.size(); i++) {
+        int r = static_cast<int>(lround((-7.45 - snapPoints[i].first) / 0.004));
+        int c = static_cast<int>(lround((snapPoints[i].second - 112.60) / 0.004));
+        double intersectionKm = RouteUtils::calculateDistance(grid[gridId(r, c)].location.lat, grid[gridId(r, c)].location.lon,
+                                                              snapPoints[i].first, snapPoints[i].second);
+        if (!snaps[i].found() || snaps[i].distance > intersectionKm + 1e-4) badSnaps++;
+    }
+    const double requiredSnapsPerSecond = 5000;
+    double snapsPerSecond = snapPoints.size() / (snapNs / 1e9);
+    double nearestPerSecond = snapPoints.size() / (nearestNs / 1e9);
 
+    cout << "\n===== Road Snapping Benchmark (" << streetIndex.size() << " segments) =====" << endl;
+    cout << fixed << setprecision(2);
+    cout << left << setw(34) << "RoadSegmentIndex::snap" << snapNs / snapPoints.size() / 1e3 << " us/point ("
+         << snapsPerSecond << " snaps/s)" << endl;
+    cout << left << setw(34) << ("RoadSegmentIndex::nearest (k=" + to_string(snapCandidates) + ")")
+         << nearestNs / snapPoints.size() / 1e3 << " us/point (" << nearestPerSecond << " snaps/s)" << endl;
+    cout << "Snaps beyond the nearest intersection: " << badSnaps << ", candidates per point: "
+         << static_cast<double>(candidatesFound) / snapPoints.size() << " (target " << requiredSnapsPerSecond
+         << " snaps/s)" << endl;
+    cout << defaultfloat;
+    
+    // Reverse geocoding throughput: 200k places and a grid of admin squares over Java
+    ReverseGeocoder reverseIndex;
+    vector<pair<double, double>> placePoints;
+    for (size_t i = 0; i < 200000; i++) {
+        placePoints.push_back(make_pair(-8.8 + next() * 3, 105 + next() * 10));
+        reverseIndex.addPlace("place" + to_string(i), placePoints.back().first, placePoints.back().second);
+    }
+    for (int r = 0; r < 6; r++) {
+        for (int c = 0; c < 20; c++) {
+            double south = -8.8 + r * 0.5, west = 105 + c * 0.5;
+            reverseIndex.addArea("area" + to_string(r) + "_" + to_string(c),
+                {{south, west}, {south, west + 0.5}, {south + 0.5, west + 0.5}, {south + 0.5, west}});
+        }
+    }
+    vector<pair<double, double>> queries;
+    for (size_t i = 0; i < count; i++) {
+        queries.push_back(make_pair(-8.8 + next() * 3, 105 + next() * 10));
+    }
+    vector<ReverseGeocoder::Result> reversed;
+    double reverseNs = timeIt([&]() { reversed = reverseIndex.reverseBatch(queries); });
+    
+    // Brute-force check of the nearest place on a sample
+    size_t reverseMismatches = 0;
+    for (size_t i = 0; i < count; i += count / 256) {
+        double bestKm = numeric_limits<double>::infinity();
+        for (const auto& place : placePoints) {
+            bestKm = min(bestKm, RouteUtils::calculateDistance(queries[i].first, queries[i].second, place.first, place.second));
+        }
+        if (reversed[i].area.empty() || fabs(reversed[i].distance - bestKm) > 1e-6) reverseMismatches++;
+    }
+    
+    cout << "\n===== Reverse Geocoding Benchmark (" << count << " points) =====" << endl;
+    cout << fixed << setprecision(2);
+    cout << left << setw(34) << "ReverseGeocoder::reverseBatch" << reverseNs / count << " ns/point ("
+         << count / (reverseNs / 1e9) * 60 / 1e6 << "M points/min, " << thread::hardware_concurrency() << " threads)" << endl;
+    cout << "Nearest place mismatches: " << reverseMismatches << endl;
+    cout << defaultfloat;
+    
+    // OSRM response parsing: a long route with per-step geometry and intersections, as
+    // overview=full&steps=true returns them
+    nlohmann::json osrmLegs = nlohmann::json::array();
+    nlohmann::json overview = nlohmann::json::array();
+    for (int leg = 0; leg < 20; leg++) {
+        nlohmann::json steps = nlohmann::json::array();
+        for (int step = 0; step < 60; step++) {
+            nlohmann::json stepGeometry = nlohmann::json::array();
+            nlohmann::json intersections = nlohmann::json::array();
+            for (int point = 0; point < 25; point++) {
+                double lat = -7.0 - next(), lon = 112.0 + next();
+                stepGeometry.push_back({lon, lat});
+                overview.push_back({lon, lat});
+                intersections.push_back({{"location", {lon, lat}}, {"bearings", {0, 90, 180, 270}}, {"entry", {true, false, true, true}}});
+            }
+            steps.push_back({{"name", "Jalan " + to_string(leg) + "-" + to_string(step)}, {"distance", next() * 1000},
+                             {"duration", next() * 60}, {"geometry", {{"type", "LineString"}, {"coordinates", stepGeometry}}},
+                             {"intersections", intersections}, {"maneuver", {{"type", "turn"}, {"modifier", "left"}}}});
+        }
+        osrmLegs.push_back({{"distance", next() * 50000}, {"duration", next() * 3600}, {"steps", steps}, {"summary", "summary"}});
+    }
+    nlohmann::json osrmRoute = {{"distance", 1.0}, {"duration", 1.0}, {"legs", osrmLegs},
+                                {"geometry", {{"type", "LineString"}, {"coordinates", overview}}}};
+    string osrmBody = nlohmann::json({{"code", "Ok"}, {"routes", {osrmRoute, osrmRoute}}, {"waypoints", nlohmann::json::array()}}).dump();
+    
+    const int parseRounds = 5;
+    OsrmRoute domRoute, saxRoute, saxNoGeometry;
+    double domNs = timeIt([&]() {
+        for (int round = 0; round < parseRounds; round++) OsrmRoute::fromJson(nlohmann::json::parse(osrmBody), domRoute);
+    });
+    double saxNs = timeIt([&]() {
+        for (int round = 0; round < parseRounds; round++) OsrmRoute::fromResponse(osrmBody, saxRoute);
+    });
+    double saxStepsNs = timeIt([&]() {
+        for (int round = 0; round < parseRounds; round++) OsrmRoute::fromResponse(osrmBody, saxNoGeometry, false);
+    });
+    
+    bool parsersAgree = domRoute.legs.size() == saxRoute.legs.size() && domRoute.geometry == saxRoute.geometry &&
+                        saxNoGeometry.geometry.empty() && saxNoGeometry.legs.size() == domRoute.legs.size();
+    for (size_t leg = 0; parsersAgree && leg < domRoute.legs.size(); leg++) {
+        const auto& a = domRoute.legs[leg];
+        const auto& b = saxRoute.legs[leg];
+        parsersAgree = a.distance == b.distance && a.duration == b.duration && a.steps.size() == b.steps.size();
+        for (size_t step = 0; parsersAgree && step < a.steps.size(); step++) {
+            parsersAgree = a.steps[step].name == b.steps[step].name && a.steps[step].distance == b.steps[step].distance &&
+                           a.steps[step].duration == b.steps[step].duration &&
+                           saxNoGeometry.legs[leg].steps[step].name == a.steps[step].name;
+        }
+    }
+    
+    cout << "\n===== OSRM Parse Benchmark (" << osrmBody.size() / 1024 << " KiB response) =====" << endl;
+    cout << fixed << setprecision(2);
+    cout << left << setw(34) << "json::parse + fromJson" << domNs / parseRounds / 1e6 << " ms" << endl;
+    cout << left << setw(34) << "fromResponse (SAX)" << saxNs / parseRounds / 1e6 << " ms" << endl;
+    cout << left << setw(34) << "fromResponse (SAX, no geometry)" << saxStepsNs / parseRounds / 1e6 << " ms" << endl;
+    cout << "Parsers agree: " << (parsersAgree ? "yes" : "no") << endl;
+    cout << defaultfloat;
+    
+    // Local routing backend throughput; distinct coordinates keep every lookup a memo miss
+    RouteFinder backendFinder;
+    const vector<string> cities = {"Surabaya", "Malang", "Jakarta", "Bandung", "Jember", "Bondowoso", "Kediri", "Blitar"};
+    vector<pair<Location, Location>> segmentQueries;
+    for (size_t i = 0; i < count / 10; i++) {
+        segmentQueries.push_back(make_pair(
+            Location(cities[i % cities.size()], -8.8 + next() * 3, 105 + next() * 10),
+            Location(cities[(i / cities.size()) % cities.size()], -8.8 + next() * 3, 105 + next() * 10)));
+    }
+    size_t namedSegments = 0;
+    double localBackendNs = timeIt([&]() {
+        for (const auto& segment : segmentQueries) {
+            if (!backendFinder.getRouteDetails(segment.first, segment.second, FASTEST, Deadline(), BACKEND_LOCAL).empty()) {
+                namedSegments++;
+            }
+        }
+    });
+    
+    size_t localUpstreamRequests = 0;
+    cout << "\n===== Routing Backend Benchmark (" << segmentQueries.size() << " segments, local mode) =====" << endl;
+    cout << fixed << setprecision(2);
+    cout << left << setw(34) << "getRouteDetails (local)" << localBackendNs / segmentQueries.size() / 1e3 << " us/segment ("
+         << segmentQueries.size() / (localBackendNs / 1e9) << " segments/s)" << endl;
+    for (const auto& entry : backendFinder.backendStats()) {
+        cout << left << setw(34) << ("  " + entry.first) << entry.second.legsAnswered << "/" << entry.second.legsRequested
+             << " legs, " << entry.second.totalMs << " ms" << endl;
+        localUpstreamRequests += entry.second.upstreamRequests + (entry.first == "osrm" ? entry.second.calls : 0);
+    }
+    cout << "Unnamed segments: " << segmentQueries.size() - namedSegments << ", upstream requests: " << localUpstreamRequests << endl;
+    cout << defaultfloat;
+    
+    // Location search over 1M synthetic names: per-query latency on the live index, and what
+    // a single insert or remove costs compared with rebuilding it
+    vector<string> syllables;
+    for (char consonant : string("bcdghjklmnprstwy")) {
+        for (char vowel : string("aeiou")) syllables.push_back(string(1, consonant) + vowel);
+    }
+    auto syntheticName = [&]() {
+        string name = next() < 0.3 ? "Kota " : "";
+        size_t words = 1 + static_cast<size_t>(next() * 2);
+        for (size_t word = 0; word < words; word++) {
+            if (word > 0) name += ' ';
+            size_t parts = 2 + static_cast<size_t>(next() * 3);
+            for (size_t part = 0; part < parts; part++) name += syllables[static_cast<size_t>(next() * syllables.size())];
+            name[name.size() - 2 * parts] = static_cast<char>(toupper(name[name.size() - 2 * parts]));
+        }
+        return name;
+    };
+    const size_t searchNames = 1000000;
+    vector<string> names;
+    names.reserve(searchNames);
+    for (size_t i = 0; i < searchNames; i++) names.push_back(syntheticName() + " " + to_string(i));
+    LocationSearchIndex searchIndex;
+    double buildNs = timeIt([&]() {
+        for (const string& name : names) searchIndex.add(name, next());
+        searchIndex.finalize();
+    });
+    
+    // Typed prefixes, and full words with one letter dropped that only the fuzzy pass finds
+    vector<double> prefixLatencies, typoLatencies;
+    size_t emptySearches = 0;
+    for (size_t i = 0; i < 2000; i++) {
+        const string& name = names[static_cast<size_t>(next() * names.size())];
+        string query = name.substr(0, name.find(' ', name.find(' ') + 1));
+        bool prefix = i % 2 == 0;
+        if (prefix) query = query.substr(0, max<size_t>(3, query.size() / 2));
+        else if (query.size() > 4) query.erase(query.size() / 2, 1);
+        size_t found = 0;
+        (prefix ? prefixLatencies : typoLatencies).push_back(timeIt([&]() { found = searchIndex.search(query, 5).size(); }));
+        if (found == 0) emptySearches++;
+    }
+    sort(prefixLatencies.begin(), prefixLatencies.end());
+    sort(typoLatencies.begin(), typoLatencies.end());
+    const double maxSearchP99Us = 1000;
+    double prefixP99Us = prefixLatencies[prefixLatencies.size() * 99 / 100] / 1e3;
+    double typoP99Us = typoLatencies[typoLatencies.size() * 99 / 100] / 1e3;
+    
+    const string editedName = "Qwertyuiop Benchmark";
+    double insertNs = timeIt([&]() { searchIndex.insert(editedName, 1.0); });
+    bool insertFound = !searchIndex.search("qwertyuiop", 5).empty() &&
+                       searchIndex.search("qwertyuiop", 5)[0].name == editedName;
+    double removeNs = timeIt([&]() { searchIndex.remove(editedName); });
+    bool removeGone = searchIndex.search("qwertyuiop", 5).empty() && searchIndex.size() == searchNames;
+    
+    cout << "\n===== Location Search Benchmark (" << searchIndex.size() << " names) =====" << endl;
+    cout << fixed << setprecision(2);
+    cout << left << setw(34) << "build + finalize" << buildNs / 1e6 << " ms" << endl;
+    cout << left << setw(34) << "search prefix (p50 / p99)" << prefixLatencies[prefixLatencies.size() / 2] / 1e3 << " / "
+         << prefixP99Us << " us" << endl;
+    cout << left << setw(34) << "search typo (p50 / p99)" << typoLatencies[typoLatencies.size() / 2] / 1e3 << " / "
+         << typoP99Us << " us (target p99 " << maxSearchP99Us << " us)" << endl;
+    cout << left << setw(34) << "insert / remove one name" << insertNs / 1e3 << " / " << removeNs / 1e3 << " us" << endl;
+    cout << "Empty results: " << emptySearches << ", edits visible: " << (insertFound && removeGone ? "yes" : "no") << endl;
+    cout << defaultfloat;
+    
+    bool ok = maxError <= RouteUtils::BATCH_DISTANCE_MAX_ERROR_KM && admissibilityViolations == 0 && searchesAgree &&
+              badSnaps == 0 && min(snapsPerSecond, nearestPerSecond) >= requiredSnapsPerSecond &&
+              reverseMismatches == 0 &&
+              parsersAgree && namedSegments == segmentQueries.size() && localUpstreamRequests == 0 &&
+              insertFound && removeGone && max(prefixP99Us, typoP99Us) < maxSearchP99Us;
+    return ok ? 0 : 1;
+}
 
-int main() {
+int main(int argc, char* argv[]) {
+    HeuristicMode heuristicMode = ACCURATE_HEURISTIC;
+    RoutingBackendMode backendMode = BACKEND_AUTO;
+    bool runBenchmark = false;
+    bool runMockUpstream = false;
+    bool runServer = false;
+    string batchInput, batchOutput;
+    MockUpstreamServer::Options mockOptions;
+    RoutingServer::Options serverOptions;
+    
+    // "--name=value" flags; returns false when arg is not that flag
+    auto flagValue = [](const string& arg, const string& name, string& value) {
+        string prefix = name + "=";
+        if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+        value = arg.substr(prefix.size());
+        return true;
+    };
+    
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        string value;
+        try {
+            if (arg == "--benchmark") {
+                runBenchmark = true;
+            } else if (arg == "--heuristic=cheap-ruler") {
+                heuristicMode = CHEAP_RULER_HEURISTIC;
+            } else if (arg == "--heuristic=accurate") {
+                heuristicMode = ACCURATE_HEURISTIC;
+            } else if (flagValue(arg, "--routing-backend", value)) {
+                if (!RouteFinder::parseRoutingBackendMode(value, backendMode)) {
+                    cerr << "Unknown routing backend: " << value << " (expected auto, local or remote)" << endl;
+                    return 1;
+                }
+            } else if (flagValue(arg, "--http-pool-size", value)) {
+                HttpClientPool::setDefaultLimits(stoul(value), chrono::seconds(60));
+            } else if (flagValue(arg, "--nominatim-url", value)) {
+                UpstreamConfig::nominatimUrl() = value;
+            } else if (flagValue(arg, "--osrm-url", value)) {
+                UpstreamConfig::osrmUrl() = value;
+            } else if (arg == "--serve") {
+                runServer = true;
+            } else if (flagValue(arg, "--serve-host", value)) {
+                serverOptions.host = value;
+            } else if (flagValue(arg, "--serve-port", value)) {
+                serverOptions.port = stoi(value);
+            } else if (flagValue(arg, "--serve-threads", value)) {
+                serverOptions.threads = stoul(value);
+                serverOptions.detailThreads = serverOptions.threads;
+            } else if (flagValue(arg, "--serve-cache", value)) {
+                serverOptions.routeCacheEntries = stoul(value);
+            } else if (flagValue(arg, "--serve-cache-seconds", value)) {
+                serverOptions.routeCacheSeconds = stoi(value);
+            } else if (flagValue(arg, "--serve-slots", value)) {
+                serverOptions.routingSlots = stoul(value);
+            } else if (flagValue(arg, "--serve-queue", value)) {
+                serverOptions.maxQueuedInteractive = stoul(value);
+            } else if (flagValue(arg, "--batch", value)) {
+                batchInput = value;
+            } else if (flagValue(arg, "--batch-out", value)) {
+                batchOutput = value;
+            } else if (flagValue(arg, "--batch-threads", value)) {
+                serverOptions.batchThreads = stoul(value);
+            } else if (arg == "--mock-upstream") {
+                runMockUpstream = true;
+            } else if (flagValue(arg, "--mock-port", value)) {
+                mockOptions.port = stoi(value);
+            } else if (flagValue(arg, "--mock-latency-ms", value)) {
+                mockOptions.latencyMs = stoi(value);
+            } else if (flagValue(arg, "--mock-jitter-ms", value)) {
+                mockOptions.jitterMs = stoi(value);
+            } else if (flagValue(arg, "--mock-error-rate", value)) {
+                mockOptions.errorRate = stod(value);
+            } else if (flagValue(arg, "--mock-slow-rate", value)) {
+                mockOptions.slowRate = stod(value);
+            } else if (flagValue(arg, "--mock-slow-ms", value)) {
+                mockOptions.slowMs = stoi(value);
+            } else if (flagValue(arg, "--mock-recordings", value)) {
+                mockOptions.recordingsFile = value;
+            } else {
+                cerr << "Unknown option: " << arg << endl;
+                return 1;
+            }
+        } catch (const exception&) {
+            cerr << "Invalid value for option: " << arg << endl;
+            return 1;
+        }
+    }
+    
+    if (runBenchmark) {
+        return runDistanceBenchmark();
+    }
+    if (runMockUpstream) {
+        MockUpstreamServer mock(mockOptions);
+        if (!mock.listen()) {
+            cerr << "Error: Could not listen on port " << mockOptions.port << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (!batchInput.empty()) {
+        // "-" reads queries from stdin; results go to stdout unless --batch-out is given
+        ifstream inputFile;
+        ofstream outputFile;
+        if (batchInput != "-") {
+            inputFile.open(batchInput);
+            if (!inputFile.is_open()) {
+                cerr << "Error: Could not open " << batchInput << endl;
+                return 1;
+            }
+        }
+        if (!batchOutput.empty()) {
+            outputFile.open(batchOutput);
+            if (!outputFile.is_open()) {
+                cerr << "Error: Could not write " << batchOutput << endl;
+                return 1;
+            }
+        }
+        istream& input = batchInput == "-" ? cin : inputFile;
+        ostream& output = batchOutput.empty() ? cout : outputFile;
+        
+        RoutingServer batchRouter(serverOptions, heuristicMode, backendMode);
+        auto started = chrono::steady_clock::now();
+        size_t answered = batchRouter.runBatch(
+            [&input](string& line) { return static_cast<bool>(getline(input, line)); },
+            [&output](const string& result) { return static_cast<bool>(output.write(result.data(), result.size())); },
+            serverOptions.batchThreads);
+        output.flush();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        cerr << "Routed " << answered << " queries in " << fixed << setprecision(2) << seconds << " s ("
+             << answered / max(seconds, 1e-9) << " queries/s, " << serverOptions.batchThreads << " threads)" << endl;
+        return output ? 0 : 1;
+    }
+    if (runServer) {
+        RoutingServer routingServer(serverOptions, heuristicMode, backendMode);
+        if (!routingServer.listen()) {
+            cerr << "Error: Could not listen on port " << serverOptions.port << endl;
+            return 1;
+        }
+        return 0;
+    }
+    
     try {
         RoutePlanner planner;
+        planner.setHeuristicMode(heuristicMode);
+        planner.setRoutingBackendMode(backendMode);
         planner.planRoute();
+        planner.printRoutingCosts();
         
         // Export option after route planning is done
         cout << "\n===== Export Final Results =====" << endl;